@@ -3,6 +3,9 @@
 #include "Value.h"
 #include "KiwiProgram.h"
 
+#include "Interpreter/Kernels.h"
+#include "Interpreter/BulkMemory.h"
+
 #include "Boxx/Boxx/Array.h"
 
 using namespace Boxx;
@@ -31,10 +34,11 @@ Array<Interpreter::Data> CallExpression::EvaluateAll(Interpreter::InterpreterDat
 
 	if (funcPtr) {
 		Interpreter::Data ptr = funcPtr->Evaluate(data);
-		funcName = data.funcNameMap[ptr.GetNumber(KiwiProgram::ptrSize)];
+		funcName = data.funcNameMap[ptr.GetNumber(data.program->PointerSize())];
 	}
 
 	Weak<Function> function = data.program->functions[funcName];
+	data.program->LoadFunction(function);
 
 	Array<Interpreter::Data> argValues(args.Count());
 
@@ -44,6 +48,10 @@ Array<Interpreter::Data> CallExpression::EvaluateAll(Interpreter::InterpreterDat
 
 	data.PushFrame();
 
+	if (data.profiler) {
+		data.frame->function = funcName;
+	}
+
 	for (UInt i = 0; i < args.Count(); i++) {
 		Tuple<Type, String> arg = function->arguments[i];
 		data.frame->CreateVariable(arg.value2, arg.value1);
@@ -55,7 +63,7 @@ Array<Interpreter::Data> CallExpression::EvaluateAll(Interpreter::InterpreterDat
 		data.frame->CreateVariable(value.value2, value.value1);
 
 		if (value.value1.pointers == 0) {
-			if (data.program->structs.Contains(value.value1.name)) {
+			if (data.program->types.GetStruct(value.value1.id)) {
 				data.frame->SetVarValue(value.value2, Interpreter::Data(Type::SizeOf(value.value1, data.program)));
 			}
 		}
@@ -74,7 +82,50 @@ Array<Interpreter::Data> CallExpression::EvaluateAll(Interpreter::InterpreterDat
 	return ret;
 }
 
-void CallExpression::BuildString(StringBuilder& builder) {
+Interpreter::Reg CallExpression::CompileEvaluate(Interpreter::Compiler& compiler) {
+	if (funcPtr) {
+		throw Interpreter::KiwiInterpretError("the return type of a function pointer call can not be determined");
+	}
+
+	if (!compiler.GetFunction(func)) {
+		throw Interpreter::KiwiInterpretError("function '" + Name::ToKiwi(func) + "' not found");
+	}
+
+	List<Interpreter::Reg> results;
+	results.Add(compiler.AddRegister(Type::SizeOf(GetType(compiler.typeData), compiler.program)));
+	CompileCall(compiler, results);
+	return results[0];
+}
+
+void CallExpression::CompileCall(Interpreter::Compiler& compiler, const List<Interpreter::Reg>& results) {
+	List<UInt> operands;
+
+	for (Weak<Value> arg : args) {
+		Interpreter::Reg reg = arg->CompileEvaluate(compiler);
+		operands.Add(reg);
+		operands.Add(compiler.RegisterSize(reg));
+	}
+
+	for (Interpreter::Reg result : results) {
+		operands.Add(result);
+		operands.Add(compiler.RegisterSize(result));
+	}
+
+	UInt start = compiler.AddOperands(operands);
+
+	if (funcPtr) {
+		Interpreter::Reg ptr = funcPtr->CompileEvaluate(compiler);
+		compiler.Emit(Interpreter::OpCode::CallPtr, compiler.RegisterSize(ptr), ptr, start, args.Count(), results.Count());
+	}
+	else if (Optional<UInt> id = compiler.GetFunction(func)) {
+		compiler.Emit(Interpreter::OpCode::Call, 0, *id, start, args.Count(), results.Count());
+	}
+	else {
+		throw Interpreter::KiwiInterpretError("function '" + Name::ToKiwi(func) + "' not found");
+	}
+}
+
+void CallExpression::BuildString(TextWriter& builder) {
 	builder += "call ";
 
 	if (funcPtr) {
@@ -112,14 +163,58 @@ Interpreter::Data AllocExpression::Evaluate(Interpreter::InterpreterData& data)
 		size = (UInt)varData.GetNumber(varData.Size());
 	}
 
-	Interpreter::Data allocData = data.heap->Alloc(size);
-	Interpreter::DataPtr ptr = allocData.Ptr();
-	Interpreter::Data value  = Interpreter::Data(KiwiProgram::ptrSize);
-	value.Set(ptr);
-	return value;
+	if (region) {
+		Interpreter::Data regionData = region->Evaluate(data);
+		Interpreter::DataPtr ptr = data.heap->RegionAlloc(data.FromPointer(data.GetPointer(regionData), 0), size);
+
+		return Interpreter::Data::Number(data.program->PointerSize(), data.ToPointer(ptr));
+	}
+
+	Interpreter::DataPtr ptr = data.heap->Alloc(size);
+
+	if (data.profiler) {
+		if (*siteProfiler != *data.profiler) {
+			siteProfiler = data.profiler;
+			site = data.profiler->AddSite(Interpreter::Compiler::CreateSite(data.frame->function, data.frame->instructionIndex, data.frame->instruction));
+		}
+
+		data.profiler->Alloc(ptr, size, site);
+	}
+
+	return Interpreter::Data::Number(data.program->PointerSize(), data.ToPointer(ptr));
 }
 
-void AllocExpression::BuildString(StringBuilder& builder) {
+Interpreter::Reg AllocExpression::CompileEvaluate(Interpreter::Compiler& compiler) {
+	Interpreter::Reg ptr = compiler.AddRegister(compiler.program->PointerSize());
+
+	if (region) {
+		Interpreter::Reg regionReg = region->CompileEvaluate(compiler);
+
+		if (var) {
+			Interpreter::Reg size = var->CompileEvaluate(compiler);
+			compiler.Emit(Interpreter::OpCode::RegionAllocVar, compiler.RegisterSize(size), ptr, regionReg, size);
+		}
+		else {
+			UInt size = type ? Type::SizeOf(*type, compiler.program) : this->size;
+			compiler.Emit(Interpreter::OpCode::RegionAlloc, 0, ptr, regionReg, 0, size);
+		}
+
+		return ptr;
+	}
+
+	if (var) {
+		Interpreter::Reg size = var->CompileEvaluate(compiler);
+		compiler.Emit(Interpreter::OpCode::AllocVar, compiler.RegisterSize(size), ptr, size, compiler.AddSite());
+	}
+	else {
+		UInt size = type ? Type::SizeOf(*type, compiler.program) : this->size;
+		compiler.Emit(Interpreter::OpCode::Alloc, 0, ptr, 0, compiler.AddSite(), size);
+	}
+
+	return ptr;
+}
+
+void AllocExpression::BuildString(TextWriter& builder) {
 	builder += "alloc ";
 
 	if (type) {
@@ -131,15 +226,90 @@ void AllocExpression::BuildString(StringBuilder& builder) {
 	else {
 		builder += String::ToString(size);
 	}
+
+	if (region) {
+		builder += " in ";
+		region->BuildString(builder);
+	}
+}
+
+Type StackAllocExpression::GetType(Interpreter::InterpreterData& data) const {
+	Type type = this->type.ValueOr(Type());
+	type.pointers++;
+	return type;
+}
+
+Interpreter::Data StackAllocExpression::Evaluate(Interpreter::InterpreterData& data) {
+	UInt size = this->size;
+
+	if (type) {
+		size = Type::SizeOf(Type(*type), data.program);
+	}
+
+	if (var) {
+		Interpreter::Data varData = var->Evaluate(data);
+		size = (UInt)varData.GetNumber(varData.Size());
+	}
+
+	return Interpreter::Data::Number(data.program->PointerSize(), data.ToPointer(data.stack->Alloc(size)));
+}
+
+Interpreter::Reg StackAllocExpression::CompileEvaluate(Interpreter::Compiler& compiler) {
+	Interpreter::Reg ptr = compiler.AddRegister(compiler.program->PointerSize());
+
+	if (var) {
+		Interpreter::Reg size = var->CompileEvaluate(compiler);
+		compiler.Emit(Interpreter::OpCode::StackAllocVar, compiler.RegisterSize(size), ptr, size);
+	}
+	else {
+		UInt size = type ? Type::SizeOf(*type, compiler.program) : this->size;
+		compiler.Emit(Interpreter::OpCode::StackAlloc, 0, ptr, 0, 0, size);
+	}
+
+	return ptr;
+}
+
+void StackAllocExpression::BuildString(TextWriter& builder) {
+	builder += "stackalloc ";
+
+	if (type) {
+		builder += type->ToKiwi();
+	}
+	else if (var) {
+		var->BuildString(builder);
+	}
+	else {
+		builder += String::ToString(size);
+	}
+}
+
+Type RegionExpression::GetType(Interpreter::InterpreterData& data) const {
+	return Type(1, "u8");
+}
+
+Interpreter::Data RegionExpression::Evaluate(Interpreter::InterpreterData& data) {
+	return Interpreter::Data::Number(data.program->PointerSize(), data.ToPointer(data.heap->CreateRegion()));
+}
+
+Interpreter::Reg RegionExpression::CompileEvaluate(Interpreter::Compiler& compiler) {
+	Interpreter::Reg reg = compiler.AddRegister(compiler.program->PointerSize());
+	compiler.Emit(Interpreter::OpCode::Region, 0, reg);
+	return reg;
+}
+
+void RegionExpression::BuildString(TextWriter& builder) {
+	builder += "region";
 }
 
 OffsetExpression::OffsetExpression(Ptr<Variable> var, Type type, Ptr<Value> offset) {
+	kind = NodeKind::OffsetExpression;
 	this->var = var;
 	this->offset = offset;
 	this->type = type;
 }
 
 OffsetExpression::OffsetExpression(Ptr<Variable> var, Type type, Type offsetType, Ptr<Value> offset) {
+	kind = NodeKind::OffsetExpression;
 	this->var = var;
 	this->offset = offset;
 	this->type = type;
@@ -160,7 +330,25 @@ Interpreter::Data OffsetExpression::Evaluate(Interpreter::InterpreterData& data)
 	return d;
 }
 
-void OffsetExpression::BuildString(StringBuilder& builder) {
+Interpreter::Reg OffsetExpression::CompileEvaluate(Interpreter::Compiler& compiler) {
+	Interpreter::MemRef ref = var->CompileRef(compiler);
+
+	UInt offsetSize = offsetType ? Type::SizeOf(*offsetType, compiler.program) : 1;
+
+	if (Weak<Integer> integer = dyn_cast<Integer>(offset)) {
+		ref.offset += (Long)offsetSize * (Long)integer->value;
+	}
+	else {
+		Interpreter::Reg index = offset->CompileEvaluate(compiler);
+		Interpreter::Reg ptr   = compiler.AddRegister(compiler.program->PointerSize());
+		compiler.Emit(Interpreter::OpCode::Index, compiler.RegisterSize(index), ptr, compiler.Materialize(ref), index, offsetSize);
+		ref = Interpreter::MemRef{false, ptr, 0};
+	}
+
+	return compiler.Load(ref, Type::SizeOf(type, compiler.program));
+}
+
+void OffsetExpression::BuildString(TextWriter& builder) {
 	var->BuildString(builder);
 	builder += '[';
 
@@ -173,15 +361,67 @@ void OffsetExpression::BuildString(StringBuilder& builder) {
 	builder += ']';
 }
 
+Type CompareExpression::GetType(Interpreter::InterpreterData& data) const {
+	return Type("i32");
+}
+
+Interpreter::Data CompareExpression::Evaluate(Interpreter::InterpreterData& data) {
+	Interpreter::Data data1    = value1->Evaluate(data);
+	Interpreter::Data data2    = value2->Evaluate(data);
+	Interpreter::Data sizeData = size->Evaluate(data);
+
+	UInt bytes = (UInt)sizeData.GetNumber(sizeData.Size());
+
+	Interpreter::Data result = Interpreter::Data(4);
+	result.Set<Int>(Interpreter::BulkMemory::Compare(data.FromPointer(data.GetPointer(data1), bytes), data.FromPointer(data.GetPointer(data2), bytes), bytes));
+	return result;
+}
+
+Interpreter::Reg CompareExpression::CompileEvaluate(Interpreter::Compiler& compiler) {
+	Interpreter::Reg reg1    = value1->CompileEvaluate(compiler);
+	Interpreter::Reg reg2    = value2->CompileEvaluate(compiler);
+	Interpreter::Reg sizeReg = size->CompileEvaluate(compiler);
+
+	Interpreter::Reg result = compiler.AddRegister(4);
+	compiler.Emit(Interpreter::OpCode::Compare, compiler.RegisterSize(sizeReg), result, reg1, reg2, sizeReg);
+	return result;
+}
+
+void CompareExpression::BuildString(TextWriter& builder) {
+	builder += "compare ";
+	value1->BuildString(builder);
+	builder += ", ";
+	value2->BuildString(builder);
+	builder += ", ";
+	size->BuildString(builder);
+}
+
 Type UnaryNumberExpression::GetType(Interpreter::InterpreterData& data) const {
 	return value->GetType(data);
 }
 
 Interpreter::Data UnaryNumberExpression::Evaluate(Interpreter::InterpreterData& data) {
-	return value->Evaluate(data);
+	if (!resolved) {
+		type = Type::IntegerId(GetType(data), data.program);
+		resolved = true;
+	}
+
+	Interpreter::Data a = Interpreter::Data(value->Evaluate(data), Type::Info(type).size);
+	Interpreter::EvaluateIntOp(op, type, a.Ptr(), a.Ptr(), nullptr);
+	return a;
+}
+
+Interpreter::Reg UnaryNumberExpression::CompileEvaluate(Interpreter::Compiler& compiler) {
+	UInt type = Type::IntegerId(GetType(compiler.typeData), compiler.program);
+	UInt size = Type::Info(type).size;
+
+	Interpreter::Reg a = value->CompileEvaluate(compiler);
+	Interpreter::Reg result = compiler.AddRegister(size);
+	compiler.Emit(Interpreter::IntOpCode(op, type), size, result, a);
+	return result;
 }
 
-void UnaryNumberExpression::BuildString(StringBuilder& builder) {
+void UnaryNumberExpression::BuildString(TextWriter& builder) {
 	builder += instructionName;
 	builder += " ";
 	value->BuildString(builder);
@@ -194,19 +434,38 @@ Type BinaryNumberExpression::GetType(Interpreter::InterpreterData& data) const {
 }
 
 Interpreter::Data BinaryNumberExpression::Evaluate(Interpreter::InterpreterData& data) {
-	Interpreter::Data a = value1->Evaluate(data); 
-	Interpreter::Data b = value2->Evaluate(data); 
+	if (!resolved) {
+		type  = Type::IntegerId(GetType(data), data.program);
+		type1 = Type::IntegerId(value1->GetType(data), data.program);
+		type2 = Type::IntegerId(value2->GetType(data), data.program);
+		resolved = true;
+	}
+
+	UInt size = Type::Info(type).size;
+
+	Interpreter::Data a = Interpreter::Data::Number(size, Interpreter::ReadInt(value1->Evaluate(data).Ptr(), type1));
+	Interpreter::Data b = Interpreter::Data::Number(size, Interpreter::ReadInt(value2->Evaluate(data).Ptr(), type2));
+
+	Interpreter::EvaluateIntOp(op, type, a.Ptr(), a.Ptr(), b.Ptr());
+	return a;
+}
+
+Interpreter::Reg BinaryNumberExpression::CompileEvaluate(Interpreter::Compiler& compiler) {
+	UInt type = Type::IntegerId(GetType(compiler.typeData), compiler.program);
+	UInt size = Type::Info(type).size;
+
+	Interpreter::Reg a = value1->CompileEvaluate(compiler);
+	a = compiler.Convert(a, Type::IntegerId(value1->GetType(compiler.typeData), compiler.program), type);
+
+	Interpreter::Reg b = value2->CompileEvaluate(compiler);
+	b = compiler.Convert(b, Type::IntegerId(value2->GetType(compiler.typeData), compiler.program), type);
 
-	return Interpreter::Data::Number(
-		Type::SizeOf(GetType(data), data.program),
-		Evaluate(
-			a.GetNumber(Type::SizeOf(value1->GetType(data), data.program)),
-			b.GetNumber(Type::SizeOf(value2->GetType(data), data.program))
-		)
-	);
+	Interpreter::Reg result = compiler.AddRegister(size);
+	compiler.Emit(Interpreter::IntOpCode(op, type), size, result, a, b);
+	return result;
 }
 
-void BinaryNumberExpression::BuildString(StringBuilder& builder) {
+void BinaryNumberExpression::BuildString(TextWriter& builder) {
 	builder += instructionName;
 	builder += " ";
 	value1->BuildString(builder);
@@ -14,10 +14,18 @@ namespace Kiwi {
 	/// A kiwi expression.
 	class Expression : public Node {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() >= NodeKind::FirstExpression && node->Kind() <= NodeKind::LastExpression;
+		}
+
 		virtual void Interpret(Interpreter::InterpreterData& data) final override {
 			throw Interpreter::KiwiInterpretError("Call Evaluate instead");
 		}
 
+		virtual void Compile(Interpreter::Compiler& compiler) final override {
+			throw Interpreter::KiwiInterpretError("Call CompileEvaluate instead");
+		}
+
 		/// Gets the type of the expression.
 		virtual Type GetType(Interpreter::InterpreterData& data) const = 0;
 
@@ -26,7 +34,13 @@ namespace Kiwi {
 			return Interpreter::Data();
 		}
 
-		virtual void BuildString(Boxx::StringBuilder& builder) override {
+		/// Compiles the expression.
+		///R reg: The register containing the result of the expression.
+		virtual Interpreter::Reg CompileEvaluate(Interpreter::Compiler& compiler) {
+			return compiler.AddRegister(0);
+		}
+
+		virtual void BuildString(TextWriter& builder) override {
 			builder += "unknown expression";
 		}
 	};
@@ -34,6 +48,10 @@ namespace Kiwi {
 	/// A unary kiwi expression.
 	class UnaryExpression : public Expression {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() >= NodeKind::FirstUnaryExpression && node->Kind() <= NodeKind::LastUnaryExpression;
+		}
+
 		/// The value.
 		Ptr<Value> value;
 	};
@@ -41,6 +59,10 @@ namespace Kiwi {
 	/// A binary kiwi expression.
 	class BinaryExpression : public Expression {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() >= NodeKind::FirstBinaryExpression && node->Kind() <= NodeKind::LastBinaryExpression;
+		}
+
 		/// The first operand.
 		Ptr<Value> value1;
 
@@ -51,6 +73,10 @@ namespace Kiwi {
 	/// A call expression.
 	class CallExpression : public Expression {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::CallExpression;
+		}
+
 		/// The function to call.
 		Boxx::String func;
 
@@ -61,46 +87,89 @@ namespace Kiwi {
 		Boxx::List<Ptr<Value>> args;
 
 		CallExpression(const Boxx::String& func) {
+			kind = NodeKind::CallExpression;
 			this->func = func;
 		}
 
 		CallExpression(const Ptr<Variable>& func) {
+			kind = NodeKind::CallExpression;
 			this->funcPtr = func;
 		}
 
 		virtual Type GetType(Interpreter::InterpreterData& data) const override;
 		virtual Interpreter::Data Evaluate(Interpreter::InterpreterData& data) override;
 		Boxx::Array<Interpreter::Data> EvaluateAll(Interpreter::InterpreterData& data);
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual Interpreter::Reg CompileEvaluate(Interpreter::Compiler& compiler) override;
+
+		/// Compiles the call and stores the return values in the specified registers.
+		void CompileCall(Interpreter::Compiler& compiler, const Boxx::List<Interpreter::Reg>& results);
+
+		virtual void BuildString(TextWriter& builder) override;
 	};
 
 	/// An alloc instruction.
 	class AllocExpression : public Expression {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::AllocExpression;
+		}
+
 		Boxx::UInt size;
 		Boxx::Optional<Type> type;
 		Ptr<Variable> var;
 
+		/// The region to allocate in.
+		///
+		/// The memory is allocated on the heap if this is not set.
+		Ptr<Variable> region;
+
 		AllocExpression(Boxx::UInt size) {
+			kind = NodeKind::AllocExpression;
 			this->size = size;
 		}
 
 		AllocExpression(Type type) {
+			kind = NodeKind::AllocExpression;
 			this->type = type;
 		}
 
 		AllocExpression(Ptr<Variable> var) {
+			kind = NodeKind::AllocExpression;
 			this->var = var;
 		}
 
+		AllocExpression(Boxx::UInt size, Ptr<Variable> region) : AllocExpression(size) {
+			this->region = region;
+		}
+
+		AllocExpression(Type type, Ptr<Variable> region) : AllocExpression(type) {
+			this->region = region;
+		}
+
+		AllocExpression(Ptr<Variable> var, Ptr<Variable> region) : AllocExpression(var) {
+			this->region = region;
+		}
+
 		virtual Type GetType(Interpreter::InterpreterData& data) const override;
 		virtual Interpreter::Data Evaluate(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual Interpreter::Reg CompileEvaluate(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
+
+	private:
+		/// The allocation site of the expression in the tree interpreter.
+		///
+		/// The site is added to the profiler the first time the expression allocates memory.
+		Weak<Interpreter::HeapProfiler> siteProfiler;
+		Boxx::UInt site = 0;
 	};
 
 	/// An offset expression.
 	class OffsetExpression : public Expression {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::OffsetExpression;
+		}
+
 		Ptr<Variable> var;
 		Ptr<Value> offset;
 		Boxx::Optional<Type> offsetType;
@@ -111,261 +180,360 @@ namespace Kiwi {
 
 		virtual Type GetType(Interpreter::InterpreterData& data) const override;
 		virtual Interpreter::Data Evaluate(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual Interpreter::Reg CompileEvaluate(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
+	};
+
+	/// A compare expression.
+	///
+	/// Compares memory as unsigned bytes.
+	/// The result is an {i32} that is {-1}, {0} or {1}.
+	class CompareExpression : public Expression {
+	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::CompareExpression;
+		}
+
+		Ptr<Value> value1, value2, size;
+
+		CompareExpression(Ptr<Value> value1, Ptr<Value> value2, Ptr<Value> size) {
+			kind = NodeKind::CompareExpression;
+			this->value1 = value1;
+			this->value2 = value2;
+			this->size   = size;
+		}
+
+		virtual Type GetType(Interpreter::InterpreterData& data) const override;
+		virtual Interpreter::Data Evaluate(Interpreter::InterpreterData& data) override;
+		virtual Interpreter::Reg CompileEvaluate(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
+	};
+
+	/// A stack alloc expression.
+	///
+	/// Allocates cleared memory on the call stack.
+	/// The memory is released when the current function returns and can not be freed before that.
+	class StackAllocExpression : public Expression {
+	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::StackAllocExpression;
+		}
+
+		Boxx::UInt size;
+		Boxx::Optional<Type> type;
+		Ptr<Variable> var;
+
+		StackAllocExpression(Boxx::UInt size) {
+			kind = NodeKind::StackAllocExpression;
+			this->size = size;
+		}
+
+		StackAllocExpression(Type type) {
+			kind = NodeKind::StackAllocExpression;
+			this->type = type;
+		}
+
+		StackAllocExpression(Ptr<Variable> var) {
+			kind = NodeKind::StackAllocExpression;
+			this->var = var;
+		}
+
+		virtual Type GetType(Interpreter::InterpreterData& data) const override;
+		virtual Interpreter::Data Evaluate(Interpreter::InterpreterData& data) override;
+		virtual Interpreter::Reg CompileEvaluate(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
+	};
+
+	/// A region expression.
+	///
+	/// Creates a memory region and evaluates to its address.
+	/// Use {AllocExpression} to allocate in the region and {DestroyInstruction} to free it.
+	class RegionExpression : public Expression {
+	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::RegionExpression;
+		}
+
+		RegionExpression() {
+			kind = NodeKind::RegionExpression;
+		}
+
+		virtual Type GetType(Interpreter::InterpreterData& data) const override;
+		virtual Interpreter::Data Evaluate(Interpreter::InterpreterData& data) override;
+		virtual Interpreter::Reg CompileEvaluate(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
 	};
 
 	/// A unary expression for numbers.
 	class UnaryNumberExpression : public UnaryExpression {
 	public:
-		UnaryNumberExpression(Boxx::String instructionName, Ptr<Value> value) {
+		static bool classof(const Node* node) {
+			return node->Kind() >= NodeKind::FirstUnaryExpression && node->Kind() <= NodeKind::LastUnaryExpression;
+		}
+
+		UnaryNumberExpression(Boxx::String instructionName, Interpreter::IntOp op, Ptr<Value> value) {
 			this->instructionName = instructionName;
+			this->op = op;
 			this->value = value;
 		}
 
 		virtual Type GetType(Interpreter::InterpreterData& data) const override;
 		virtual Interpreter::Data Evaluate(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual Interpreter::Reg CompileEvaluate(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
 
 	protected:
 		Boxx::String instructionName;
+		Interpreter::IntOp op;
 
-		virtual Boxx::Long Evaluate(Boxx::Long a) = 0;
+		/// The integer type id of the operation.
+		/// Resolved on the first evaluation.
+		Boxx::UInt type = 0;
+		bool resolved = false;
 	};
 
 	/// A binary expression for numbers.
 	class BinaryNumberExpression : public BinaryExpression {
 	public:
-		BinaryNumberExpression(Boxx::String instructionName, Ptr<Value> value1, Ptr<Value> value2) {
+		static bool classof(const Node* node) {
+			return node->Kind() >= NodeKind::FirstBinaryExpression && node->Kind() <= NodeKind::LastBinaryExpression;
+		}
+
+		BinaryNumberExpression(Boxx::String instructionName, Interpreter::IntOp op, Ptr<Value> value1, Ptr<Value> value2) {
 			this->instructionName = instructionName;
+			this->op = op;
 			this->value1 = value1;
 			this->value2 = value2;
 		}
 
 		virtual Type GetType(Interpreter::InterpreterData& data) const override;
 		virtual Interpreter::Data Evaluate(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual Interpreter::Reg CompileEvaluate(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
 
 	protected:
 		Boxx::String instructionName;
+		Interpreter::IntOp op;
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) = 0;
+		/// The integer type ids of the operation and the operands.
+		/// Resolved on the first evaluation.
+		Boxx::UInt type = 0, type1 = 0, type2 = 0;
+		bool resolved = false;
 	};
 
 	/// An negation expression.
 	class NegExpression : public UnaryNumberExpression {
 	public:
-		NegExpression(Ptr<Value> value) : UnaryNumberExpression("neg", value) {
-
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::NegExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a) override {
-			return -a;
+		NegExpression(Ptr<Value> value) : UnaryNumberExpression("neg", Interpreter::IntOp::Neg, value) {
+			kind = NodeKind::NegExpression;
 		}
 	};
 
 	/// A bitwise not expression.
 	class BitNotExpression : public UnaryNumberExpression {
 	public:
-		BitNotExpression(Ptr<Value> value) : UnaryNumberExpression("not", value) {
-
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::BitNotExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a) override {
-			return ~a;
+		BitNotExpression(Ptr<Value> value) : UnaryNumberExpression("not", Interpreter::IntOp::Not, value) {
+			kind = NodeKind::BitNotExpression;
 		}
 	};
 
 	/// An add expression.
 	class AddExpression : public BinaryNumberExpression {
 	public:
-		AddExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("add", value1, value2) {
-			
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::AddExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) override {
-			return a + b;
+		AddExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("add", Interpreter::IntOp::Add, value1, value2) {
+			kind = NodeKind::AddExpression;
 		}
 	};
 
 	/// A subtract expression.
 	class SubExpression : public BinaryNumberExpression {
 	public:
-		SubExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("sub", value1, value2) {
-			
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::SubExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) override {
-			return a - b;
+		SubExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("sub", Interpreter::IntOp::Sub, value1, value2) {
+			kind = NodeKind::SubExpression;
 		}
 	};
 
 	/// A multiplication expression.
 	class MulExpression : public BinaryNumberExpression {
 	public:
-		MulExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("mul", value1, value2) {
-
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::MulExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) override {
-			return a * b;
+		MulExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("mul", Interpreter::IntOp::Mul, value1, value2) {
+			kind = NodeKind::MulExpression;
 		}
 	};
 
 	/// A division expression.
 	class DivExpression : public BinaryNumberExpression {
 	public:
-		DivExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("div", value1, value2) {
-
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::DivExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) override {
-			if (b == 0) throw Interpreter::KiwiInterpretError("div by zero");
-			return a / b;
+		DivExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("div", Interpreter::IntOp::Div, value1, value2) {
+			kind = NodeKind::DivExpression;
 		}
 	};
 
 	/// A modulus expression.
 	class ModExpression : public BinaryNumberExpression {
 	public:
-		ModExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("mod", value1, value2) {
-
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::ModExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) override {
-			if (b == 0) throw Interpreter::KiwiInterpretError("mod by zero");
-			return a % b;
+		ModExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("mod", Interpreter::IntOp::Mod, value1, value2) {
+			kind = NodeKind::ModExpression;
 		}
 	};
 
 	/// A bitwise or expression.
 	class BitOrExpression : public BinaryNumberExpression {
 	public:
-		BitOrExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("or", value1, value2) {
-
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::BitOrExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) override {
-			return a | b;
+		BitOrExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("or", Interpreter::IntOp::Or, value1, value2) {
+			kind = NodeKind::BitOrExpression;
 		}
 	};
 
 	/// A bitwise and expression.
 	class BitAndExpression : public BinaryNumberExpression {
 	public:
-		BitAndExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("and", value1, value2) {
-
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::BitAndExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) override {
-			return a & b;
+		BitAndExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("and", Interpreter::IntOp::And, value1, value2) {
+			kind = NodeKind::BitAndExpression;
 		}
 	};
 
 	/// A bitwise xor expression.
 	class BitXorExpression : public BinaryNumberExpression {
 	public:
-		BitXorExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("xor", value1, value2) {
-
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::BitXorExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) override {
-			return a ^ b;
+		BitXorExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("xor", Interpreter::IntOp::Xor, value1, value2) {
+			kind = NodeKind::BitXorExpression;
 		}
 	};
 
 	/// A left shift expression.
 	class LeftShiftExpression : public BinaryNumberExpression {
 	public:
-		LeftShiftExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("shl", value1, value2) {
-
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::LeftShiftExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) override {
-			return a << b;
+		LeftShiftExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("shl", Interpreter::IntOp::Shl, value1, value2) {
+			kind = NodeKind::LeftShiftExpression;
 		}
 	};
 
 	/// A right shift expression.
 	class RightShiftExpression : public BinaryNumberExpression {
 	public:
-		RightShiftExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("shr", value1, value2) {
-
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::RightShiftExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) override {
-			return a >> b;
+		RightShiftExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("shr", Interpreter::IntOp::Shr, value1, value2) {
+			kind = NodeKind::RightShiftExpression;
 		}
 	};
 
 	/// An equals expression.
 	class EqualExpression : public BinaryNumberExpression {
 	public:
-		EqualExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("eq", value1, value2) {
-
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::EqualExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) override {
-			return a == b;
+		EqualExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("eq", Interpreter::IntOp::Eq, value1, value2) {
+			kind = NodeKind::EqualExpression;
 		}
 	};
 
 	/// A not equals expression.
 	class NotEqualExpression : public BinaryNumberExpression {
 	public:
-		NotEqualExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("ne", value1, value2) {
-
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::NotEqualExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) override {
-			return a != b;
+		NotEqualExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("ne", Interpreter::IntOp::Ne, value1, value2) {
+			kind = NodeKind::NotEqualExpression;
 		}
 	};
 
 	/// A less than expression.
 	class LessExpression : public BinaryNumberExpression {
 	public:
-		LessExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("lt", value1, value2) {
-
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::LessExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) override {
-			return a < b;
+		LessExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("lt", Interpreter::IntOp::Lt, value1, value2) {
+			kind = NodeKind::LessExpression;
 		}
 	};
 
 	/// A greater than expression.
 	class GreaterExpression : public BinaryNumberExpression {
 	public:
-		GreaterExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("gt", value1, value2) {
-
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::GreaterExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) override {
-			return a > b;
+		GreaterExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("gt", Interpreter::IntOp::Gt, value1, value2) {
+			kind = NodeKind::GreaterExpression;
 		}
 	};
 
 	/// A less than or equal expression.
 	class LessEqualExpression : public BinaryNumberExpression {
 	public:
-		LessEqualExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("le", value1, value2) {
-
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::LessEqualExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) override {
-			return a <= b;
+		LessEqualExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("le", Interpreter::IntOp::Le, value1, value2) {
+			kind = NodeKind::LessEqualExpression;
 		}
 	};
 
 	/// A greater than or equal expression.
 	class GreaterEqualExpression : public BinaryNumberExpression {
 	public:
-		GreaterEqualExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("ge", value1, value2) {
-
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::GreaterEqualExpression;
 		}
 
-		virtual Boxx::Long Evaluate(Boxx::Long a, Boxx::Long b) override {
-			return a >= b;
+		GreaterEqualExpression(Ptr<Value> value1, Ptr<Value> value2) : BinaryNumberExpression("ge", Interpreter::IntOp::Ge, value1, value2) {
+			kind = NodeKind::GreaterEqualExpression;
 		}
 	};
 }
@@ -2,50 +2,66 @@
 
 #include "KiwiProgram.h"
 
+#include "Interpreter/BulkMemory.h"
+
 #include "Boxx/Boxx/Console.h"
 
 using namespace Boxx;
 
 using namespace Kiwi;
 
-Ptr<MultiAssignInstruction> AssignInstruction::ToMultiAssign() {
-	Ptr<MultiAssignInstruction> assign;
+void AssignInstruction::Interpret(Interpreter::InterpreterData& data) {
+	if (type && !isa<SubVariable>(var)) {
+		data.frame->CreateVariable(var->name, *type);
+	}
+
+	if (!expression) {
+		if (!type) {
+			throw Interpreter::KiwiInterpretError("invalid expression to assign to '" + var->name + "'");
+		}
 
-	List<Ptr<Variable>> vars;
-	vars.Add(var->Copy());
+		data.frame->SetVarValue(var->name, Interpreter::Data(Type::SizeOf(*type, data.program)));
+		return;
+	}
 
-	List<Weak<Expression>> expressions;
+	MultiAssignInstruction::AssignValue(data, var, expression->Evaluate(data));
+}
 
-	if (expression) {
-		expressions.Add(expression);
+void AssignInstruction::Compile(Interpreter::Compiler& compiler) {
+	if (type && !isa<SubVariable>(var)) {
+		compiler.DeclareVariable(var->name, *type);
 	}
 
-	if (type) {
-		List<Optional<Type>> types;
-		types.Add(type);
-		assign = new MultiAssignInstruction(types, vars, expressions);
+	if (!expression) {
+		if (!type) {
+			throw Interpreter::KiwiInterpretError("invalid expression to assign to '" + var->name + "'");
+		}
+
+		Interpreter::Reg reg = compiler.GetVariable(var->name);
+		compiler.Emit(Interpreter::OpCode::Clear, compiler.RegisterSize(reg), reg);
+	}
+	else if (Weak<CallExpression> call = dyn_cast<CallExpression>(expression)) {
+		List<Weak<Variable>> vars;
+		vars.Add(var);
+		MultiAssignInstruction::CompileCallAssign(compiler, call, vars);
 	}
 	else {
-		assign = new MultiAssignInstruction(vars, expressions);
+		var->CompileAssign(compiler, expression->CompileEvaluate(compiler));
 	}
-
-	return assign;
 }
 
-void AssignInstruction::FreeMultiAssign(Ptr<MultiAssignInstruction> assign) {
-	
-}
+void AssignInstruction::BuildString(TextWriter& builder) {
+	if (type) {
+		builder += type->ToKiwi();
+		builder += ": ";
+	}
 
-void AssignInstruction::Interpret(Interpreter::InterpreterData& data) {
-	Ptr<MultiAssignInstruction> assign = ToMultiAssign();
-	assign->Interpret(data);
-	FreeMultiAssign(assign);
-}
+	var->BuildString(builder);
 
-void AssignInstruction::BuildString(Boxx::StringBuilder& builder) {
-	Ptr<MultiAssignInstruction> assign = ToMultiAssign();
-	assign->BuildString(builder);
-	FreeMultiAssign(assign);
+	if (!expression) return;
+
+	builder += " = ";
+	expression->BuildString(builder);
 }
 
 void MultiAssignInstruction::Interpret(Interpreter::InterpreterData& data) {
@@ -59,7 +75,7 @@ void MultiAssignInstruction::Interpret(Interpreter::InterpreterData& data) {
 		}
 
 		Weak<Variable> var = vars[i];
-		Weak<SubVariable> subVar = var.As<SubVariable>();
+		Weak<SubVariable> subVar = dyn_cast<SubVariable>(var);
 
 		Weak<Expression> expression = nullptr;
 
@@ -89,8 +105,8 @@ void MultiAssignInstruction::Interpret(Interpreter::InterpreterData& data) {
 		Interpreter::Data value;
 		
 		if (i < weakExpressions.Count()) {
-			if (i == weakExpressions.Count() - 1 && expression.Is<CallExpression>()) {
-				extraValues = expression.As<CallExpression>()->EvaluateAll(data);
+			if (i == weakExpressions.Count() - 1 && isa<CallExpression>(expression)) {
+				extraValues = cast<CallExpression>(*expression)->EvaluateAll(data);
 
 				if (extraValues.Length() > 0) {
 					value = extraValues[0];
@@ -104,22 +120,93 @@ void MultiAssignInstruction::Interpret(Interpreter::InterpreterData& data) {
 			value = extraValues[weakExpressions.Count() - i + 1];
 		}
 
-		if (subVar) {
-			Interpreter::DataPtr struct_ = subVar->EvaluateRef(data);
-			Interpreter::Data::Set(struct_, value);
+		AssignValue(data, var, value);
+	}
+}
+
+void MultiAssignInstruction::AssignValue(Interpreter::InterpreterData& data, Weak<Variable> var, Interpreter::Data value) {
+	if (isa<SubVariable>(var) || isa<DerefVariable>(var)) {
+		Interpreter::Data::Set(var->EvaluateRef(data), value);
+	}
+	else {
+		Interpreter::Data val = Interpreter::Data(value, Type::SizeOf(data.frame->GetVarType(var->name), data.program));
+		data.frame->SetVarValue(var->name, val);
+	}
+}
+
+void MultiAssignInstruction::Compile(Interpreter::Compiler& compiler) {
+	for (UInt i = 0; i < vars.Count(); i++) {
+		Optional<Type> type = nullptr;
+
+		if (types.Count() > 0) {
+			type = types.Count() == 1 ? types[0] : types[i];
 		}
-		else if (Weak<DerefVariable> deref = var.As<DerefVariable>()) {
-			Interpreter::DataPtr struct_ = var->EvaluateRef(data);
-			Interpreter::Data::Set(struct_, value);
+
+		Weak<Variable> var = vars[i];
+
+		if (type && !isa<SubVariable>(var)) {
+			compiler.DeclareVariable(var->name, *type);
+		}
+
+		if (weakExpressions.IsEmpty() || (i < weakExpressions.Count() && !weakExpressions[i])) {
+			if (!type) {
+				throw Interpreter::KiwiInterpretError("invalid expression to assign to '" + var->name + "'");
+			}
+
+			Interpreter::Reg reg = compiler.GetVariable(var->name);
+			compiler.Emit(Interpreter::OpCode::Clear, compiler.RegisterSize(reg), reg);
+		}
+	}
+
+	for (UInt i = 0; i < vars.Count() && i < weakExpressions.Count(); i++) {
+		Weak<Expression> expression = weakExpressions[i];
+
+		if (!expression) continue;
+
+		if (i == weakExpressions.Count() - 1 && isa<CallExpression>(expression)) {
+			List<Weak<Variable>> callVars;
+
+			for (UInt u = i; u < vars.Count(); u++) {
+				callVars.Add(vars[u]);
+			}
+
+			CompileCallAssign(compiler, cast<CallExpression>(expression), callVars);
+			return;
+		}
+
+		vars[i]->CompileAssign(compiler, expression->CompileEvaluate(compiler));
+	}
+
+	for (UInt i = weakExpressions.Count(); i < vars.Count(); i++) {
+		if (!isa<SubVariable>(vars[i]) && !isa<DerefVariable>(vars[i])) {
+			Interpreter::Reg reg = compiler.GetVariable(vars[i]->name);
+			compiler.Emit(Interpreter::OpCode::Clear, compiler.RegisterSize(reg), reg);
+		}
+	}
+}
+
+void MultiAssignInstruction::CompileCallAssign(Interpreter::Compiler& compiler, Weak<CallExpression> call, const List<Weak<Variable>>& vars) {
+	List<Interpreter::Reg> results;
+
+	for (Weak<Variable> var : vars) {
+		if (isa<SubVariable>(var) || isa<DerefVariable>(var)) {
+			results.Add(compiler.AddRegister(Type::SizeOf(var->GetType(compiler.typeData), compiler.program)));
 		}
 		else {
-			Interpreter::Data val = Interpreter::Data(value, Type::SizeOf(data.frame->GetVarType(var->name), data.program));
-			data.frame->SetVarValue(var->name, val);
+			results.Add(compiler.GetVariable(var->name));
+		}
+	}
+
+	call->CompileCall(compiler, results);
+
+	for (UInt i = 0; i < vars.Count(); i++) {
+		if (isa<SubVariable>(vars[i]) || isa<DerefVariable>(vars[i])) {
+			vars[i]->CompileAssign(compiler, results[i]);
 		}
 	}
 }
 
-void MultiAssignInstruction::BuildString(Boxx::StringBuilder& builder) {
+void MultiAssignInstruction::BuildString(TextWriter& builder) {
 	if (types.Count() > 0) {
 		for (UInt i = 0; i < types.Count(); i++) {
 			if (i > 0) builder += ", ";
@@ -178,7 +265,25 @@ void OffsetAssignInstruction::Interpret(Interpreter::InterpreterData& data) {
 	Interpreter::Data::Set(ptr, expression->Evaluate(data));
 }
 
-void OffsetAssignInstruction::BuildString(Boxx::StringBuilder& builder) {
+void OffsetAssignInstruction::Compile(Interpreter::Compiler& compiler) {
+	Interpreter::MemRef ref = var->CompileRef(compiler);
+
+	UInt offsetSize = type ? Type::SizeOf(*type, compiler.program) : 1;
+
+	if (Weak<Integer> integer = dyn_cast<Integer>(offset)) {
+		ref.offset += (Long)offsetSize * (Long)integer->value;
+	}
+	else {
+		Interpreter::Reg index = offset->CompileEvaluate(compiler);
+		Interpreter::Reg ptr   = compiler.AddRegister(compiler.program->PointerSize());
+		compiler.Emit(Interpreter::OpCode::Index, compiler.RegisterSize(index), ptr, compiler.Materialize(ref), index, offsetSize);
+		ref = Interpreter::MemRef{false, ptr, 0};
+	}
+
+	compiler.Store(ref, expression->CompileEvaluate(compiler));
+}
+
+void OffsetAssignInstruction::BuildString(TextWriter& builder) {
 	var->BuildString(builder);
 	builder += '[';
 
@@ -198,13 +303,19 @@ void CopyInstruction::Interpret(Interpreter::InterpreterData& data) {
 	Interpreter::Data srcData  = src->Evaluate(data);
 	Interpreter::Data sizeData = size->Evaluate(data);
 
-	Interpreter::DataPtr dstPtr = dstData.Get<Interpreter::DataPtr>();
-	Interpreter::DataPtr srcPtr = srcData.Get<Interpreter::DataPtr>();
+	UInt bytes = (UInt)sizeData.GetNumber(sizeData.Size());
+	Interpreter::BulkMemory::Copy(data.FromPointer(data.GetPointer(dstData), bytes), data.FromPointer(data.GetPointer(srcData), bytes), bytes);
+}
+
+void CopyInstruction::Compile(Interpreter::Compiler& compiler) {
+	Interpreter::Reg dstReg  = dst->CompileEvaluate(compiler);
+	Interpreter::Reg srcReg  = src->CompileEvaluate(compiler);
+	Interpreter::Reg sizeReg = size->CompileEvaluate(compiler);
 
-	std::memcpy(dstPtr, srcPtr, sizeData.GetNumber(sizeData.Size()));
+	compiler.Emit(Interpreter::OpCode::Copy, compiler.RegisterSize(sizeReg), dstReg, srcReg, sizeReg);
 }
 
-void CopyInstruction::BuildString(Boxx::StringBuilder& builder) {
+void CopyInstruction::BuildString(TextWriter& builder) {
 	builder += "copy ";
 	dst->BuildString(builder);
 	builder += ", ";
@@ -213,46 +324,139 @@ void CopyInstruction::BuildString(Boxx::StringBuilder& builder) {
 	size->BuildString(builder);
 }
 
+void FillInstruction::Interpret(Interpreter::InterpreterData& data) {
+	Interpreter::Data dstData   = dst->Evaluate(data);
+	Interpreter::Data valueData = value->Evaluate(data);
+	Interpreter::Data sizeData  = size->Evaluate(data);
+
+	UInt bytes = (UInt)sizeData.GetNumber(sizeData.Size());
+	Interpreter::BulkMemory::Fill(data.FromPointer(data.GetPointer(dstData), bytes), (UByte)valueData.GetNumber(valueData.Size()), bytes);
+}
+
+void FillInstruction::Compile(Interpreter::Compiler& compiler) {
+	Interpreter::Reg dstReg   = dst->CompileEvaluate(compiler);
+	Interpreter::Reg valueReg = value->CompileEvaluate(compiler);
+	Interpreter::Reg sizeReg  = size->CompileEvaluate(compiler);
+
+	compiler.Emit(Interpreter::OpCode::Fill, compiler.RegisterSize(sizeReg), dstReg, valueReg, sizeReg);
+}
+
+void FillInstruction::BuildString(TextWriter& builder) {
+	builder += "fill ";
+	dst->BuildString(builder);
+	builder += ", ";
+	value->BuildString(builder);
+	builder += ", ";
+	size->BuildString(builder);
+}
+
+void MoveInstruction::Interpret(Interpreter::InterpreterData& data) {
+	Interpreter::Data dstData  = dst->Evaluate(data);
+	Interpreter::Data srcData  = src->Evaluate(data);
+	Interpreter::Data sizeData = size->Evaluate(data);
+
+	UInt bytes = (UInt)sizeData.GetNumber(sizeData.Size());
+	Interpreter::BulkMemory::Move(data.FromPointer(data.GetPointer(dstData), bytes), data.FromPointer(data.GetPointer(srcData), bytes), bytes);
+}
+
+void MoveInstruction::Compile(Interpreter::Compiler& compiler) {
+	Interpreter::Reg dstReg  = dst->CompileEvaluate(compiler);
+	Interpreter::Reg srcReg  = src->CompileEvaluate(compiler);
+	Interpreter::Reg sizeReg = size->CompileEvaluate(compiler);
+
+	compiler.Emit(Interpreter::OpCode::Move, compiler.RegisterSize(sizeReg), dstReg, srcReg, sizeReg);
+}
+
+void MoveInstruction::BuildString(TextWriter& builder) {
+	builder += "move ";
+	dst->BuildString(builder);
+	builder += ", ";
+	src->BuildString(builder);
+	builder += ", ";
+	size->BuildString(builder);
+}
+
 void CallInstruction::Interpret(Interpreter::InterpreterData& data) {
 	call->Evaluate(data);
 }
 
-void CallInstruction::BuildString(Boxx::StringBuilder& builder) {
+void CallInstruction::Compile(Interpreter::Compiler& compiler) {
+	call->CompileCall(compiler, List<Interpreter::Reg>());
+}
+
+void CallInstruction::BuildString(TextWriter& builder) {
 	call->BuildString(builder);
 }
 
+static UInt ResolveLabel(const Map<String, UInt>& labels, const String& label) {
+	UInt index;
+
+	if (!labels.Contains(label, index)) {
+		throw Interpreter::KiwiInterpretError("label '" + Name::ToKiwi(label) + "' not found");
+	}
+
+	return index;
+}
+
+void GotoInstruction::ResolveLabels(const Map<String, UInt>& labels) {
+	target = ResolveLabel(labels, label);
+}
+
 void GotoInstruction::Interpret(Interpreter::InterpreterData& data) {
-	data.gotoLabel = label;
+	data.gotoBlock = target;
+}
+
+void GotoInstruction::Compile(Interpreter::Compiler& compiler) {
+	compiler.EmitJump(target);
 }
 
 IfInstruction::IfInstruction(Ptr<Expression> condition, const Boxx::String& label) {
+	kind = NodeKind::IfInstruction;
 	this->condition  = condition;
 	this->trueLabel  = label;
 	this->falseLabel = nullptr;
 }
 
 IfInstruction::IfInstruction(Ptr<Expression> condition, const Boxx::Optional<Boxx::String>& trueLabel, const Boxx::Optional<Boxx::String>& falseLabel) {
+	kind = NodeKind::IfInstruction;
 	this->condition  = condition;
 	this->trueLabel  = trueLabel;
 	this->falseLabel = falseLabel;
 }
 
+void IfInstruction::ResolveLabels(const Map<String, UInt>& labels) {
+	trueTarget  = nullptr;
+	falseTarget = nullptr;
+
+	if (trueLabel) {
+		trueTarget = ResolveLabel(labels, *trueLabel);
+	}
+
+	if (falseLabel) {
+		falseTarget = ResolveLabel(labels, *falseLabel);
+	}
+}
+
 void IfInstruction::Interpret(Interpreter::InterpreterData& data) {
 	Interpreter::Data value = condition->Evaluate(data);
 
 	if (value.GetNumber(Type::SizeOf(condition->GetType(data), data.program)) != 0) {
-		if (trueLabel) {
-			data.gotoLabel = *trueLabel;
+		if (trueTarget) {
+			data.gotoBlock = *trueTarget;
 		}
 	}
 	else {
-		if (falseLabel) {
-			data.gotoLabel = *falseLabel;
+		if (falseTarget) {
+			data.gotoBlock = *falseTarget;
 		}
 	}
 }
 
-void IfInstruction::BuildString(Boxx::StringBuilder& builder) {
+void IfInstruction::Compile(Interpreter::Compiler& compiler) {
+	compiler.EmitJumpIf(condition->CompileEvaluate(compiler), trueTarget, falseTarget);
+}
+
+void IfInstruction::BuildString(TextWriter& builder) {
 	builder += "if ";
 	condition->BuildString(builder);
 	builder += ": ";
@@ -271,24 +475,50 @@ void IfInstruction::BuildString(Boxx::StringBuilder& builder) {
 }
 
 FreeInstruction::FreeInstruction(Ptr<Value> value) {
+	kind = NodeKind::FreeInstruction;
 	this->value = value;
 }
 
 void FreeInstruction::Interpret(Interpreter::InterpreterData& data) {
 	Interpreter::Data value = this->value->Evaluate(data);
-	data.heap->Free(value.Get<Interpreter::DataPtr>());
+	Interpreter::DataPtr ptr = data.FromPointer(data.GetPointer(value), 0);
+	data.heap->Free(ptr);
+
+	if (data.profiler) {
+		data.profiler->Free(ptr);
+	}
 }
 
-void FreeInstruction::BuildString(Boxx::StringBuilder& builder) {
+void FreeInstruction::Compile(Interpreter::Compiler& compiler) {
+	Interpreter::Reg reg = value->CompileEvaluate(compiler);
+	compiler.Emit(Interpreter::OpCode::Free, compiler.RegisterSize(reg), reg);
+}
+
+void FreeInstruction::BuildString(TextWriter& builder) {
 	builder += "free ";
 	value->BuildString(builder);
 }
 
+void DestroyInstruction::Interpret(Interpreter::InterpreterData& data) {
+	Interpreter::Data value = region->Evaluate(data);
+	data.heap->DestroyRegion(data.FromPointer(data.GetPointer(value), 0));
+}
+
+void DestroyInstruction::Compile(Interpreter::Compiler& compiler) {
+	Interpreter::Reg reg = region->CompileEvaluate(compiler);
+	compiler.Emit(Interpreter::OpCode::Destroy, compiler.RegisterSize(reg), reg);
+}
+
+void DestroyInstruction::BuildString(TextWriter& builder) {
+	builder += "destroy ";
+	region->BuildString(builder);
+}
+
 void DebugPrintInstruction::Interpret(Interpreter::InterpreterData& data) {
 	Interpreter::Data value = this->value->Evaluate(data);
 
 	if (type == "str") {
-		Interpreter::DataPtr ptr = value.Get<Interpreter::DataPtr>();
+		Interpreter::DataPtr ptr = data.FromPointer(data.GetPointer(value), 1);
 
 		if (data.heap->IsAllocated(ptr)) {
 			UInt size = data.heap->GetSize(ptr);
@@ -319,13 +549,24 @@ void DebugPrintInstruction::Interpret(Interpreter::InterpreterData& data) {
 	UInt size = value.Size();
 
 	if (type.pointers > 0) {
-		Interpreter::DataPtr ptr2 = value.Get<Interpreter::DataPtr>();
+		ULong pointer = data.GetPointer(value);
+
+		if (data.image && !data.image->InBounds(pointer, 0)) {
+			pointer = 0;
+		}
+
+		Interpreter::DataPtr ptr2 = pointer ? data.FromPointer(pointer, 0) : nullptr;
 
 		if (data.heap->IsAllocated(ptr2)) {
 			Console::Write('*');
 			size = data.heap->GetSize(ptr2);
 			ptr = ptr2;
 		}
+		else if (UInt length = data.strings->GetSize(ptr2)) {
+			Console::Write('*');
+			size = length;
+			ptr = ptr2;
+		}
 	}
 
 	for (UInt i = 0; i < size; i++) {
@@ -336,7 +577,25 @@ void DebugPrintInstruction::Interpret(Interpreter::InterpreterData& data) {
 	Console::Print();
 }
 
-void DebugPrintInstruction::BuildString(StringBuilder& builder) {
+void DebugPrintInstruction::Compile(Interpreter::Compiler& compiler) {
+	Interpreter::PrintMode mode = Interpreter::PrintMode::Bytes;
+	bool pointer = false;
+
+	if (type == "str") {
+		mode = Interpreter::PrintMode::Str;
+	}
+	else if (type == "chr") {
+		mode = Interpreter::PrintMode::Chr;
+	}
+	else {
+		pointer = value->GetType(compiler.typeData).pointers > 0;
+	}
+
+	Interpreter::Reg reg = value->CompileEvaluate(compiler);
+	compiler.Emit(Interpreter::OpCode::Print, compiler.RegisterSize(reg), reg, (UInt)mode, pointer ? 1 : 0);
+}
+
+void DebugPrintInstruction::BuildString(TextWriter& builder) {
 	builder += "_print ";
 
 	if (type) {
@@ -7,6 +7,7 @@
 #include "Boxx/Boxx/String.h"
 #include "Boxx/Boxx/Pointer.h"
 #include "Boxx/Boxx/Optional.h"
+#include "Boxx/Boxx/Map.h"
 
 ///N Kiwi
 
@@ -14,6 +15,14 @@ namespace Kiwi {
 	/// A kiwi instruction.
 	class Instruction : public Node {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() >= NodeKind::FirstInstruction && node->Kind() <= NodeKind::LastInstruction;
+		}
+
+		Instruction() {
+			kind = NodeKind::Instruction;
+		}
+
 		/// {true} if the instruction reads from the specified variable.
 		virtual bool ReadsFromVariable(const Boxx::String& var) const {
 			return false;
@@ -29,7 +38,10 @@ namespace Kiwi {
 			return ReadsFromVariable(var) || WritesToVariable(var);
 		}
 
-		virtual void BuildString(Boxx::StringBuilder& builder) override {
+		/// Resolves the labels used by the instruction to block indices.
+		virtual void ResolveLabels(const Boxx::Map<Boxx::String, Boxx::UInt>& labels) {}
+
+		virtual void BuildString(TextWriter& builder) override {
 			builder += "unknown instruction";
 		}
 	};
@@ -39,6 +51,10 @@ namespace Kiwi {
 	/// An assignment instruction.
 	class AssignInstruction : public Instruction {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::AssignInstruction;
+		}
+
 		/// The type of the variable.
 		Boxx::Optional<Kiwi::Type> type;
 
@@ -49,40 +65,45 @@ namespace Kiwi {
 		Ptr<Expression> expression;
 
 		AssignInstruction(const Boxx::String& var, Ptr<Expression> expression) {
+			kind = NodeKind::AssignInstruction;
 			this->type = nullptr;
 			this->var  = new Kiwi::Variable(var);
 			this->expression = expression;
 		}
 
 		AssignInstruction(const Kiwi::Type& type, const Boxx::String& var, Ptr<Expression> expression) {
+			kind = NodeKind::AssignInstruction;
 			this->type = type;
 			this->var  = new Kiwi::Variable(var);
 			this->expression = expression;
 		}
 
 		AssignInstruction(Ptr<Variable> var, Ptr<Expression> expression) {
+			kind = NodeKind::AssignInstruction;
 			this->type = nullptr;
 			this->var  = var;
 			this->expression = expression;
 		}
 
 		AssignInstruction(const Kiwi::Type& type, Ptr<Variable> var, Ptr<Expression> expression) {
+			kind = NodeKind::AssignInstruction;
 			this->type = type;
 			this->var  = var;
 			this->expression = expression;
 		}
 
 		virtual void Interpret(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
-
-	private:
-		Ptr<MultiAssignInstruction> ToMultiAssign();
-		void FreeMultiAssign(Ptr<MultiAssignInstruction> assign);
+		virtual void Compile(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
 	};
 
 	/// A multi assignment instruction.
 	class MultiAssignInstruction : public Instruction {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::MultiAssignInstruction;
+		}
+
 		/// The types of the variables.
 		Boxx::List<Boxx::Optional<Kiwi::Type>> types;
 
@@ -96,6 +117,7 @@ namespace Kiwi {
 		Boxx::List<Weak<Expression>> weakExpressions;
 
 		MultiAssignInstruction(const Boxx::List<Ptr<Variable>>& vars, const Boxx::List<Ptr<Expression>>& expressions) {
+			kind = NodeKind::MultiAssignInstruction;
 			this->types = Boxx::List<Boxx::Optional<Kiwi::Type>>();
 			this->vars  = vars;
 			this->expressions = expressions;
@@ -106,6 +128,7 @@ namespace Kiwi {
 		}
 
 		MultiAssignInstruction(const Boxx::List<Boxx::Optional<Kiwi::Type>>& types, const Boxx::List<Ptr<Variable>>& vars, const Boxx::List<Ptr<Expression>>& expressions) {
+			kind = NodeKind::MultiAssignInstruction;
 			this->types = types;
 			this->vars  = vars;
 			this->expressions = expressions;
@@ -116,24 +139,37 @@ namespace Kiwi {
 		}
 
 		MultiAssignInstruction(const Boxx::List<Ptr<Variable>>& vars, const Boxx::List<Weak<Expression>>& expressions) {
+			kind = NodeKind::MultiAssignInstruction;
 			this->types = Boxx::List<Boxx::Optional<Kiwi::Type>>();
 			this->vars  = vars;
 			this->weakExpressions = expressions;
 		}
 
 		MultiAssignInstruction(const Boxx::List<Boxx::Optional<Kiwi::Type>>& types, const Boxx::List<Ptr<Variable>>& vars, const Boxx::List<Weak<Expression>>& expressions) {
+			kind = NodeKind::MultiAssignInstruction;
 			this->types = types;
 			this->vars  = vars;
 			this->weakExpressions = expressions;
 		}
 
 		virtual void Interpret(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual void Compile(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
+
+		/// Assigns a value to a variable.
+		static void AssignValue(Interpreter::InterpreterData& data, Weak<Variable> var, Interpreter::Data value);
+
+		/// Compiles a call that assigns its return values to the specified variables.
+		static void CompileCallAssign(Interpreter::Compiler& compiler, Weak<CallExpression> call, const Boxx::List<Weak<Variable>>& vars);
 	};
 
 	/// An assignment instruction to an offset.
 	class OffsetAssignInstruction : public Instruction {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::OffsetAssignInstruction;
+		}
+
 		Ptr<Variable> var;
 		Ptr<Expression> expression;
 
@@ -141,12 +177,14 @@ namespace Kiwi {
 		Ptr<Value> offset;
 
 		OffsetAssignInstruction(const Ptr<Variable> var, Ptr<Expression> expression, Boxx::UInt offset) {
+			kind = NodeKind::OffsetAssignInstruction;
 			this->var = var;
 			this->expression = expression;
 			this->offset = new Kiwi::Integer(Type("u32"), offset);
 		}
 
 		OffsetAssignInstruction(const Ptr<Variable> var, Ptr<Expression> expression, Type type, Boxx::UInt offset) {
+			kind = NodeKind::OffsetAssignInstruction;
 			this->var = var;
 			this->expression = expression;
 			this->type = type;
@@ -154,6 +192,7 @@ namespace Kiwi {
 		}
 
 		OffsetAssignInstruction(const Ptr<Variable> var, Ptr<Expression> expression, Type type, Ptr<Value> offset) {
+			kind = NodeKind::OffsetAssignInstruction;
 			this->var = var;
 			this->expression = expression;
 			this->type = type;
@@ -161,48 +200,116 @@ namespace Kiwi {
 		}
 
 		virtual void Interpret(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual void Compile(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
 	};
 
 	/// A copy instruction.
 	class CopyInstruction : public Instruction {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::CopyInstruction;
+		}
+
 		Ptr<Value> dst, src, size;
 
 		CopyInstruction(Ptr<Value> dst, Ptr<Value> src, Ptr<Value> size) {
+			kind = NodeKind::CopyInstruction;
+			this->dst  = dst;
+			this->src  = src;
+			this->size = size;
+		}
+
+		virtual void Interpret(Interpreter::InterpreterData& data) override;
+		virtual void Compile(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
+	};
+
+	/// A fill instruction.
+	class FillInstruction : public Instruction {
+	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::FillInstruction;
+		}
+
+		/// The low byte of {value} is written to each byte.
+		Ptr<Value> dst, value, size;
+
+		FillInstruction(Ptr<Value> dst, Ptr<Value> value, Ptr<Value> size) {
+			kind = NodeKind::FillInstruction;
+			this->dst   = dst;
+			this->value = value;
+			this->size  = size;
+		}
+
+		virtual void Interpret(Interpreter::InterpreterData& data) override;
+		virtual void Compile(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
+	};
+
+	/// A move instruction.
+	///
+	/// Same as {CopyInstruction} but the memory may overlap.
+	class MoveInstruction : public Instruction {
+	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::MoveInstruction;
+		}
+
+		Ptr<Value> dst, src, size;
+
+		MoveInstruction(Ptr<Value> dst, Ptr<Value> src, Ptr<Value> size) {
+			kind = NodeKind::MoveInstruction;
 			this->dst  = dst;
 			this->src  = src;
 			this->size = size;
 		}
 
 		virtual void Interpret(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual void Compile(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
 	};
 
 	/// A call instruction.
 	class CallInstruction : public Instruction {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::CallInstruction;
+		}
+
 		/// The call.
 		Ptr<CallExpression> call;
 
 		CallInstruction(Ptr<CallExpression> call) {
+			kind = NodeKind::CallInstruction;
 			this->call = call;
 		}
 
 		virtual void Interpret(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual void Compile(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
 	};
 
 	/// A return instruction.
 	class ReturnInstruction : public Instruction {
 	public:
-		ReturnInstruction() {}
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::ReturnInstruction;
+		}
+
+		ReturnInstruction() {
+			kind = NodeKind::ReturnInstruction;
+		}
 
 		virtual void Interpret(Interpreter::InterpreterData& data) override {
 			data.ret = true;
 		}
 
-		virtual void BuildString(Boxx::StringBuilder& builder) override {
+		virtual void Compile(Interpreter::Compiler& compiler) override {
+			compiler.Emit(Interpreter::OpCode::Ret, 0, 0);
+		}
+
+		virtual void BuildString(TextWriter& builder) override {
 			builder += "ret";
 		}
 	};
@@ -210,16 +317,27 @@ namespace Kiwi {
 	/// A goto instruction.
 	class GotoInstruction : public Instruction {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::GotoInstruction;
+		}
+
 		/// The label to go to.
 		Boxx::String label;
 
+		/// The index of the block to go to.
+		/// Set by {ResolveLabels}.
+		Boxx::UInt target = 0;
+
 		GotoInstruction(const Boxx::String& label) {
+			kind = NodeKind::GotoInstruction;
 			this->label = label;
 		}
 
+		virtual void ResolveLabels(const Boxx::Map<Boxx::String, Boxx::UInt>& labels) override;
 		virtual void Interpret(Interpreter::InterpreterData& data) override;
+		virtual void Compile(Interpreter::Compiler& compiler) override;
 
-		virtual void BuildString(Boxx::StringBuilder& builder) override {
+		virtual void BuildString(TextWriter& builder) override {
 			builder += "goto ";
 			builder += Name::ToKiwi(label);
 		}
@@ -228,6 +346,10 @@ namespace Kiwi {
 	/// An if instruction.
 	class IfInstruction : public Instruction {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::IfInstruction;
+		}
+
 		/// The condition
 		Ptr<Expression> condition;
 
@@ -237,34 +359,77 @@ namespace Kiwi {
 		/// The label to use if the condition is false
 		Boxx::Optional<Boxx::String> falseLabel;
 
+		/// The block indices for {trueLabel} and {falseLabel}.
+		/// Set by {ResolveLabels}.
+		Boxx::Optional<Boxx::UInt> trueTarget, falseTarget;
+
 		IfInstruction(Ptr<Expression> condition, const Boxx::String& label);
 		IfInstruction(Ptr<Expression> condition, const Boxx::Optional<Boxx::String>& trueLabel, const Boxx::Optional<Boxx::String>& falseLabel);
 
+		virtual void ResolveLabels(const Boxx::Map<Boxx::String, Boxx::UInt>& labels) override;
 		virtual void Interpret(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual void Compile(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
 	};
 
 	/// Instruction for freeing up memory.
 	class FreeInstruction : public Instruction {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::FreeInstruction;
+		}
+
 		/// The condition
 		Ptr<Value> value;
 
 		FreeInstruction(Ptr<Value> value);
 
 		virtual void Interpret(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual void Compile(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
+	};
+
+	/// Instruction for destroying a memory region.
+	///
+	/// Frees all memory allocated in the region.
+	class DestroyInstruction : public Instruction {
+	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::DestroyInstruction;
+		}
+
+		/// The region.
+		Ptr<Value> region;
+
+		DestroyInstruction(Ptr<Value> region) {
+			kind = NodeKind::DestroyInstruction;
+			this->region = region;
+		}
+
+		virtual void Interpret(Interpreter::InterpreterData& data) override;
+		virtual void Compile(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
 	};
 
 	/// Base for instructions used for debugging.
 	class DebugInstruction : public Instruction {
 	public:
-	
+		static bool classof(const Node* node) {
+			return node->Kind() >= NodeKind::FirstDebugInstruction && node->Kind() <= NodeKind::LastDebugInstruction;
+		}
+
+		DebugInstruction() {
+			kind = NodeKind::DebugInstruction;
+		}
 	};
 
 	/// A print instruction for debugging.
 	class DebugPrintInstruction : public DebugInstruction {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::DebugPrintInstruction;
+		}
+
 		/// The value to print.
 		Ptr<Value> value;
 
@@ -272,10 +437,12 @@ namespace Kiwi {
 		Boxx::Optional<Boxx::String> type;
 
 		DebugPrintInstruction(Ptr<Value> value) {
+			kind = NodeKind::DebugPrintInstruction;
 			this->value = value;
 		}
 
 		virtual void Interpret(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual void Compile(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
 	};
 }
@@ -0,0 +1,134 @@
+#include "Benchmark.h"
+
+#include "Compiler.h"
+#include "VM.h"
+
+#include "../KiwiProgram.h"
+
+#include "../Boxx/Boxx/Console.h"
+
+#include <chrono>
+
+using namespace Boxx;
+
+using namespace Kiwi;
+using namespace Kiwi::Interpreter;
+
+BenchmarkResult Benchmark::CompareDispatch(const String& name, Weak<KiwiProgram> program, UInt runs) {
+	BenchmarkResult result;
+	result.name = name;
+
+	Measure(program, Dispatch::Switch, 1);
+
+	result.switchTime   = Measure(program, Dispatch::Switch, runs);
+	result.threadedTime = Measure(program, Dispatch::Threaded, runs);
+
+	return result;
+}
+
+ULong Benchmark::Measure(Weak<KiwiProgram> program, Dispatch dispatch, UInt runs) {
+	if (program->staticData.Count() > 0) {
+		throw KiwiInterpretError("benchmark programs can not have static data");
+	}
+
+	program->ResolveLabels();
+
+	InterpreterData data;
+	data.program  = program;
+	data.dispatch = dispatch;
+
+	// Compiling and setting up the program is not part of the measured time
+	Compiler compiler = Compiler(program);
+	Ptr<CompiledProgram> compiled = compiler.Compile();
+
+	List<String> literals;
+
+	for (const String& literal : compiled->strings) {
+		literals.Add(literal);
+	}
+
+	data.strings->Add(literals);
+
+	VM vm = VM(data, compiled);
+	ULong time = 0;
+
+	for (UInt i = 0; i < runs; i++) {
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		for (Weak<CompiledFunction> block : compiled->blocks) {
+			vm.Run(block);
+		}
+
+		std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+		time += (ULong)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+	}
+
+	return time;
+}
+
+void Benchmark::Run(UInt runs) {
+	Ptr<KiwiProgram> loop = LoopProgram(1000000);
+	Ptr<KiwiProgram> fib  = FibProgram(22);
+
+	Print(CompareDispatch("loop", loop, runs));
+	Print(CompareDispatch("fib", fib, runs));
+}
+
+void Benchmark::Print(const BenchmarkResult& result) {
+	Console::Print(result.name + ": switch " + String::ToString(result.switchTime) + " us, threaded " + String::ToString(result.threadedTime) + " us");
+}
+
+Ptr<KiwiProgram> Benchmark::LoopProgram(Long count) {
+	Ptr<KiwiProgram> program = new KiwiProgram();
+
+	Ptr<CodeBlock> code = program->New<CodeBlock>(program->arena);
+	code->mainBlock->AddInstruction(program->New<AssignInstruction>(Type("i64"), "i", program->New<Kiwi::Integer>(Type("i64"), 0)));
+	code->mainBlock->AddInstruction(program->New<AssignInstruction>(Type("i64"), "sum", program->New<Kiwi::Integer>(Type("i64"), 0)));
+
+	Ptr<InstructionBlock> loop = program->New<InstructionBlock>("loop");
+	loop->AddInstruction(program->New<AssignInstruction>("sum", program->New<AddExpression>(program->New<Variable>("sum"), program->New<Variable>("i"))));
+	loop->AddInstruction(program->New<AssignInstruction>("i", program->New<AddExpression>(program->New<Variable>("i"), program->New<Kiwi::Integer>(Type("i64"), 1))));
+	loop->AddInstruction(program->New<IfInstruction>(program->New<LessExpression>(program->New<Variable>("i"), program->New<Kiwi::Integer>(Type("i64"), count)), String("loop")));
+	code->AddInstructionBlock(loop);
+
+	program->AddCodeBlock(code);
+	return program;
+}
+
+Ptr<KiwiProgram> Benchmark::FibProgram(Long n) {
+	Ptr<KiwiProgram> program = new KiwiProgram();
+
+	Ptr<Function> fib = program->New<Function>("fib", program->arena);
+	fib->AddArgument(Type("i32"), "n");
+	fib->AddReturnValue(Type("i32"), "r");
+	fib->AddInstruction(program->New<IfInstruction>(program->New<LessExpression>(program->New<Variable>("n"), program->New<Kiwi::Integer>(Type("i32"), 2)), String("small")));
+	fib->AddInstruction(program->New<AssignInstruction>(Type("i32"), "m", program->New<SubExpression>(program->New<Variable>("n"), program->New<Kiwi::Integer>(Type("i32"), 1))));
+
+	Ptr<CallExpression> first = program->New<CallExpression>("fib");
+	first->args.Add(program->New<Variable>("m"));
+	fib->AddInstruction(program->New<AssignInstruction>(Type("i32"), "a", first));
+
+	fib->AddInstruction(program->New<AssignInstruction>("m", program->New<SubExpression>(program->New<Variable>("n"), program->New<Kiwi::Integer>(Type("i32"), 2))));
+
+	Ptr<CallExpression> second = program->New<CallExpression>("fib");
+	second->args.Add(program->New<Variable>("m"));
+	fib->AddInstruction(program->New<AssignInstruction>(Type("i32"), "b", second));
+
+	fib->AddInstruction(program->New<AssignInstruction>("r", program->New<AddExpression>(program->New<Variable>("a"), program->New<Variable>("b"))));
+	fib->AddInstruction(program->New<ReturnInstruction>());
+
+	Ptr<InstructionBlock> small = program->New<InstructionBlock>("small");
+	small->AddInstruction(program->New<AssignInstruction>("r", program->New<Variable>("n")));
+	fib->block->AddInstructionBlock(small);
+
+	program->AddFunction(fib);
+
+	Ptr<CodeBlock> code = program->New<CodeBlock>(program->arena);
+	Ptr<CallExpression> call = program->New<CallExpression>("fib");
+	call->args.Add(program->New<Kiwi::Integer>(Type("i32"), n));
+	code->mainBlock->AddInstruction(program->New<AssignInstruction>(Type("i32"), "result", call));
+	program->AddCodeBlock(code);
+
+	return program;
+}
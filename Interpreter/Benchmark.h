@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../Ptr.h"
+
+#include "../Boxx/Boxx/String.h"
+#include "../Boxx/Boxx/List.h"
+
+#include "Interpreter.h"
+
+///N Kiwi::Interpreter
+
+namespace Kiwi {
+	namespace Interpreter {
+		/// The result of a dispatch benchmark.
+		struct BenchmarkResult {
+			/// The name of the benchmarked program.
+			Boxx::String name;
+
+			/// The total run time in microseconds using switch dispatch.
+			Boxx::ULong switchTime = 0;
+
+			/// The total run time in microseconds using threaded dispatch.
+			Boxx::ULong threadedTime = 0;
+		};
+
+		/// Compares the bytecode dispatch modes.
+		class Benchmark {
+		public:
+			/// Runs a program {runs} times with each dispatch mode.
+			static BenchmarkResult CompareDispatch(const Boxx::String& name, Weak<KiwiProgram> program, Boxx::UInt runs = 5);
+
+			/// Runs a program {runs} times with the specified dispatch.
+			///
+			/// The program is compiled once and only {VM::Run} is timed.
+			/// The program can not have static data.
+			///R time: The total run time in microseconds.
+			static Boxx::ULong Measure(Weak<KiwiProgram> program, Dispatch dispatch, Boxx::UInt runs = 5);
+
+			/// Compares the dispatch modes on the built in benchmark programs and prints the results.
+			///
+			/// Run the interpreter with {--benchmark} to call this.
+			static void Run(Boxx::UInt runs = 5);
+
+			/// Prints a benchmark result.
+			static void Print(const BenchmarkResult& result);
+
+			/// Creates a program that sums the integers below {count} in a loop.
+			static Ptr<KiwiProgram> LoopProgram(Boxx::Long count);
+
+			/// Creates a program that calculates the fibonacci number {n} recursively.
+			static Ptr<KiwiProgram> FibProgram(Boxx::Long n);
+		};
+	}
+}
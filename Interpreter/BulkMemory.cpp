@@ -0,0 +1,350 @@
+#include "BulkMemory.h"
+
+#include <cstring>
+
+#ifdef KIWI_SIMD
+	#include <immintrin.h>
+
+	#ifdef _MSC_VER
+		#include <intrin.h>
+		#define KIWI_TARGET(name)
+	#else
+		#define KIWI_TARGET(name) __attribute__((target(name)))
+	#endif
+#endif
+
+using namespace Boxx;
+
+using namespace Kiwi;
+using namespace Kiwi::Interpreter;
+
+static void FillPortable(UByte* dst, UByte value, UInt size) {
+	std::memset(dst, value, size);
+}
+
+static void MovePortable(UByte* dst, const UByte* src, UInt size) {
+	std::memmove(dst, src, size);
+}
+
+static Int ComparePortable(const UByte* a, const UByte* b, UInt size) {
+	Int result = std::memcmp(a, b, size);
+	return result < 0 ? -1 : result > 0 ? 1 : 0;
+}
+
+SimdLevel BulkMemory::level = SimdLevel::None;
+BulkMemory::FillKernel BulkMemory::fill = FillPortable;
+BulkMemory::MoveKernel BulkMemory::move = MovePortable;
+BulkMemory::CompareKernel BulkMemory::compare = ComparePortable;
+
+void BulkMemory::FillSmall(UByte* dst, UByte value, UInt size) {
+	std::memset(dst, value, size);
+}
+
+void BulkMemory::CopySmall(UByte* dst, const UByte* src, UInt size) {
+	std::memcpy(dst, src, size);
+}
+
+void BulkMemory::MoveSmall(UByte* dst, const UByte* src, UInt size) {
+	std::memmove(dst, src, size);
+}
+
+Int BulkMemory::CompareSmall(const UByte* a, const UByte* b, UInt size) {
+	return ComparePortable(a, b, size);
+}
+
+#ifdef KIWI_SIMD
+
+// The vector kernels are only used for sizes of at least four vectors.
+// The first and last vectors are handled by unaligned accesses.
+// The loops in between store to aligned addresses.
+
+// Gets the amount of bytes from the pointer to the next aligned address
+static UInt AlignOffset(const UByte* ptr, UInt alignment) {
+	return alignment - (UInt)((ULong)ptr & (alignment - 1));
+}
+
+// Gets the amount of bytes from the previous aligned address to the pointer
+static UInt AlignRemainder(const UByte* ptr, UInt alignment) {
+	return (UInt)((ULong)ptr & (alignment - 1));
+}
+
+// Compares the bytes at the first set bit of the mask
+static Int CompareAt(const UByte* a, const UByte* b, UInt mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+#else
+	UInt index = __builtin_ctz(mask);
+#endif
+
+	return a[index] < b[index] ? -1 : 1;
+}
+
+KIWI_TARGET("sse2")
+static void FillSSE2(UByte* dst, UByte value, UInt size) {
+	__m128i v = _mm_set1_epi8((char)value);
+	UInt i = AlignOffset(dst, 16);
+
+	_mm_storeu_si128((__m128i*)dst, v);
+
+	for (; i + 64 <= size; i += 64) {
+		_mm_store_si128((__m128i*)(dst + i),      v);
+		_mm_store_si128((__m128i*)(dst + i + 16), v);
+		_mm_store_si128((__m128i*)(dst + i + 32), v);
+		_mm_store_si128((__m128i*)(dst + i + 48), v);
+	}
+
+	for (; i + 16 <= size; i += 16) {
+		_mm_store_si128((__m128i*)(dst + i), v);
+	}
+
+	_mm_storeu_si128((__m128i*)(dst + size - 16), v);
+}
+
+KIWI_TARGET("sse2")
+static void MoveSSE2(UByte* dst, const UByte* src, UInt size) {
+	if (dst == src) return;
+
+	__m128i first = _mm_loadu_si128((const __m128i*)src);
+	__m128i last  = _mm_loadu_si128((const __m128i*)(src + size - 16));
+
+	// Copies forwards unless the destination starts inside the source
+	if (dst < src || dst >= src + size) {
+		UInt i = AlignOffset(dst, 16);
+
+		for (; i + 64 <= size; i += 64) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(src + i));
+			__m128i b = _mm_loadu_si128((const __m128i*)(src + i + 16));
+			__m128i c = _mm_loadu_si128((const __m128i*)(src + i + 32));
+			__m128i d = _mm_loadu_si128((const __m128i*)(src + i + 48));
+			_mm_store_si128((__m128i*)(dst + i),      a);
+			_mm_store_si128((__m128i*)(dst + i + 16), b);
+			_mm_store_si128((__m128i*)(dst + i + 32), c);
+			_mm_store_si128((__m128i*)(dst + i + 48), d);
+		}
+
+		for (; i + 16 <= size; i += 16) {
+			_mm_store_si128((__m128i*)(dst + i), _mm_loadu_si128((const __m128i*)(src + i)));
+		}
+	}
+	else {
+		UInt i = size - AlignRemainder(dst + size, 16);
+
+		for (; i >= 64; i -= 64) {
+			__m128i a = _mm_loadu_si128((const __m128i*)(src + i - 16));
+			__m128i b = _mm_loadu_si128((const __m128i*)(src + i - 32));
+			__m128i c = _mm_loadu_si128((const __m128i*)(src + i - 48));
+			__m128i d = _mm_loadu_si128((const __m128i*)(src + i - 64));
+			_mm_store_si128((__m128i*)(dst + i - 16), a);
+			_mm_store_si128((__m128i*)(dst + i - 32), b);
+			_mm_store_si128((__m128i*)(dst + i - 48), c);
+			_mm_store_si128((__m128i*)(dst + i - 64), d);
+		}
+
+		for (; i >= 16; i -= 16) {
+			_mm_store_si128((__m128i*)(dst + i - 16), _mm_loadu_si128((const __m128i*)(src + i - 16)));
+		}
+	}
+
+	_mm_storeu_si128((__m128i*)dst, first);
+	_mm_storeu_si128((__m128i*)(dst + size - 16), last);
+}
+
+KIWI_TARGET("sse2")
+static Int CompareSSE2(const UByte* a, const UByte* b, UInt size) {
+	UInt i = 0;
+
+	for (; i + 64 <= size; i += 64) {
+		__m128i e0 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i)),      _mm_loadu_si128((const __m128i*)(b + i)));
+		__m128i e1 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i + 16)), _mm_loadu_si128((const __m128i*)(b + i + 16)));
+		__m128i e2 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i + 32)), _mm_loadu_si128((const __m128i*)(b + i + 32)));
+		__m128i e3 = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(a + i + 48)), _mm_loadu_si128((const __m128i*)(b + i + 48)));
+
+		if (_mm_movemask_epi8(_mm_and_si128(_mm_and_si128(e0, e1), _mm_and_si128(e2, e3))) != 0xFFFF) break;
+	}
+
+	for (;; i += 16) {
+		if (i + 16 > size) {
+			i = size - 16;
+		}
+
+		__m128i x = _mm_loadu_si128((const __m128i*)(a + i));
+		__m128i y = _mm_loadu_si128((const __m128i*)(b + i));
+		UInt mask = (UInt)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) ^ 0xFFFF;
+
+		if (mask != 0) {
+			return CompareAt(a + i, b + i, mask);
+		}
+
+		if (i + 16 >= size) return 0;
+	}
+}
+
+KIWI_TARGET("avx2")
+static void FillAVX2(UByte* dst, UByte value, UInt size) {
+	__m256i v = _mm256_set1_epi8((char)value);
+	UInt i = AlignOffset(dst, 32);
+
+	_mm256_storeu_si256((__m256i*)dst, v);
+
+	for (; i + 128 <= size; i += 128) {
+		_mm256_store_si256((__m256i*)(dst + i),      v);
+		_mm256_store_si256((__m256i*)(dst + i + 32), v);
+		_mm256_store_si256((__m256i*)(dst + i + 64), v);
+		_mm256_store_si256((__m256i*)(dst + i + 96), v);
+	}
+
+	for (; i + 32 <= size; i += 32) {
+		_mm256_store_si256((__m256i*)(dst + i), v);
+	}
+
+	_mm256_storeu_si256((__m256i*)(dst + size - 32), v);
+}
+
+KIWI_TARGET("avx2")
+static void MoveAVX2(UByte* dst, const UByte* src, UInt size) {
+	if (dst == src) return;
+
+	__m256i first = _mm256_loadu_si256((const __m256i*)src);
+	__m256i last  = _mm256_loadu_si256((const __m256i*)(src + size - 32));
+
+	if (dst < src || dst >= src + size) {
+		UInt i = AlignOffset(dst, 32);
+
+		for (; i + 128 <= size; i += 128) {
+			__m256i a = _mm256_loadu_si256((const __m256i*)(src + i));
+			__m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 32));
+			__m256i c = _mm256_loadu_si256((const __m256i*)(src + i + 64));
+			__m256i d = _mm256_loadu_si256((const __m256i*)(src + i + 96));
+			_mm256_store_si256((__m256i*)(dst + i),      a);
+			_mm256_store_si256((__m256i*)(dst + i + 32), b);
+			_mm256_store_si256((__m256i*)(dst + i + 64), c);
+			_mm256_store_si256((__m256i*)(dst + i + 96), d);
+		}
+
+		for (; i + 32 <= size; i += 32) {
+			_mm256_store_si256((__m256i*)(dst + i), _mm256_loadu_si256((const __m256i*)(src + i)));
+		}
+	}
+	else {
+		UInt i = size - AlignRemainder(dst + size, 32);
+
+		for (; i >= 128; i -= 128) {
+			__m256i a = _mm256_loadu_si256((const __m256i*)(src + i - 32));
+			__m256i b = _mm256_loadu_si256((const __m256i*)(src + i - 64));
+			__m256i c = _mm256_loadu_si256((const __m256i*)(src + i - 96));
+			__m256i d = _mm256_loadu_si256((const __m256i*)(src + i - 128));
+			_mm256_store_si256((__m256i*)(dst + i - 32),  a);
+			_mm256_store_si256((__m256i*)(dst + i - 64),  b);
+			_mm256_store_si256((__m256i*)(dst + i - 96),  c);
+			_mm256_store_si256((__m256i*)(dst + i - 128), d);
+		}
+
+		for (; i >= 32; i -= 32) {
+			_mm256_store_si256((__m256i*)(dst + i - 32), _mm256_loadu_si256((const __m256i*)(src + i - 32)));
+		}
+	}
+
+	_mm256_storeu_si256((__m256i*)dst, first);
+	_mm256_storeu_si256((__m256i*)(dst + size - 32), last);
+}
+
+KIWI_TARGET("avx2")
+static Int CompareAVX2(const UByte* a, const UByte* b, UInt size) {
+	UInt i = 0;
+
+	for (; i + 128 <= size; i += 128) {
+		__m256i e0 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i)),      _mm256_loadu_si256((const __m256i*)(b + i)));
+		__m256i e1 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i + 32)), _mm256_loadu_si256((const __m256i*)(b + i + 32)));
+		__m256i e2 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i + 64)), _mm256_loadu_si256((const __m256i*)(b + i + 64)));
+		__m256i e3 = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(a + i + 96)), _mm256_loadu_si256((const __m256i*)(b + i + 96)));
+
+		if (_mm256_movemask_epi8(_mm256_and_si256(_mm256_and_si256(e0, e1), _mm256_and_si256(e2, e3))) != -1) break;
+	}
+
+	for (;; i += 32) {
+		if (i + 32 > size) {
+			i = size - 32;
+		}
+
+		__m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+		__m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+		UInt mask = ~(UInt)_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y));
+
+		if (mask != 0) {
+			return CompareAt(a + i, b + i, mask);
+		}
+
+		if (i + 32 >= size) return 0;
+	}
+}
+
+#endif
+
+SimdLevel BulkMemory::Supported() {
+#ifdef KIWI_SIMD
+	#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+
+		if (info[0] >= 7) {
+			__cpuid(info, 1);
+			bool osxsave = (info[2] & (1 << 27)) != 0;
+
+			__cpuidex(info, 7, 0);
+
+			// The OS has to save the AVX registers
+			if (osxsave && (info[1] & (1 << 5)) != 0 && (_xgetbv(0) & 6) == 6) {
+				return SimdLevel::AVX2;
+			}
+		}
+
+		return SimdLevel::SSE2;
+	#else
+		__builtin_cpu_init();
+
+		if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+		if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+	#endif
+#endif
+
+	return SimdLevel::None;
+}
+
+void BulkMemory::SetLevel(SimdLevel level) {
+	SimdLevel supported = Supported();
+
+	if (level > supported) {
+		level = supported;
+	}
+
+	BulkMemory::level = level;
+
+	switch (level) {
+	#ifdef KIWI_SIMD
+		case SimdLevel::AVX2: {
+			fill    = FillAVX2;
+			move    = MoveAVX2;
+			compare = CompareAVX2;
+			break;
+		}
+
+		case SimdLevel::SSE2: {
+			fill    = FillSSE2;
+			move    = MoveSSE2;
+			compare = CompareSSE2;
+			break;
+		}
+	#endif
+
+		default: {
+			fill    = FillPortable;
+			move    = MovePortable;
+			compare = ComparePortable;
+			break;
+		}
+	}
+}
+
+// Selects the kernels before main runs
+static const bool selected = (BulkMemory::SetLevel(BulkMemory::Supported()), true);
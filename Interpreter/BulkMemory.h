@@ -0,0 +1,108 @@
+#pragma once
+
+#include "../Boxx/Boxx/Types.h"
+
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)) && !defined(KIWI_NO_SIMD)
+	/// Defined if the bulk memory kernels can use SSE2 and AVX2.
+	///
+	/// Define {KIWI_NO_SIMD} to only use the portable kernels.
+	#define KIWI_SIMD
+#endif
+
+///N Kiwi::Interpreter
+
+namespace Kiwi {
+	namespace Interpreter {
+		/// The instruction sets used by the bulk memory kernels.
+		enum class SimdLevel : Boxx::UByte {
+			///T Levels
+			///M
+			None,
+			SSE2,
+			AVX2
+			///M
+		};
+
+		/// Fills, copies, moves and compares memory.
+		///
+		/// The kernels for the best instruction set supported by the processor are selected at startup.
+		/// Sizes below {minSimdSize} always use the C library functions.
+		class BulkMemory {
+		public:
+			/// The smallest byte size that uses the vector kernels.
+			static constexpr Boxx::UInt minSimdSize = 64;
+
+			/// Gets the instruction set used by the kernels.
+			static SimdLevel Level() {
+				return level;
+			}
+
+			/// Gets the best instruction set supported by the processor.
+			static SimdLevel Supported();
+
+			/// Sets the instruction set used by the kernels.
+			///
+			/// Levels above {Supported} are lowered to it.
+			static void SetLevel(SimdLevel level);
+
+			/// Sets {size} bytes at {dst} to {value}.
+			static void Fill(Boxx::UByte* dst, Boxx::UByte value, Boxx::UInt size) {
+				if (size < minSimdSize) {
+					FillSmall(dst, value, size);
+				}
+				else {
+					fill(dst, value, size);
+				}
+			}
+
+			/// Copies {size} bytes from {src} to {dst}.
+			///
+			/// The memory must not overlap.
+			static void Copy(Boxx::UByte* dst, const Boxx::UByte* src, Boxx::UInt size) {
+				if (size < minSimdSize) {
+					CopySmall(dst, src, size);
+				}
+				else {
+					move(dst, src, size);
+				}
+			}
+
+			/// Copies {size} bytes from {src} to {dst}.
+			///
+			/// The memory may overlap.
+			static void Move(Boxx::UByte* dst, const Boxx::UByte* src, Boxx::UInt size) {
+				if (size < minSimdSize) {
+					MoveSmall(dst, src, size);
+				}
+				else {
+					move(dst, src, size);
+				}
+			}
+
+			/// Compares {size} bytes at {a} and {b} as unsigned bytes.
+			///R result: {-1} if {a} is less than {b}, {1} if it is greater and {0} if they are equal.
+			static Boxx::Int Compare(const Boxx::UByte* a, const Boxx::UByte* b, Boxx::UInt size) {
+				if (size < minSimdSize) {
+					return CompareSmall(a, b, size);
+				}
+
+				return compare(a, b, size);
+			}
+
+		private:
+			using FillKernel    = void (*)(Boxx::UByte*, Boxx::UByte, Boxx::UInt);
+			using MoveKernel    = void (*)(Boxx::UByte*, const Boxx::UByte*, Boxx::UInt);
+			using CompareKernel = Boxx::Int (*)(const Boxx::UByte*, const Boxx::UByte*, Boxx::UInt);
+
+			static SimdLevel level;
+			static FillKernel fill;
+			static MoveKernel move;
+			static CompareKernel compare;
+
+			static void FillSmall(Boxx::UByte* dst, Boxx::UByte value, Boxx::UInt size);
+			static void CopySmall(Boxx::UByte* dst, const Boxx::UByte* src, Boxx::UInt size);
+			static void MoveSmall(Boxx::UByte* dst, const Boxx::UByte* src, Boxx::UInt size);
+			static Boxx::Int CompareSmall(const Boxx::UByte* a, const Boxx::UByte* b, Boxx::UInt size);
+		};
+	}
+}
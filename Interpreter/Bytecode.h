@@ -0,0 +1,253 @@
+#pragma once
+
+#include "../Ptr.h"
+#include "../Structs.h"
+
+#include "Profiler.h"
+
+#include "../Boxx/Boxx/String.h"
+#include "../Boxx/Boxx/List.h"
+#include "../Boxx/Boxx/Array.h"
+
+///N Kiwi::Interpreter
+
+namespace Kiwi {
+	namespace Interpreter {
+		/// A register.
+		///
+		/// Registers are byte offsets into the current stack frame.
+		using Reg = Boxx::UInt;
+
+		/// Integer operations.
+		enum class IntOp : Boxx::UByte {
+			///T Values
+			///M
+			Neg, Not,
+			Add, Sub, Mul, Div, Mod,
+			Or, And, Xor, Shl, Shr,
+			Eq, Ne, Lt, Gt, Le, Ge
+			///M
+		};
+
+		/// Bytecode operation codes.
+		///
+		/// Unless stated otherwise {a} is the destination register.
+		enum class OpCode : Boxx::UByte {
+			///T Values
+			///M
+			/// Does nothing.
+			Nop,
+
+			/// Copies {size} bytes from register {b} to {a}.
+			Mov,
+
+			/// Clears {size} bytes of register {a}.
+			Clear,
+
+			/// Stores the integer {imm} with a width of {size} bytes.
+			Const,
+
+			/// Stores the address of register {b} plus {imm}.
+			Lea,
+
+			/// Stores the address of the static data with index {b}.
+			Static,
+
+			/// Stores the pointer in register {b} plus {imm}.
+			PtrAdd,
+
+			/// Stores the pointer in register {b} plus the {size} byte integer in register {c} scaled by {imm}.
+			Index,
+
+			/// Loads {size} bytes from the pointer in register {b} plus {imm}.
+			Load,
+
+			/// Stores {size} bytes from register {b} at the pointer in register {a} plus {imm}.
+			Store,
+
+			/// Converts the integer of type {c} in register {b} to a {size} byte integer.
+			Conv,
+
+			/// Jumps to op {a}.
+			Jmp,
+
+			/// Jumps to op {b} if the {size} byte integer in register {a} is not zero, otherwise to op {c}.
+			JmpIf,
+
+			/// Calls function {a} with the arguments and return registers in operand list {b}.
+			/// {c} is the argument count and {imm} is the return value count.
+			/// Each register in the operand list is followed by its size.
+			Call,
+
+			/// Same as {Call} but {a} is a register containing the function id.
+			CallPtr,
+
+			/// Returns from the current function.
+			Ret,
+
+			/// Allocates {imm} bytes on the heap.
+			/// {c} is the allocation site.
+			Alloc,
+
+			/// Allocates the amount of bytes specified by the {size} byte integer in register {b}.
+			/// {c} is the allocation site.
+			AllocVar,
+
+			/// Frees the pointer in register {a}.
+			Free,
+
+			/// Allocates {imm} bytes on the call stack and stores the address in register {a}.
+			///
+			/// The memory is released when the current function returns.
+			StackAlloc,
+
+			/// Allocates the amount of bytes specified by the {size} byte integer in register {b} on the call stack.
+			StackAllocVar,
+
+			/// Creates a region and stores its address in register {a}.
+			Region,
+
+			/// Allocates {imm} bytes in the region in register {b}.
+			RegionAlloc,
+
+			/// Allocates the amount of bytes specified by the {size} byte integer in register {c} in the region in register {b}.
+			RegionAllocVar,
+
+			/// Destroys the region in register {a}.
+			Destroy,
+
+			/// Copies the amount of bytes in the {size} byte integer in register {c} from the pointer in register {b} to the pointer in register {a}.
+			Copy,
+
+			/// Sets the amount of bytes in the {size} byte integer in register {c} at the pointer in register {a} to the low byte of register {b}.
+			Fill,
+
+			/// Same as {Copy} but the memory may overlap.
+			Move,
+
+			/// Compares the amount of bytes in the {size} byte integer in register {imm} at the pointers in registers {b} and {c}.
+			/// Stores {-1}, {0} or {1} as an {i32} in register {a}.
+			Compare,
+
+			/// Stores the address of the string literal with index {b}.
+			Str,
+
+			/// Prints {size} bytes of register {a} using the print mode {b}.
+			/// If {c} is not zero the value is a pointer.
+			Print,
+
+			/// The first integer operation.
+			///
+			/// There is one op code for each integer operation and integer type.
+			/// Use {IntOpCode} to get the op code.
+			/// Unary operations use the integer in register {b}.
+			/// Binary operations use the integers in registers {b} and {c}.
+			IntOps
+			///M
+		};
+
+		/// Gets the op code for an integer operation on the integer type with the specified id.
+		constexpr OpCode IntOpCode(IntOp op, Boxx::UInt type) {
+			return (OpCode)((Boxx::UInt)OpCode::IntOps + (Boxx::UInt)op * TypeId::builtinCount + type);
+		}
+
+		/// Print modes for {OpCode::Print}.
+		enum class PrintMode : Boxx::UByte {
+			///T Values
+			///M
+			Bytes,
+			Str,
+			Chr
+			///M
+		};
+
+		/// A bytecode operation.
+		struct Op {
+			/// The operation code.
+			OpCode code = OpCode::Nop;
+
+			/// The operand width in bytes.
+			Boxx::UInt size = 0;
+
+			/// The operands.
+			Boxx::UInt a = 0, b = 0, c = 0;
+
+			/// The immediate value.
+			Boxx::Long imm = 0;
+
+			Op() {}
+
+			Op(OpCode code, Boxx::UInt size, Boxx::UInt a, Boxx::UInt b = 0, Boxx::UInt c = 0, Boxx::Long imm = 0) {
+				this->code = code;
+				this->size = size;
+				this->a    = a;
+				this->b    = b;
+				this->c    = c;
+				this->imm  = imm;
+			}
+		};
+
+		/// A slot in a stack frame.
+		struct Slot {
+			/// The byte offset from the start of the frame.
+			Boxx::UInt offset = 0;
+
+			/// The byte size of the slot.
+			Boxx::UInt size = 0;
+		};
+
+		/// A function lowered to bytecode.
+		struct CompiledFunction {
+			/// The function name.
+			Boxx::String name;
+
+			/// The operations.
+			Boxx::Array<Op> ops;
+
+			/// The handler address of each operation used by threaded dispatch.
+			///
+			/// Filled by the VM before the first threaded run.
+			Boxx::Array<const void*> handlers;
+
+			/// Operand lists used by calls.
+			Boxx::Array<Boxx::UInt> operands;
+
+			/// The slots of the arguments followed by the slots of the return values.
+			Boxx::Array<Slot> parameters;
+
+			/// The number of arguments.
+			Boxx::UInt arguments = 0;
+
+			/// The number of return values.
+			Boxx::UInt returnValues = 0;
+
+			/// The byte size of a stack frame.
+			Boxx::UInt frameSize = 0;
+
+			CompiledFunction(const Boxx::String& name) {
+				this->name = name;
+			}
+		};
+
+		/// A kiwi program lowered to bytecode.
+		struct CompiledProgram {
+			/// All functions indexed by function id.
+			Boxx::List<Ptr<CompiledFunction>> functions;
+
+			/// All code blocks.
+			Boxx::List<Ptr<CompiledFunction>> blocks;
+
+			/// The names of all static data indexed by static index.
+			Boxx::List<Boxx::String> staticData;
+
+			/// All string literals.
+			Boxx::List<Boxx::String> strings;
+
+			/// All allocation sites.
+			Boxx::List<AllocationSite> sites;
+
+			/// The byte size of pointers.
+			Boxx::UInt ptrSize = 8;
+		};
+	}
+}
@@ -0,0 +1,377 @@
+#include "Compiler.h"
+
+#include "../KiwiProgram.h"
+
+using namespace Boxx;
+
+using namespace Kiwi;
+using namespace Kiwi::Interpreter;
+
+Compiler::Compiler(Weak<KiwiProgram> program) {
+	this->program = program;
+	typeData.program = program;
+}
+
+Ptr<CompiledProgram> Compiler::Compile() {
+	Ptr<CompiledProgram> result = new CompiledProgram();
+	result->ptrSize = program->PointerSize();
+	compiled = result;
+
+	for (const Pair<String, Ptr<StaticData>>& sd : program->staticData) {
+		staticIds.Add(sd.key, compiled->staticData.Count());
+		compiled->staticData.Add(sd.key);
+	}
+
+	for (const Pair<String, Ptr<Function>>& f : program->functions) {
+		functionIds.Add(f.key, compiled->functions.Count());
+		compiled->functions.Add(new CompiledFunction(f.key));
+	}
+
+	used    = Array<bool>(compiled->functions.Count());
+	pending = List<UInt>();
+
+	for (UInt i = 0; i < used.Length(); i++) {
+		used[i] = false;
+	}
+
+	// Function pointers in static data
+	for (const Pair<String, Ptr<StaticData>>& sd : program->staticData) {
+		for (const Tuple<Type, String, Ptr<Kiwi::Value>>& value : sd.value->data) {
+			if (Weak<Kiwi::Variable> var = dyn_cast<Kiwi::Variable>(value.value3)) {
+				GetFunction(var->name);
+			}
+		}
+	}
+
+	for (Weak<CodeBlock> block : program->blocks) {
+		Ptr<CompiledFunction> compiledBlock = new CompiledFunction("");
+		CompileBlock(block, compiledBlock);
+		compiled->blocks.Add(compiledBlock);
+	}
+
+	// Compiling a function can add more functions
+	for (UInt i = 0; i < pending.Count(); i++) {
+		Weak<CompiledFunction> function = compiled->functions[pending[i]];
+		CompileFunction(program->functions[function->name], function);
+	}
+
+	return result;
+}
+
+void Compiler::BeginFunction() {
+	ops       = List<Op>();
+	operands  = List<UInt>();
+	slots     = List<Slot>();
+	registers = Map<Reg, UInt>();
+	variables = Map<String, UInt>();
+	labels    = List<UInt>();
+	jumps     = List<Tuple<UInt, UInt, UInt>>();
+
+	frameSize   = 0;
+	top         = 0;
+	variableTop = 0;
+
+	function         = String();
+	instructionIndex = 0;
+	instruction      = Weak<Instruction>();
+
+	typeData.PushFrame();
+}
+
+void Compiler::EndFunction(Weak<CompiledFunction> function) {
+	Emit(OpCode::Ret, 0, 0);
+
+	for (const Tuple<UInt, UInt, UInt>& jump : jumps) {
+		UInt target = labels[jump.value3];
+
+		switch (jump.value2) {
+			case 0:  ops[jump.value1].a = target; break;
+			case 1:  ops[jump.value1].b = target; break;
+			default: ops[jump.value1].c = target; break;
+		}
+	}
+
+	function->ops = Array<Op>(ops.Count());
+
+	for (UInt i = 0; i < ops.Count(); i++) {
+		function->ops[i] = ops[i];
+	}
+
+	function->operands = Array<UInt>(operands.Count());
+
+	for (UInt i = 0; i < operands.Count(); i++) {
+		function->operands[i] = operands[i];
+	}
+
+	function->frameSize = frameSize;
+
+	typeData.PopFrame();
+}
+
+void Compiler::CompileFunction(Weak<Function> function, Weak<CompiledFunction> compiledFunction) {
+	program->LoadFunction(function);
+
+	BeginFunction();
+	this->function = compiledFunction->name;
+
+	for (const Tuple<Type, String>& arg : function->arguments) {
+		DeclareVariable(arg.value2, arg.value1);
+	}
+
+	for (const Tuple<Type, String>& value : function->returnValues) {
+		DeclareVariable(value.value2, value.value1);
+	}
+
+	compiledFunction->arguments    = function->arguments.Count();
+	compiledFunction->returnValues = function->returnValues.Count();
+	compiledFunction->parameters   = Array<Slot>(slots.Count());
+
+	for (UInt i = 0; i < slots.Count(); i++) {
+		compiledFunction->parameters[i] = slots[i];
+	}
+
+	function->block->Compile(*this);
+
+	EndFunction(compiledFunction);
+}
+
+void Compiler::CompileBlock(Weak<CodeBlock> block, Weak<CompiledFunction> compiledFunction) {
+	BeginFunction();
+	block->Compile(*this);
+	EndFunction(compiledFunction);
+}
+
+Reg Compiler::AddRegister(UInt size) {
+	UInt align = size >= 8 ? 8 : size >= 4 ? 4 : size >= 2 ? 2 : 1;
+
+	Reg reg = (top + align - 1) / align * align;
+	top = reg + size;
+
+	if (top > frameSize) {
+		frameSize = top;
+	}
+
+	registers.Set(reg, size);
+	return reg;
+}
+
+UInt Compiler::RegisterSize(Reg reg) const {
+	return registers[reg];
+}
+
+void Compiler::FreeRegisters() {
+	top = variableTop;
+}
+
+Reg Compiler::DeclareVariable(const String& name, const Type& type) {
+	typeData.frame->CreateVariable(name, type);
+
+	UInt slot;
+
+	if (variables.Contains(name, slot)) {
+		return slots[slot].offset;
+	}
+
+	Slot s;
+	s.size   = Type::SizeOf(type, program);
+	s.offset = AddRegister(s.size);
+
+	variables.Add(name, slots.Count());
+	slots.Add(s);
+
+	variableTop = top;
+	return s.offset;
+}
+
+Reg Compiler::GetVariable(const String& name) {
+	UInt slot;
+
+	if (!variables.Contains(name, slot)) {
+		throw KiwiInterpretError("Variable '" + name + "' does not exist");
+	}
+
+	return slots[slot].offset;
+}
+
+Optional<UInt> Compiler::GetStatic(const String& name) const {
+	UInt id;
+
+	if (staticIds.Contains(name, id)) {
+		return id;
+	}
+
+	return nullptr;
+}
+
+Optional<UInt> Compiler::GetFunction(const String& name) {
+	UInt id;
+
+	if (functionIds.Contains(name, id)) {
+		if (!used[id]) {
+			used[id] = true;
+			pending.Add(id);
+		}
+
+		return id;
+	}
+
+	return nullptr;
+}
+
+UInt Compiler::AddString(const String& str) {
+	UInt id;
+
+	if (stringIds.Contains(str, id)) {
+		return id;
+	}
+
+	id = compiled->strings.Count();
+	compiled->strings.Add(str);
+	stringIds.Add(str, id);
+	return id;
+}
+
+void Compiler::BeginInstruction(Weak<Instruction> instruction) {
+	if (this->instruction) {
+		instructionIndex++;
+	}
+
+	this->instruction = instruction;
+}
+
+UInt Compiler::AddSite() {
+	compiled->sites.Add(CreateSite(function, instructionIndex, instruction));
+	return compiled->sites.Count() - 1;
+}
+
+AllocationSite Compiler::CreateSite(const String& function, UInt index, Weak<Instruction> instruction) {
+	AllocationSite site;
+	site.function = function;
+	site.index    = index;
+
+	if (instruction) {
+		StringWriter builder;
+		instruction->BuildString(builder);
+
+		String text = builder.ToString();
+		StringBuilder line;
+
+		for (UInt i = 0; i < text.Length(); i++) {
+			if (text[i] != '\n') {
+				line += text[i];
+			}
+		}
+
+		site.instruction = line.ToString();
+	}
+
+	return site;
+}
+
+UInt Compiler::AddOperands(const List<UInt>& operands) {
+	UInt start = this->operands.Count();
+
+	for (UInt operand : operands) {
+		this->operands.Add(operand);
+	}
+
+	return start;
+}
+
+UInt Compiler::Emit(const Op& op) {
+	ops.Add(op);
+	return ops.Count() - 1;
+}
+
+UInt Compiler::Emit(OpCode code, UInt size, UInt a, UInt b, UInt c, Long imm) {
+	return Emit(Op(code, size, a, b, c, imm));
+}
+
+void Compiler::AddLabel(UInt block) {
+	while (labels.Count() <= block) {
+		labels.Add(ops.Count());
+	}
+
+	labels[block] = ops.Count();
+}
+
+void Compiler::EmitJump(UInt block) {
+	UInt index = Emit(OpCode::Jmp, 0, 0);
+	jumps.Add(Tuple<>::Create(index, (UInt)0, block));
+}
+
+void Compiler::EmitJumpIf(Reg cond, const Optional<UInt>& trueBlock, const Optional<UInt>& falseBlock) {
+	UInt index = Emit(OpCode::JmpIf, RegisterSize(cond), cond, ops.Count() + 1, ops.Count() + 1);
+
+	if (trueBlock) {
+		jumps.Add(Tuple<>::Create(index, (UInt)1, *trueBlock));
+	}
+
+	if (falseBlock) {
+		jumps.Add(Tuple<>::Create(index, (UInt)2, *falseBlock));
+	}
+}
+
+void Compiler::Assign(Reg dst, Reg src) {
+	if (dst == src) return;
+
+	UInt dstSize = RegisterSize(dst);
+	UInt srcSize = RegisterSize(src);
+
+	Emit(OpCode::Mov, Math::Min(dstSize, srcSize), dst, src);
+
+	if (dstSize > srcSize) {
+		Emit(OpCode::Clear, dstSize - srcSize, dst + srcSize);
+	}
+}
+
+Reg Compiler::Convert(Reg reg, UInt from, UInt to) {
+	UInt size = Type::Info(to).size;
+
+	if (size <= Type::Info(from).size) return reg;
+
+	Reg conv = AddRegister(size);
+	Emit(OpCode::Conv, size, conv, reg, from);
+	return conv;
+}
+
+Reg Compiler::Materialize(const MemRef& ref) {
+	if (!ref.frame && ref.offset == 0) return ref.ptr;
+
+	Reg reg = AddRegister(program->PointerSize());
+	Emit(ref.frame ? OpCode::Lea : OpCode::PtrAdd, program->PointerSize(), reg, ref.ptr, 0, ref.offset);
+	return reg;
+}
+
+Reg Compiler::Load(const MemRef& ref, UInt size) {
+	// Memory before a frame register is reached through a pointer
+	if (ref.frame && ref.offset < 0) {
+		Reg ptr = Materialize(ref);
+		Reg reg = AddRegister(size);
+		Emit(OpCode::Load, size, reg, ptr);
+		return reg;
+	}
+
+	Reg reg = AddRegister(size);
+
+	if (ref.frame) {
+		Emit(OpCode::Mov, size, reg, (UInt)(ref.ptr + ref.offset));
+	}
+	else {
+		Emit(OpCode::Load, size, reg, ref.ptr, 0, ref.offset);
+	}
+
+	return reg;
+}
+
+void Compiler::Store(const MemRef& ref, Reg value) {
+	if (ref.frame && ref.offset < 0) {
+		Emit(OpCode::Store, RegisterSize(value), Materialize(ref), value);
+	}
+	else if (ref.frame) {
+		Emit(OpCode::Mov, RegisterSize(value), (UInt)(ref.ptr + ref.offset), value);
+	}
+	else {
+		Emit(OpCode::Store, RegisterSize(value), ref.ptr, value, 0, ref.offset);
+	}
+}
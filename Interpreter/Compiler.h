@@ -0,0 +1,165 @@
+#pragma once
+
+#include "../Ptr.h"
+
+#include "../Boxx/Boxx/String.h"
+#include "../Boxx/Boxx/List.h"
+#include "../Boxx/Boxx/Array.h"
+#include "../Boxx/Boxx/Map.h"
+#include "../Boxx/Boxx/Tuple.h"
+
+#include "Interpreter.h"
+#include "Bytecode.h"
+
+///N Kiwi::Interpreter
+
+namespace Kiwi {
+	class Function;
+	class CodeBlock;
+	class Instruction;
+
+	namespace Interpreter {
+		/// A memory reference produced by the compiler.
+		struct MemRef {
+			/// {true} if the memory is the register {ptr} in the current frame.
+			/// {false} if {ptr} contains a pointer to the memory.
+			bool frame;
+
+			/// The register containing the base pointer.
+			Reg ptr;
+
+			/// The byte offset from the base pointer.
+			/// Constant offsets can be negative.
+			Boxx::Long offset;
+		};
+
+		/// Lowers a kiwi program to bytecode.
+		///
+		/// Only functions that are called or used as function pointers are compiled.
+		/// Other functions are never loaded and have no operations.
+		class Compiler {
+		public:
+			/// The program to compile.
+			Weak<KiwiProgram> program;
+
+			/// Interpreter data used for type lookups.
+			///
+			/// The current frame contains the types of all declared variables.
+			InterpreterData typeData;
+
+			Compiler(Weak<KiwiProgram> program);
+
+			/// Compiles the program.
+			Ptr<CompiledProgram> Compile();
+
+			/// Adds a temporary register.
+			Reg AddRegister(Boxx::UInt size);
+
+			/// Gets the byte size of a register.
+			Boxx::UInt RegisterSize(Reg reg) const;
+
+			/// Releases all temporary registers.
+			void FreeRegisters();
+
+			/// Declares a variable.
+			///
+			/// Each variable gets a fixed slot in the stack frame.
+			Reg DeclareVariable(const Boxx::String& name, const Type& type);
+
+			/// Gets the register for a variable.
+			Reg GetVariable(const Boxx::String& name);
+
+			/// Gets the index of the specified static data.
+			Boxx::Optional<Boxx::UInt> GetStatic(const Boxx::String& name) const;
+
+			/// Gets the id of the specified function.
+			///
+			/// The function is compiled if it has not been used before.
+			Boxx::Optional<Boxx::UInt> GetFunction(const Boxx::String& name);
+
+			/// Adds a string literal.
+			Boxx::UInt AddString(const Boxx::String& str);
+
+			/// Sets the instruction that is compiled.
+			void BeginInstruction(Weak<Instruction> instruction);
+
+			/// Adds an allocation site for the current instruction.
+			///R id: The id of the site.
+			Boxx::UInt AddSite();
+
+			/// Creates the allocation site of an instruction.
+			///
+			/// {index} is the index of the instruction in the function or code block.
+			static AllocationSite CreateSite(const Boxx::String& function, Boxx::UInt index, Weak<Instruction> instruction);
+
+			/// Adds an operand list.
+			///R start: The index of the first operand.
+			Boxx::UInt AddOperands(const Boxx::List<Boxx::UInt>& operands);
+
+			/// Emits an operation.
+			///R index: The index of the operation.
+			Boxx::UInt Emit(const Op& op);
+
+			/// Emits an operation.
+			///R index: The index of the operation.
+			Boxx::UInt Emit(OpCode code, Boxx::UInt size, Boxx::UInt a, Boxx::UInt b = 0, Boxx::UInt c = 0, Boxx::Long imm = 0);
+
+			/// Places the start of the instruction block with the specified index at the next operation.
+			void AddLabel(Boxx::UInt block);
+
+			/// Emits a jump to the instruction block with the specified index.
+			void EmitJump(Boxx::UInt block);
+
+			/// Emits a conditional jump to instruction blocks.
+			///
+			/// Jumps without a target continue with the next operation.
+			void EmitJumpIf(Reg cond, const Boxx::Optional<Boxx::UInt>& trueBlock, const Boxx::Optional<Boxx::UInt>& falseBlock);
+
+			/// Copies register {src} to register {dst} and zero extends or truncates the value.
+			void Assign(Reg dst, Reg src);
+
+			/// Converts the integer in a register between the integer types with the specified ids.
+			///
+			/// Only conversions to a larger type emit an operation.
+			Reg Convert(Reg reg, Boxx::UInt from, Boxx::UInt to);
+
+			/// Stores the pointer of a memory reference in a register.
+			Reg Materialize(const MemRef& ref);
+
+			/// Loads {size} bytes from a memory reference.
+			Reg Load(const MemRef& ref, Boxx::UInt size);
+
+			/// Stores a register at a memory reference.
+			void Store(const MemRef& ref, Reg value);
+
+		private:
+			Weak<CompiledProgram> compiled;
+
+			Boxx::List<Op> ops;
+			Boxx::List<Boxx::UInt> operands;
+
+			Boxx::List<Slot> slots;
+			Boxx::Map<Reg, Boxx::UInt> registers;
+			Boxx::UInt frameSize, top, variableTop;
+
+			Boxx::Map<Boxx::String, Boxx::UInt> variables;
+			Boxx::List<Boxx::UInt> labels;
+			Boxx::List<Boxx::Tuple<Boxx::UInt, Boxx::UInt, Boxx::UInt>> jumps;
+
+			Boxx::String function;
+			Boxx::UInt instructionIndex;
+			Weak<Instruction> instruction;
+
+			Boxx::Map<Boxx::String, Boxx::UInt> staticIds;
+			Boxx::Map<Boxx::String, Boxx::UInt> functionIds;
+			Boxx::Array<bool> used;
+			Boxx::List<Boxx::UInt> pending;
+			Boxx::Map<Boxx::String, Boxx::UInt> stringIds;
+
+			void BeginFunction();
+			void EndFunction(Weak<CompiledFunction> function);
+			void CompileFunction(Weak<Function> function, Weak<CompiledFunction> compiledFunction);
+			void CompileBlock(Weak<CodeBlock> block, Weak<CompiledFunction> compiledFunction);
+		};
+	}
+}
@@ -50,3 +50,591 @@ Boxx::String StructValue::ToString(Boxx::UInt indent) const {
 Boxx::String PtrValue::ToString(Boxx::UInt indent) const {
 	return '*' + value->ToString(indent);
 }
+
+namespace {
+	/// The size class of each allocation size rounded up to 16 bytes.
+	struct SizeClasses {
+		Boxx::UByte classes[Heap::maxSmallSize / 16 + 1] = {};
+
+		constexpr SizeClasses() {
+			Boxx::UInt sizeClass = 0;
+
+			for (Boxx::UInt i = 0; i <= Heap::maxSmallSize / 16; i++) {
+				while (Heap::classSizes[sizeClass] < i * 16) {
+					sizeClass++;
+				}
+
+				classes[i] = (Boxx::UByte)sizeClass;
+			}
+		}
+	};
+
+	constexpr SizeClasses sizeClasses;
+}
+
+thread_local Heap::ThreadCache Heap::cache;
+
+std::mutex Heap::registryMutex;
+Boxx::Map<Boxx::ULong, Heap*> Heap::heaps;
+Boxx::ULong Heap::nextId = 1;
+
+Heap::Heap() {
+	std::lock_guard<std::mutex> lock(registryMutex);
+	id = nextId++;
+	heaps.Add(id, this);
+}
+
+Heap::Heap(DataPtr region, Boxx::UInt size) : Heap() {
+	this->region = region;
+	regionSize   = size / pageSize * pageSize;
+}
+
+Heap::~Heap() {
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		heaps.Remove(id);
+	}
+
+	if (cache.heap == id) {
+		cache = ThreadCache();
+	}
+
+	for (const Boxx::Pair<DataPtr, Region*>& state : regions) {
+		delete state.value;
+	}
+
+	if (!table) return;
+
+	for (Boxx::UInt i = 0; i < tableSize; i++) {
+		if (!table[i]) continue;
+
+		for (Boxx::UInt u = 0; u < tableSize; u++) {
+			Page* page = table[i]->pages[u];
+
+			// Pages of large allocations are deleted from their first table entry
+			if (!page || (Boxx::ULong)page->start / pageSize != ((Boxx::ULong)i << tableBits | u)) continue;
+
+			if (!region) {
+				Memory::Unmap(page->start, page->blockSize == 0 ? page->size : pageSize);
+			}
+
+			delete[] page->sizes;
+
+			delete page;
+		}
+
+		Memory::Unmap((DataPtr)table[i], sizeof(PageTable));
+	}
+
+	Memory::Unmap((DataPtr)table, sizeof(PageTable*) * tableSize);
+}
+
+DataPtr Heap::Alloc(Boxx::UInt size) {
+	if (size == 0) size = 1;
+
+	if (size > maxSmallSize) {
+		return AllocLarge(size);
+	}
+
+	Boxx::UInt sizeClass = sizeClasses.classes[(size + 15) / 16];
+
+	ThreadCache& local = Cache();
+	DataPtr block = local.lists[sizeClass];
+
+	if (!block) {
+		block = Refill(sizeClass);
+	}
+
+	local.lists[sizeClass] = Data::Get<DataPtr>(block);
+	std::memset(block, 0, classSizes[sizeClass]);
+
+	Page* page = Find(block);
+	page->sizes[BlockIndex(page, block)] = (Boxx::UShort)size;
+	return block;
+}
+
+void Heap::Free(DataPtr ptr) {
+	if (!IsAllocated(ptr)) {
+		throw KiwiInterpretError("Attempt to free memory that is not allocated");
+	}
+
+	// Regions own their chunks so they are only released by destroy
+	if (IsRegion(ptr)) {
+		throw KiwiInterpretError("Attempt to free a region");
+	}
+
+	Page* page = Find(ptr);
+
+	if (page->blockSize == 0) {
+		FreeLarge(page);
+		return;
+	}
+
+	page->sizes[BlockIndex(page, ptr)] = 0;
+
+	ThreadCache& local = Cache();
+	Data::Set<DataPtr>(ptr, local.lists[page->sizeClass]);
+	local.lists[page->sizeClass] = ptr;
+}
+
+bool Heap::IsAllocated(DataPtr ptr) const {
+	Page* page = Find(ptr);
+
+	if (!page) return false;
+
+	if (page->blockSize == 0) {
+		return ptr == page->start;
+	}
+
+	if ((Boxx::UInt)(ptr - page->start) % page->blockSize != 0) return false;
+
+	return page->sizes[BlockIndex(page, ptr)] != 0;
+}
+
+Boxx::UInt Heap::GetSize(DataPtr ptr) const {
+	if (!IsAllocated(ptr)) return 0;
+
+	Page* page = Find(ptr);
+
+	if (page->blockSize == 0) {
+		return page->size;
+	}
+
+	return page->sizes[BlockIndex(page, ptr)];
+}
+
+DataPtr Heap::CreateRegion() {
+	// The handle is a heap block so it is a valid address that is unique while the region exists
+	DataPtr handle = Alloc(sizeof(Boxx::ULong));
+
+	std::lock_guard<std::mutex> lock(regionMutex);
+	regions.Add(handle, new Region());
+	return handle;
+}
+
+DataPtr Heap::RegionAlloc(DataPtr ptr, Boxx::UInt size) {
+	Region* state = GetRegion(ptr);
+
+	// Sizes near the limit would wrap when rounded
+	if (size > maxSize - 7) {
+		throw KiwiInterpretError("out of memory");
+	}
+
+	if (size == 0) size = 1;
+	size = (size + 7) / 8 * 8;
+
+	// Large blocks get a new cleared chunk of their own
+	if (size > maxRegionBlockSize) {
+		DataPtr chunk = AllocLarge(size);
+		state->chunks.Add(chunk);
+
+		if (profiler) {
+			profiler->Alloc(chunk, size, chunkSite);
+		}
+
+		return chunk;
+	}
+
+	if (size > (Boxx::UInt)(state->end - state->top)) {
+		DataPtr chunk = AllocChunk();
+		state->chunks.Add(chunk);
+
+		state->top = chunk;
+		state->end = chunk + regionChunkSize;
+
+		if (profiler) {
+			profiler->Alloc(chunk, regionChunkSize, chunkSite);
+		}
+	}
+
+	DataPtr block = state->top;
+	state->top += size;
+
+	std::memset(block, 0, size);
+	return block;
+}
+
+void Heap::DestroyRegion(DataPtr ptr) {
+	Region* state = GetRegion(ptr);
+
+	{
+		std::lock_guard<std::mutex> lock(regionMutex);
+		regions.Remove(ptr);
+	}
+
+	for (DataPtr chunk : state->chunks) {
+		if (profiler) {
+			profiler->Free(chunk);
+		}
+
+		FreeChunk(chunk);
+	}
+
+	delete state;
+	Free(ptr);
+}
+
+bool Heap::IsRegion(DataPtr ptr) const {
+	std::lock_guard<std::mutex> lock(regionMutex);
+	return regions.Contains(ptr);
+}
+
+void Heap::Profile(HeapProfiler* profiler) {
+	this->profiler = profiler;
+
+	if (profiler) {
+		AllocationSite site;
+		site.function    = "region";
+		site.instruction = "chunk";
+		chunkSite = profiler->AddSite(site);
+	}
+}
+
+Heap::Region* Heap::GetRegion(DataPtr ptr) const {
+	std::lock_guard<std::mutex> lock(regionMutex);
+	Region* state;
+
+	if (!regions.Contains(ptr, state)) {
+		throw KiwiInterpretError("invalid region");
+	}
+
+	return state;
+}
+
+DataPtr Heap::AllocChunk() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (!freeChunks.IsEmpty()) {
+			DataPtr chunk = freeChunks.Last();
+			freeChunks.RemoveLast();
+			return chunk;
+		}
+	}
+
+	return AllocLarge(regionChunkSize);
+}
+
+void Heap::FreeChunk(DataPtr chunk) {
+	Page* page = Find(chunk);
+
+	if (page->size == regionChunkSize) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		// Keep the chunk for the next region
+		if (freeChunks.Count() < maxFreeChunks) {
+			freeChunks.Add(chunk);
+			return;
+		}
+	}
+
+	FreeLarge(page);
+}
+
+Heap::ThreadCache& Heap::Cache() {
+	if (cache.heap == id) return cache;
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+
+	// Give the free lists of the previous heap back to it
+	Heap* previous;
+
+	if (cache.heap != 0 && heaps.Contains(cache.heap, previous)) {
+		previous->ReturnLists(cache.lists);
+	}
+
+	cache = ThreadCache();
+	cache.heap = id;
+	return cache;
+}
+
+void Heap::ReturnLists(DataPtr* lists) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (Boxx::UInt i = 0; i < classCount; i++) {
+		if (!lists[i]) continue;
+
+		DataPtr last = lists[i];
+
+		while (DataPtr next = Data::Get<DataPtr>(last)) {
+			last = next;
+		}
+
+		Data::Set<DataPtr>(last, freeLists[i]);
+		freeLists[i] = lists[i];
+	}
+}
+
+DataPtr Heap::Refill(Boxx::UInt sizeClass) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (DataPtr list = freeLists[sizeClass]) {
+		freeLists[sizeClass] = nullptr;
+		return list;
+	}
+
+	DataPtr start = MapPages(pageSize);
+
+	if (!start) {
+		throw KiwiInterpretError("out of memory");
+	}
+
+	Boxx::UInt blockSize = classSizes[sizeClass];
+	Boxx::UInt count     = pageSize / blockSize;
+
+	Page* page = new Page();
+	page->start     = start;
+	page->blockSize = blockSize;
+	page->sizeClass = sizeClass;
+	page->sizes     = new Boxx::UShort[count]();
+
+	Register(page, 1);
+
+	// Link all blocks in address order
+	for (Boxx::UInt i = 0; i + 1 < count; i++) {
+		Data::Set<DataPtr>(start + i * blockSize, start + (i + 1) * blockSize);
+	}
+
+	Data::Set<DataPtr>(start + (count - 1) * blockSize, nullptr);
+	return start;
+}
+
+DataPtr Heap::AllocLarge(Boxx::UInt size) {
+	if (size > maxSize) {
+		throw KiwiInterpretError("out of memory");
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	DataPtr start = MapPages(size);
+
+	if (!start) {
+		throw KiwiInterpretError("out of memory");
+	}
+
+	Page* page = new Page();
+	page->start = start;
+	page->size  = size;
+
+	Register(page, Memory::Align(size) / pageSize);
+	return start;
+}
+
+void Heap::FreeLarge(Page* page) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	Unregister(page, Memory::Align(page->size) / pageSize);
+	UnmapPages(page->start, page->size);
+	delete page;
+}
+
+DataPtr Heap::MapPages(Boxx::UInt size) {
+	if (!region) {
+		return Memory::Map(size);
+	}
+
+	size = Memory::Align(size);
+
+	// Reuse the first run of free pages that is large enough
+	for (Boxx::UInt i = 0; i < freeRuns.Count(); i++) {
+		if (freeRuns[i].size < size) continue;
+
+		DataPtr start = freeRuns[i].start;
+
+		if (freeRuns[i].size == size) {
+			freeRuns.RemoveAt(i);
+		}
+		else {
+			freeRuns[i].start += size;
+			freeRuns[i].size  -= size;
+		}
+
+		std::memset(start, 0, size);
+		return start;
+	}
+
+	if (size > regionSize - regionTop) {
+		return nullptr;
+	}
+
+	DataPtr start = region + regionTop;
+	regionTop += size;
+	return start;
+}
+
+void Heap::UnmapPages(DataPtr start, Boxx::UInt size) {
+	if (!region) {
+		Memory::Unmap(start, size);
+		return;
+	}
+
+	size = Memory::Align(size);
+
+	// Find the first run after the pages
+	Boxx::UInt low = 0, high = freeRuns.Count();
+
+	while (low < high) {
+		Boxx::UInt mid = (low + high) / 2;
+
+		if (freeRuns[mid].start < start) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+
+	Boxx::UInt i = low;
+
+	// Merge with the previous run
+	if (i > 0 && freeRuns[i - 1].start + freeRuns[i - 1].size == start) {
+		i--;
+		freeRuns[i].size += size;
+	}
+	else {
+		Run run;
+		run.start = start;
+		run.size  = size;
+		freeRuns.Insert(i, run);
+	}
+
+	// Merge with the next run
+	if (i + 1 < freeRuns.Count() && freeRuns[i].start + freeRuns[i].size == freeRuns[i + 1].start) {
+		freeRuns[i].size += freeRuns[i + 1].size;
+		freeRuns.RemoveAt(i + 1);
+	}
+
+	// Give the last run back to the top of the region
+	if (freeRuns[i].start + freeRuns[i].size == region + regionTop) {
+		regionTop = (Boxx::UInt)(freeRuns[i].start - region);
+		freeRuns.RemoveAt(i);
+	}
+}
+
+Heap::Page* Heap::Find(DataPtr ptr) const {
+	Boxx::ULong key = (Boxx::ULong)ptr / pageSize;
+
+	if (!table || key >> (tableBits * 2) != 0) return nullptr;
+
+	PageTable* pages = table[key >> tableBits];
+	return pages ? pages->pages[key & (tableSize - 1)] : nullptr;
+}
+
+Boxx::UInt Heap::BlockIndex(Page* page, DataPtr ptr) const {
+	return (Boxx::UInt)(ptr - page->start) / page->blockSize;
+}
+
+void Heap::Register(Page* page, Boxx::UInt pages) {
+	if (!table) {
+		table = (PageTable**)Memory::Map(sizeof(PageTable*) * tableSize);
+
+		if (!table) {
+			throw KiwiInterpretError("out of memory");
+		}
+	}
+
+	Boxx::ULong first = (Boxx::ULong)page->start / pageSize;
+
+	for (Boxx::ULong key = first; key < first + pages; key++) {
+		if (key >> (tableBits * 2) != 0) {
+			throw KiwiInterpretError("heap address out of range");
+		}
+
+		PageTable*& entries = table[key >> tableBits];
+
+		if (!entries) {
+			entries = (PageTable*)Memory::Map(sizeof(PageTable));
+
+			if (!entries) {
+				throw KiwiInterpretError("out of memory");
+			}
+		}
+
+		entries->pages[key & (tableSize - 1)] = page;
+	}
+}
+
+void Heap::Unregister(Page* page, Boxx::UInt pages) {
+	Boxx::ULong first = (Boxx::ULong)page->start / pageSize;
+
+	for (Boxx::ULong key = first; key < first + pages; key++) {
+		table[key >> tableBits]->pages[key & (tableSize - 1)] = nullptr;
+	}
+}
+
+StringPool::StringPool(MemoryImage* image) {
+	this->image = image;
+}
+
+StringPool::~StringPool() {
+	for (const Boxx::Tuple<DataPtr, Boxx::UInt>& section : sections) {
+		Memory::Unmap(section.value1, section.value2);
+	}
+}
+
+void StringPool::Add(const Boxx::List<Boxx::String>& literals) {
+	Boxx::List<Boxx::String> added;
+	Boxx::UInt size = 0;
+
+	for (const Boxx::String& literal : literals) {
+		if (this->literals.Contains(literal)) continue;
+
+		this->literals.Add(literal, nullptr);
+		added.Add(literal);
+		size += literal.Length() + 1;
+	}
+
+	if (added.IsEmpty()) return;
+
+	DataPtr section = image ? image->AllocStatic(size) : Memory::Map(size);
+
+	if (!section) {
+		throw KiwiInterpretError("out of memory");
+	}
+
+	DataPtr ptr = section;
+
+	for (const Boxx::String& literal : added) {
+		std::memcpy(ptr, (const char*)literal, literal.Length());
+		ptr[literal.Length()] = '\0';
+
+		this->literals.Set(literal, ptr);
+		sizes.Add(ptr, literal.Length());
+
+		ptr += literal.Length() + 1;
+	}
+
+	// The static region of an image is released with the image
+	if (!image) {
+		Memory::Protect(section, size);
+		sections.Add(Boxx::Tuple<>::Create(section, size));
+	}
+}
+
+DataPtr StringPool::Get(const Boxx::String& literal) {
+	DataPtr ptr;
+
+	if (literals.Contains(literal, ptr)) {
+		return ptr;
+	}
+
+	Boxx::List<Boxx::String> list;
+	list.Add(literal);
+	Add(list);
+
+	return literals[literal];
+}
+
+Boxx::UInt StringPool::GetSize(DataPtr ptr) const {
+	Boxx::UInt size;
+
+	if (sizes.Contains(ptr, size)) {
+		return size;
+	}
+
+	return 0;
+}
+
+Boxx::ULong InterpreterData::GetPointer(Data value) const {
+	return program->PointerSize() == 4 ? value.Get<Boxx::UInt>() : value.Get<Boxx::ULong>();
+}
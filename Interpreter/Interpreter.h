@@ -8,66 +8,119 @@
 #include "../Boxx/Boxx/Stack.h"
 #include "../Boxx/Boxx/Error.h"
 #include "../Boxx/Boxx/Math.h"
+#include "../Boxx/Boxx/Tuple.h"
 
 #include "../Structs.h"
 
+#include "Memory.h"
+#include "MemoryImage.h"
+#include "Profiler.h"
+
+#include <mutex>
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(KIWI_NO_THREADED_DISPATCH)
+	/// Defined if the compiler supports direct threaded dispatch.
+	///
+	/// Define {KIWI_NO_THREADED_DISPATCH} to only use the portable switch dispatch.
+	#define KIWI_THREADED_DISPATCH
+#endif
+
 ///N Kiwi::Interpreter
 
 namespace Kiwi {
 	class KiwiProgram;
+	class Instruction;
 
 	namespace Interpreter {
 		using Byte    = Boxx::UByte;
 		using DataPtr = Byte*;
 
 		/// Interpreter data.
+		///
+		/// Data of at most {inlineSize} bytes is stored inline and copied by value.
+		/// Larger data and shared data is stored in an array that is shared between copies.
 		struct Data {
 		public:
+			/// The max byte size of inline data.
+			static const Boxx::UInt inlineSize = 8;
+
 			Data() {
 				
 			}
 
 			/// Creates data of specified size.
 			Data(Boxx::UInt size) {
-				data = Boxx::Array<Byte>(size);
+				Init(size);
 			}
 
 			/// Create data from the specified pointer.
 			Data(DataPtr ptr, Boxx::UInt size) {
-				data = Boxx::Array<Byte>(size);
-				std::memcpy((DataPtr)data, ptr, size * sizeof(Byte));
+				Init(size);
+				std::memcpy(Ptr(), ptr, size * sizeof(Byte));
 			}
 
 			/// Create data from the specified data.
 			Data(const Data& data, Boxx::UInt size) {
-				this->data = Boxx::Array<Byte>(size);
+				Init(size);
+
+				DataPtr ptr = Ptr();
 
 				for (Boxx::UInt i = data.Size(); i < size; i++) {
-					this->data[i] = 0;
+					ptr[i] = 0;
 				}
 
-				std::memcpy((DataPtr)this->data, data.Ptr(), Boxx::Math::Min(size, data.Size()) * sizeof(Byte));
+				std::memcpy(ptr, data.Ptr(), Boxx::Math::Min(size, data.Size()) * sizeof(Byte));
 			}
 
+			Data(const Data& data) = default;
+			Data(Data&& data) = default;
+
 			~Data() {
 				
 			}
 
+			Data& operator=(const Data& data) = default;
+			Data& operator=(Data&& data) = default;
+
+			/// Creates data of the specified size that is never stored inline.
+			///
+			/// The memory of shared data does not move and is shared between all copies.
+			static Data Shared(Boxx::UInt size) {
+				Data shared;
+				shared.isInline = false;
+				shared.data = Boxx::Array<Byte>(size);
+				return shared;
+			}
+
+			/// Gets shared data with the same content.
+			///
+			/// Returns the data itself if it is already shared.
+			Data ToShared() const {
+				if (!isInline) return *this;
+
+				Data shared = Shared(size);
+				std::memcpy(shared.Ptr(), Ptr(), size * sizeof(Byte));
+				return shared;
+			}
+
+			/// {true} if the data is stored inline.
+			bool IsInline() const {
+				return isInline;
+			}
+
 			/// Copies the data.
 			Data Copy() const {
-				Data copy = Data(data.Length());
-				std::memcpy((DataPtr)copy.data, (DataPtr)data, data.Length() * sizeof(Byte));
-				return copy;
+				return Data(Ptr(), Size());
 			}
 
 			/// Gets the data pointer.
 			DataPtr Ptr() const {
-				return (DataPtr)data;
+				return isInline ? (DataPtr)bytes : (DataPtr)data;
 			}
 
 			/// The size of the data.
 			Boxx::UInt Size() const {
-				return data.Length();
+				return isInline ? size : data.Length();
 			}
 
 			Boxx::ULong GetNumber(Boxx::UInt size) {
@@ -102,8 +155,8 @@ namespace Kiwi {
 				Set(Ptr(), t);
 			}
 
-			static void Set(DataPtr ptr, Data data) {
-				std::memcpy(ptr, data.Ptr(), data.data.Length() * sizeof(Interpreter::Byte));
+			static void Set(DataPtr ptr, const Data& data) {
+				std::memcpy(ptr, data.Ptr(), data.Size() * sizeof(Interpreter::Byte));
 			}
 
 			template <class T>
@@ -117,7 +170,21 @@ namespace Kiwi {
 			}
 
 		private:
+			alignas(8) Byte bytes[inlineSize] = {};
+			Boxx::UInt size = 0;
+			bool isInline = true;
+
 			Boxx::Array<Byte> data;
+
+			void Init(Boxx::UInt size) {
+				if (size <= inlineSize) {
+					this->size = size;
+				}
+				else {
+					isInline = false;
+					data = Boxx::Array<Byte>(size);
+				}
+			}
 		};
 
 		/// Base for interpreter values.
@@ -159,6 +226,27 @@ namespace Kiwi {
 			Boxx::Map<Boxx::String, Kiwi::Type> varTypes;
 			Boxx::Map<Boxx::String, Data> variables;
 
+			/// The top of the call stack when the frame was pushed.
+			///
+			/// Stack allocations made in the frame are released down to it when the frame is popped.
+			Boxx::UInt sp = 0;
+
+			/// The name of the function of the frame.
+			///
+			/// Empty for code blocks.
+			/// Only set if a heap profiler is used.
+			Boxx::String function;
+
+			/// The index of the instruction that is interpreted in the function or code block.
+			///
+			/// Only set if a heap profiler is used.
+			Boxx::UInt instructionIndex = 0;
+
+			/// The instruction that is interpreted.
+			///
+			/// Only set if a heap profiler is used.
+			Weak<Instruction> instruction;
+
 			virtual ~Frame() {}
 
 			/// Gets the value of the specified variable.
@@ -180,12 +268,21 @@ namespace Kiwi {
 			}
 
 			/// Sets the value of a variable.
-			void SetVarValue(const Boxx::String& var, Data value) {
+			///
+			/// The value is written to the existing memory of the variable if the size is the same.
+			void SetVarValue(const Boxx::String& var, const Data& value) {
 				if (!varTypes.Contains(var)) {
 					throw KiwiInterpretError("Variable '" + var + "' does not exist");
 				}
 
-				variables.Set(var, value);
+				Data current;
+
+				if (variables.Contains(var, current) && current.Size() == value.Size()) {
+					std::memcpy(current.Ptr(), value.Ptr(), value.Size() * sizeof(Byte));
+				}
+				else {
+					variables.Set(var, value.ToShared());
+				}
 			}
 
 			/// Gets the type of a variable.
@@ -212,52 +309,344 @@ namespace Kiwi {
 		};
 
 		/// The memory heap.
+		///
+		/// Small allocations are taken from slabs that contain blocks of the same size class.
+		/// Freed blocks are put in free lists that are local to the current thread.
+		/// Large allocations are mapped directly from the operating system.
+		/// A side table maps each heap page to its slab or large allocation so pointers are validated in constant time.
+		/// The heap can also take all its pages from a fixed region of memory.
 		class Heap {
 		public:
-			Boxx::Map<DataPtr, Data> values;
+			/// The byte size of a heap page.
+			///
+			/// Each slab is one page and large allocations use whole pages.
+			static constexpr Boxx::UInt pageSize = Memory::alignment;
 
-			virtual ~Heap() {}
+			/// The largest allocation size that uses a slab.
+			static constexpr Boxx::UInt maxSmallSize = 2048;
 
-			/// Allocates data on the heap.
-			Data Alloc(Boxx::UInt size) {
-				Data data = Data(size == 0 ? 1 : size);
-				values.Add(data.Ptr(), data);
-				return data;
+			/// The largest size that can be allocated.
+			///
+			/// Larger sizes would wrap when rounded up to whole pages.
+			static constexpr Boxx::UInt maxSize = 0xFFFFFFFF - (pageSize - 1);
+
+			/// The number of size classes.
+			static constexpr Boxx::UInt classCount = 24;
+
+			/// The block size of each size class.
+			static constexpr Boxx::UInt classSizes[classCount] = {
+				16,  32,  48,  64,  80,   96,   112,  128,
+				160, 192, 224, 256, 320,  384,  448,  512,
+				640, 768, 896, 1024, 1280, 1536, 1792, 2048
+			};
+
+			Heap();
+
+			/// Creates a heap that takes all pages from a region of mapped memory.
+			///
+			/// The region has to be aligned to {pageSize} bytes and is not owned by the heap.
+			Heap(DataPtr region, Boxx::UInt size);
+
+			Heap(const Heap&) = delete;
+			virtual ~Heap();
+
+			Heap& operator=(const Heap&) = delete;
+
+			/// Allocates cleared memory on the heap.
+			DataPtr Alloc(Boxx::UInt size);
+
+			/// Frees up the memory at the given address.
+			///
+			/// Regions can not be freed and are released with {DestroyRegion}.
+			void Free(DataPtr ptr);
+
+			/// True if the specified pointer has been allocated.
+			bool IsAllocated(DataPtr ptr) const;
+
+			/// Gets the size of the specified pointer.
+			Boxx::UInt GetSize(DataPtr ptr) const;
+
+			/// The byte size of the chunks that regions allocate from.
+			static constexpr Boxx::UInt regionChunkSize = pageSize;
+
+			/// The largest allocation size that is placed in a shared region chunk.
+			///
+			/// Larger allocations in a region get a chunk of their own.
+			static constexpr Boxx::UInt maxRegionBlockSize = regionChunkSize / 4;
+
+			/// Creates a memory region.
+			///
+			/// Allocations in a region bump a pointer in a chunk of heap memory and can not be freed one by one.
+			/// All of them are freed at once by {DestroyRegion}.
+			/// The region is a handle to state that is kept outside of heap memory so programs can not change it.
+			///R region: The address of the region.
+			DataPtr CreateRegion();
+
+			/// Allocates cleared memory in a region.
+			///
+			/// The memory is 8 byte aligned.
+			DataPtr RegionAlloc(DataPtr region, Boxx::UInt size);
+
+			/// Frees a region and all memory allocated in it.
+			void DestroyRegion(DataPtr region);
+
+			/// True if the specified pointer is a region that has not been destroyed.
+			bool IsRegion(DataPtr ptr) const;
+
+			/// Records the chunks of regions in a profiler.
+			///
+			/// Chunks are recorded as allocations of a {region} site when a region takes them and as frees when the region is destroyed.
+			void Profile(HeapProfiler* profiler);
+
+		private:
+			/// The state of a region.
+			struct Region {
+				/// All chunks of the region.
+				Boxx::List<DataPtr> chunks;
+
+				/// The free space in the current chunk.
+				DataPtr top = nullptr, end = nullptr;
+			};
+
+			/// The most freed chunks that are kept for new regions.
+			static constexpr Boxx::UInt maxFreeChunks = 16;
+
+			/// A slab or a large allocation.
+			struct Page {
+				DataPtr start = nullptr;
+
+				/// The block size of a slab or {0} for large allocations.
+				Boxx::UInt blockSize = 0;
+				Boxx::UInt sizeClass = 0;
+
+				/// The size of a large allocation.
+				Boxx::UInt size = 0;
+
+				/// The allocated size of each block in a slab or {0} if the block is free.
+				Boxx::UShort* sizes = nullptr;
+			};
+
+			static constexpr Boxx::UInt tableBits = 16;
+			static constexpr Boxx::UInt tableSize = 1 << tableBits;
+
+			struct PageTable {
+				Page* pages[tableSize];
+			};
+
+			/// Free pages in the region.
+			struct Run {
+				DataPtr start;
+				Boxx::UInt size;
+			};
+
+			/// The free lists of the current thread for one heap.
+			struct ThreadCache {
+				Boxx::ULong heap = 0;
+				DataPtr lists[classCount] = {};
+			};
+
+			static thread_local ThreadCache cache;
+
+			static std::mutex registryMutex;
+			static Boxx::Map<Boxx::ULong, Heap*> heaps;
+			static Boxx::ULong nextId;
+
+			Boxx::ULong id;
+			std::mutex mutex;
+			DataPtr freeLists[classCount] = {};
+
+			/// Two level side table from page number to page.
+			PageTable** table = nullptr;
+
+			DataPtr region = nullptr;
+			Boxx::UInt regionSize = 0, regionTop = 0;
+
+			/// The free runs below {regionTop} sorted by address.
+			///
+			/// Adjacent runs are merged and a run that ends at {regionTop} is given back to the top.
+			Boxx::List<Run> freeRuns;
+
+			/// The state of each region by handle.
+			Boxx::Map<DataPtr, Region*> regions;
+			mutable std::mutex regionMutex;
+
+			/// Freed region chunks that are kept for new regions.
+			Boxx::List<DataPtr> freeChunks;
+
+			HeapProfiler* profiler = nullptr;
+			Boxx::UInt chunkSite = 0;
+
+			DataPtr MapPages(Boxx::UInt size);
+			void UnmapPages(DataPtr start, Boxx::UInt size);
+
+			ThreadCache& Cache();
+			void ReturnLists(DataPtr* lists);
+
+			DataPtr Refill(Boxx::UInt sizeClass);
+			DataPtr AllocLarge(Boxx::UInt size);
+			void FreeLarge(Page* page);
+
+			DataPtr AllocChunk();
+			void FreeChunk(DataPtr chunk);
+			Region* GetRegion(DataPtr region) const;
+
+			Page* Find(DataPtr ptr) const;
+			Boxx::UInt BlockIndex(Page* page, DataPtr ptr) const;
+			void Register(Page* page, Boxx::UInt pages);
+			void Unregister(Page* page, Boxx::UInt pages);
+		};
+
+		/// A pool of string literals.
+		///
+		/// Each distinct literal is stored once with a null terminator in a read only constant section.
+		class StringPool {
+		public:
+			/// Creates a pool.
+			///
+			/// If {image} is not {nullptr} the constant sections are stored in its static region instead.
+			StringPool(MemoryImage* image = nullptr);
+			StringPool(const StringPool&) = delete;
+			virtual ~StringPool();
+
+			StringPool& operator=(const StringPool&) = delete;
+
+			/// Adds string literals to the pool.
+			///
+			/// All literals that are not in the pool yet are stored in one new constant section.
+			void Add(const Boxx::List<Boxx::String>& literals);
+
+			/// Gets the address of a string literal.
+			///
+			/// Adds the literal to the pool if it is not in the pool.
+			DataPtr Get(const Boxx::String& literal);
+
+			/// Gets the length of the literal at the specified address.
+			///
+			/// Returns {0} if the address is not the start of a literal.
+			Boxx::UInt GetSize(DataPtr ptr) const;
+
+		private:
+			MemoryImage* image;
+
+			Boxx::Map<Boxx::String, DataPtr> literals;
+			Boxx::Map<DataPtr, Boxx::UInt> sizes;
+			Boxx::List<Boxx::Tuple<DataPtr, Boxx::UInt>> sections;
+		};
+
+		/// A contiguous call stack.
+		///
+		/// Stack frames are bump allocated from a single region that is reserved up front.
+		class CallStack {
+		public:
+			/// The default capacity in bytes.
+			static const Boxx::UInt defaultCapacity = 8 * 1024 * 1024;
+
+			/// The offset of the current frame.
+			Boxx::UInt fp = 0;
+
+			/// The offset of the first unused byte.
+			Boxx::UInt sp = 0;
+
+			CallStack(Boxx::UInt capacity = defaultCapacity) {
+				owned  = Boxx::Array<Byte>(capacity);
+				memory = (DataPtr)owned;
+				this->capacity = capacity;
 			}
 
-			/// Frees up the given data.
-			void Free(Data data) {
-				Free(data.Ptr());
+			/// Creates a call stack in a region of memory that is not owned by the stack.
+			CallStack(DataPtr region, Boxx::UInt capacity) {
+				memory = region;
+				this->capacity = capacity;
 			}
 
-			/// Frees up the value at the given address.
-			void Free(DataPtr data) {
-				if (!IsAllocated(data)) {
-					throw KiwiInterpretError("Attempt to free memory that is not allocated");
+			virtual ~CallStack() {}
+
+			/// Pushes a cleared frame of the specified size.
+			///
+			/// Frames are 8 byte aligned and never empty so unbounded recursion always overflows.
+			///R fp: The offset of the previous frame.
+			Boxx::UInt Push(Boxx::UInt size) {
+				Boxx::ULong bytes = size == 0 ? 8 : ((Boxx::ULong)size + 7) / 8 * 8;
+
+				if (bytes > capacity - sp) {
+					throw KiwiInterpretError("stack overflow");
 				}
 
-				values.Remove(data);
+				Boxx::UInt prev = fp;
+				fp  = sp;
+				sp += (Boxx::UInt)bytes;
+
+				std::memset(Ptr(fp), 0, (std::size_t)bytes);
+				return prev;
 			}
 
-			/// True if the specified pointer has been allocated.
-			bool IsAllocated(DataPtr ptr) {
-				return values.Contains(ptr);
+			/// Pops the current frame.
+			void Pop(Boxx::UInt prev) {
+				sp = fp;
+				fp = prev;
 			}
 
-			/// Gets the size of the specified pointer.
-			Boxx::UInt GetSize(DataPtr ptr) {
-				if (!IsAllocated(ptr)) return 0;
-				return values[ptr].Size();
+			/// Allocates cleared memory on top of the current frame.
+			///
+			/// The memory is 8 byte aligned and is released when the frame is popped.
+			DataPtr Alloc(Boxx::UInt size) {
+				// Rounded in 64 bits so sizes near the limit overflow the stack instead of wrapping to 0
+				Boxx::ULong bytes = ((Boxx::ULong)size + 7) / 8 * 8;
+
+				if (bytes > capacity - sp) {
+					throw KiwiInterpretError("stack overflow");
+				}
+
+				DataPtr ptr = Ptr(sp);
+				sp += (Boxx::UInt)bytes;
+
+				std::memset(ptr, 0, (std::size_t)bytes);
+				return ptr;
+			}
+
+			/// Gets the pointer to the specified stack offset.
+			DataPtr Ptr(Boxx::UInt offset) const {
+				return memory + offset;
 			}
+
+			/// The capacity in bytes.
+			Boxx::UInt Capacity() const {
+				return capacity;
+			}
+
+		private:
+			DataPtr memory;
+			Boxx::UInt capacity;
+			Boxx::Array<Byte> owned;
 		};
 
+		/// Ways to dispatch bytecode operations.
+		enum class Dispatch : Boxx::UByte {
+			///T Values
+			///M
+			/// A switch on the op code of each operation.
+			Switch,
+
+			/// A jump to the handler address of each operation.
+			/// Falls back to {Switch} if the compiler does not support it.
+			Threaded
+			///M
+		};
+
+		/// The default dispatch.
+	#ifdef KIWI_THREADED_DISPATCH
+		constexpr Dispatch defaultDispatch = Dispatch::Threaded;
+	#else
+		constexpr Dispatch defaultDispatch = Dispatch::Switch;
+	#endif
+
 		/// Data used by the interpreter.
 		struct InterpreterData {
 			/// The current Kiwi program.
 			Weak<KiwiProgram> program;
 
-			/// The next label to go to.
-			Boxx::Optional<Boxx::String> gotoLabel;
+			/// The index of the next block to go to.
+			Boxx::Optional<Boxx::UInt> gotoBlock;
 
 			/// All stack frames.
 			Boxx::Stack<Ptr<Frame>> frames;
@@ -265,11 +654,31 @@ namespace Kiwi {
 			/// The current stack frame.
 			Weak<Frame> frame;
 
+			/// The memory image used by compiled code.
+			///
+			/// If this is {nullptr} compiled code uses host memory and pointers are host addresses.
+			/// Set it with {UseImage}.
+			Ptr<MemoryImage> image;
+
 			/// The heap.
 			Ptr<Heap> heap = new Heap();
 
+			/// The call stack used by compiled code.
+			Ptr<CallStack> stack = new CallStack();
+
+			/// The string literals.
+			Ptr<StringPool> strings = new StringPool();
+
+			/// The heap profiler.
+			///
+			/// Heap allocations are only profiled if this is not {nullptr}.
+			Ptr<HeapProfiler> profiler;
+
+			/// The dispatch used by compiled code.
+			Dispatch dispatch = defaultDispatch;
+
 			/// The static data.
-			Boxx::Map<Boxx::String, Data> staticData;
+			Boxx::Map<Boxx::String, DataPtr> staticData;
 
 			/// A map of function data.
 			Boxx::Map<Boxx::String, Boxx::UInt> funcIdMap;
@@ -282,14 +691,56 @@ namespace Kiwi {
 
 			~InterpreterData() {}
 
+			/// Runs compiled code in a memory image.
+			///
+			/// The heap and the call stack are replaced by regions of the image.
+			/// Static data and string literals are allocated in the static region of the image.
+			void UseImage(Ptr<MemoryImage> image) {
+				this->image = image;
+				ResetImage();
+			}
+
+			/// Clears the memory image and recreates the heap and the call stack.
+			void ResetImage() {
+				heap    = nullptr;
+				stack   = nullptr;
+				strings = nullptr;
+				staticData = Boxx::Map<Boxx::String, DataPtr>();
+
+				image->Reset();
+
+				heap    = new Heap(image->HeapRegion(), image->HeapSize());
+				stack   = new CallStack(image->StackRegion(), image->StackSize());
+				strings = new StringPool(*image);
+			}
+
+			/// Converts a host address to a pointer value.
+			Boxx::ULong ToPointer(DataPtr ptr) const {
+				return image ? image->ToPointer(ptr) : (Boxx::ULong)ptr;
+			}
+
+			/// Reads a pointer value of the pointer size of the program.
+			Boxx::ULong GetPointer(Data value) const;
+
+			/// Converts a pointer value to a host address.
+			///
+			/// Throws if an image is used and {size} bytes at the pointer are outside of it.
+			DataPtr FromPointer(Boxx::ULong pointer, Boxx::UInt size) const {
+				return image ? image->FromPointer(pointer, size) : (DataPtr)pointer;
+			}
+
 			/// Pushes a new stack frame.
 			void PushFrame() {
 				frames.Push(new Frame());
 				frame = frames.Peek();
+				frame->sp = stack->sp;
 			}
 
 			/// Pops a stack frame.
+			///
+			/// Releases all stack allocations made in the frame.
 			void PopFrame() {
+				stack->sp = frames.Peek()->sp;
 				frames.Pop();
 
 				if (!frames.IsEmpty()) {
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <type_traits>
+
+#include "Interpreter.h"
+#include "Bytecode.h"
+
+///N Kiwi::Interpreter
+
+namespace Kiwi {
+	namespace Interpreter {
+		/// Integer operations for the integer type {T}.
+		///
+		/// Arithmetic wraps around on overflow.
+		/// Comparisons and right shifts use the signedness of {T}.
+		/// Shift amounts are taken modulo the bit width of {T}.
+		template <class T>
+		struct IntKernels {
+			using U = std::make_unsigned_t<T>;
+
+			static constexpr U mask = sizeof(T) * 8 - 1;
+
+			static T Neg(T a) { return (T)(0 - (Boxx::ULong)(U)a); }
+			static T Not(T a) { return (T)~(U)a; }
+
+			static T Add(T a, T b) { return (T)((Boxx::ULong)(U)a + (Boxx::ULong)(U)b); }
+			static T Sub(T a, T b) { return (T)((Boxx::ULong)(U)a - (Boxx::ULong)(U)b); }
+			static T Mul(T a, T b) { return (T)((Boxx::ULong)(U)a * (Boxx::ULong)(U)b); }
+
+			static T Div(T a, T b) {
+				if (b == 0) throw KiwiInterpretError("div by zero");
+				if (std::is_signed_v<T> && b == (T)-1) return Neg(a);
+				return (T)(a / b);
+			}
+
+			static T Mod(T a, T b) {
+				if (b == 0) throw KiwiInterpretError("mod by zero");
+				if (std::is_signed_v<T> && b == (T)-1) return 0;
+				return (T)(a % b);
+			}
+
+			static T Or(T a, T b)  { return (T)(a | b); }
+			static T And(T a, T b) { return (T)(a & b); }
+			static T Xor(T a, T b) { return (T)(a ^ b); }
+
+			static T Shl(T a, T b) { return (T)((Boxx::ULong)(U)a << ((U)b & mask)); }
+			static T Shr(T a, T b) { return (T)(a >> ((U)b & mask)); }
+
+			static T Eq(T a, T b) { return a == b; }
+			static T Ne(T a, T b) { return a != b; }
+			static T Lt(T a, T b) { return a <  b; }
+			static T Gt(T a, T b) { return a >  b; }
+			static T Le(T a, T b) { return a <= b; }
+			static T Ge(T a, T b) { return a >= b; }
+
+			/// Evaluates an operation.
+			/// {b} is ignored for unary operations.
+			static void Evaluate(IntOp op, DataPtr result, DataPtr a, DataPtr b) {
+				T x = Data::Get<T>(a);
+				T y = op == IntOp::Neg || op == IntOp::Not ? 0 : Data::Get<T>(b);
+				T r = 0;
+
+				switch (op) {
+					case IntOp::Neg: r = Neg(x);    break;
+					case IntOp::Not: r = Not(x);    break;
+					case IntOp::Add: r = Add(x, y); break;
+					case IntOp::Sub: r = Sub(x, y); break;
+					case IntOp::Mul: r = Mul(x, y); break;
+					case IntOp::Div: r = Div(x, y); break;
+					case IntOp::Mod: r = Mod(x, y); break;
+					case IntOp::Or:  r = Or(x, y);  break;
+					case IntOp::And: r = And(x, y); break;
+					case IntOp::Xor: r = Xor(x, y); break;
+					case IntOp::Shl: r = Shl(x, y); break;
+					case IntOp::Shr: r = Shr(x, y); break;
+					case IntOp::Eq:  r = Eq(x, y);  break;
+					case IntOp::Ne:  r = Ne(x, y);  break;
+					case IntOp::Lt:  r = Lt(x, y);  break;
+					case IntOp::Gt:  r = Gt(x, y);  break;
+					case IntOp::Le:  r = Le(x, y);  break;
+					case IntOp::Ge:  r = Ge(x, y);  break;
+				}
+
+				Data::Set<T>(result, r);
+			}
+		};
+
+		/// Reads an integer of the type with the specified id and sign or zero extends it.
+		inline Boxx::Long ReadInt(DataPtr ptr, Boxx::UInt type) {
+			switch (type) {
+				case TypeId::i8:  return Data::Get<Boxx::Byte>(ptr);
+				case TypeId::u8:  return Data::Get<Boxx::UByte>(ptr);
+				case TypeId::i16: return Data::Get<Boxx::Short>(ptr);
+				case TypeId::u16: return Data::Get<Boxx::UShort>(ptr);
+				case TypeId::i32: return Data::Get<Boxx::Int>(ptr);
+				case TypeId::u32: return Data::Get<Boxx::UInt>(ptr);
+				default:          return Data::Get<Boxx::Long>(ptr);
+			}
+		}
+
+		/// Evaluates an integer operation on integers of the type with the specified id.
+		inline void EvaluateIntOp(IntOp op, Boxx::UInt type, DataPtr result, DataPtr a, DataPtr b) {
+			switch (type) {
+				case TypeId::i8:  IntKernels<Boxx::Byte>::Evaluate(op, result, a, b);   break;
+				case TypeId::u8:  IntKernels<Boxx::UByte>::Evaluate(op, result, a, b);  break;
+				case TypeId::i16: IntKernels<Boxx::Short>::Evaluate(op, result, a, b);  break;
+				case TypeId::u16: IntKernels<Boxx::UShort>::Evaluate(op, result, a, b); break;
+				case TypeId::i32: IntKernels<Boxx::Int>::Evaluate(op, result, a, b);    break;
+				case TypeId::u32: IntKernels<Boxx::UInt>::Evaluate(op, result, a, b);   break;
+				case TypeId::i64: IntKernels<Boxx::Long>::Evaluate(op, result, a, b);   break;
+				default:          IntKernels<Boxx::ULong>::Evaluate(op, result, a, b);  break;
+			}
+		}
+	}
+}
@@ -0,0 +1,151 @@
+#include "Memory.h"
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+using namespace Boxx;
+
+using namespace Kiwi;
+using namespace Kiwi::Interpreter;
+
+UByte* Memory::Map(UInt size) {
+	size = Align(size);
+
+#ifdef _WIN32
+	// VirtualAlloc already returns memory aligned to the allocation granularity
+	return (UByte*)VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+	// Map extra memory and trim it to get the alignment
+	UInt total = size + alignment;
+	void* mem  = mmap(nullptr, total, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+	if (mem == MAP_FAILED) return nullptr;
+
+	UByte* start = (UByte*)mem;
+	UByte* ptr   = (UByte*)(((ULong)start + alignment - 1) / alignment * alignment);
+
+	if (ptr > start) {
+		munmap(start, ptr - start);
+	}
+
+	if (ptr + size < start + total) {
+		munmap(ptr + size, start + total - (ptr + size));
+	}
+
+	return ptr;
+#endif
+}
+
+void Memory::Unmap(UByte* ptr, UInt size) {
+	if (!ptr) return;
+
+#ifdef _WIN32
+	VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+	munmap(ptr, Align(size));
+#endif
+}
+
+void Memory::Protect(UByte* ptr, UInt size) {
+	if (!ptr) return;
+
+#ifdef _WIN32
+	DWORD old;
+	VirtualProtect(ptr, size, PAGE_READONLY, &old);
+#else
+	mprotect(ptr, Align(size), PROT_READ);
+#endif
+}
+
+void Memory::Reset(UByte* ptr, UInt size) {
+	if (!ptr) return;
+
+#ifdef _WIN32
+	VirtualFree(ptr, size, MEM_DECOMMIT);
+	VirtualAlloc(ptr, size, MEM_COMMIT, PAGE_READWRITE);
+#else
+	madvise(ptr, size, MADV_DONTNEED);
+#endif
+}
+
+MappedFile::MappedFile(const String& filename) {
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE) return;
+
+	LARGE_INTEGER fileSize;
+
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart > 0xFFFFFFFF) {
+		CloseHandle(file);
+		return;
+	}
+
+	size = (UInt)fileSize.QuadPart;
+	open = true;
+
+	// Empty files can not be mapped
+	if (size > 0) {
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+		if (mapping) CloseHandle(mapping);
+
+		if (view) {
+			data = (const char*)view;
+		}
+		else {
+			size = 0;
+			open = false;
+		}
+	}
+
+	CloseHandle(file);
+#else
+	int file = ::open(filename, O_RDONLY);
+
+	if (file < 0) return;
+
+	struct stat info;
+
+	if (fstat(file, &info) != 0 || (ULong)info.st_size > 0xFFFFFFFF) {
+		close(file);
+		return;
+	}
+
+	size = (UInt)info.st_size;
+	open = true;
+
+	// Empty files can not be mapped
+	if (size > 0) {
+		void* mem = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+
+		if (mem != MAP_FAILED) {
+			madvise(mem, size, MADV_SEQUENTIAL);
+			data = (const char*)mem;
+		}
+		else {
+			size = 0;
+			open = false;
+		}
+	}
+
+	close(file);
+#endif
+}
+
+MappedFile::~MappedFile() {
+	if (size == 0) return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+#else
+	munmap((void*)data, size);
+#endif
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "../Boxx/Boxx/Types.h"
+#include "../Boxx/Boxx/String.h"
+
+///N Kiwi::Interpreter
+
+namespace Kiwi {
+	namespace Interpreter {
+		/// Maps memory directly from the operating system.
+		class Memory {
+		public:
+			/// The alignment of mapped memory.
+			static constexpr Boxx::UInt alignment = 64 * 1024;
+
+			/// Maps zeroed memory of the specified size.
+			///
+			/// The memory is aligned to {alignment} bytes.
+			///R ptr: The memory or {nullptr} if the mapping failed.
+			static Boxx::UByte* Map(Boxx::UInt size);
+
+			/// Unmaps memory returned by {Map}.
+			static void Unmap(Boxx::UByte* ptr, Boxx::UInt size);
+
+			/// Makes mapped memory read only.
+			static void Protect(Boxx::UByte* ptr, Boxx::UInt size);
+
+			/// Releases the physical pages of mapped memory.
+			///
+			/// The memory stays mapped and reads as zero afterwards.
+			static void Reset(Boxx::UByte* ptr, Boxx::UInt size);
+
+			/// Rounds a size up to a multiple of {alignment}.
+			static constexpr Boxx::UInt Align(Boxx::UInt size) {
+				return (size + alignment - 1) / alignment * alignment;
+			}
+		};
+
+		/// A read only mapping of a file.
+		///
+		/// The file is not copied into memory and its pages are only read when they are accessed.
+		class MappedFile {
+		public:
+			/// Maps the specified file.
+			///
+			/// Use {IsOpen} to check if the file was mapped.
+			MappedFile(const Boxx::String& filename);
+			MappedFile(const MappedFile&) = delete;
+			~MappedFile();
+
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			/// {true} if the file was mapped.
+			bool IsOpen() const {
+				return open;
+			}
+
+			/// Gets the content of the file.
+			const char* Data() const {
+				return data;
+			}
+
+			/// The byte size of the file.
+			Boxx::UInt Size() const {
+				return size;
+			}
+
+		private:
+			const char* data = "";
+			Boxx::UInt size = 0;
+			bool open = false;
+		};
+	}
+}
@@ -0,0 +1,50 @@
+#include "MemoryImage.h"
+
+#include "Interpreter.h"
+
+using namespace Boxx;
+
+using namespace Kiwi;
+using namespace Kiwi::Interpreter;
+
+MemoryImage::MemoryImage(UInt staticSize, UInt heapSize, UInt stackSize) {
+	heapStart  = Memory::alignment + Memory::Align(staticSize);
+	stackStart = heapStart + Memory::Align(heapSize);
+	size       = stackStart + Memory::Align(stackSize);
+	span       = size - Memory::alignment;
+	staticTop  = Memory::alignment;
+
+	base = Memory::Map(size);
+
+	if (!base) {
+		throw KiwiInterpretError("out of memory");
+	}
+}
+
+MemoryImage::~MemoryImage() {
+	Memory::Unmap(base, size);
+}
+
+UByte* MemoryImage::AllocStatic(UInt size) {
+	UInt start = (staticTop + 7) / 8 * 8;
+
+	if (size > heapStart - start) {
+		throw KiwiInterpretError("static region is full");
+	}
+
+	staticTop = start + size;
+	return base + start;
+}
+
+void MemoryImage::Reset() {
+	Memory::Reset(base, size);
+	staticTop = Memory::alignment;
+}
+
+UByte* MemoryImage::FromPointer(ULong pointer, UInt size) const {
+	if (!InBounds(pointer, size)) {
+		throw KiwiInterpretError("memory access out of bounds");
+	}
+
+	return base + pointer;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "Memory.h"
+
+///N Kiwi::Interpreter
+
+namespace Kiwi {
+	namespace Interpreter {
+		/// A single linear memory image for static data, the heap and the stack.
+		///
+		/// The image is one mapping split into a static region, a heap region and a stack region.
+		/// Pointers into the image are byte offsets from its start.
+		/// The first page is never used so the null pointer is never valid.
+		class MemoryImage {
+		public:
+			/// The default byte size of the static region.
+			static constexpr Boxx::UInt defaultStaticSize = 1024 * 1024;
+
+			/// The default byte size of the heap region.
+			static constexpr Boxx::UInt defaultHeapSize = 256 * 1024 * 1024;
+
+			/// The default byte size of the stack region.
+			static constexpr Boxx::UInt defaultStackSize = 8 * 1024 * 1024;
+
+			/// Maps a new image.
+			///
+			/// The region sizes are rounded up to whole pages.
+			MemoryImage(Boxx::UInt staticSize = defaultStaticSize, Boxx::UInt heapSize = defaultHeapSize, Boxx::UInt stackSize = defaultStackSize);
+			MemoryImage(const MemoryImage&) = delete;
+			~MemoryImage();
+
+			MemoryImage& operator=(const MemoryImage&) = delete;
+
+			/// Gets the start of the image.
+			Boxx::UByte* Base() const {
+				return base;
+			}
+
+			/// The byte size of the image.
+			Boxx::UInt Size() const {
+				return size;
+			}
+
+			/// Gets the start of the heap region.
+			Boxx::UByte* HeapRegion() const {
+				return base + heapStart;
+			}
+
+			/// The byte size of the heap region.
+			Boxx::UInt HeapSize() const {
+				return stackStart - heapStart;
+			}
+
+			/// Gets the start of the stack region.
+			Boxx::UByte* StackRegion() const {
+				return base + stackStart;
+			}
+
+			/// The byte size of the stack region.
+			Boxx::UInt StackSize() const {
+				return size - stackStart;
+			}
+
+			/// Allocates cleared memory in the static region.
+			///
+			/// Static memory is 8 byte aligned and is only released by {Reset}.
+			Boxx::UByte* AllocStatic(Boxx::UInt size);
+
+			/// Clears the whole image and releases its physical memory.
+			///
+			/// All heaps and stacks that use the image have to be recreated.
+			void Reset();
+
+			/// Converts an address in the image to a pointer.
+			Boxx::ULong ToPointer(const Boxx::UByte* ptr) const {
+				return ptr ? (Boxx::ULong)(ptr - base) : 0;
+			}
+
+			/// Converts a pointer to an address in the image.
+			///
+			/// Throws if {size} bytes at the pointer are not in the image.
+			Boxx::UByte* FromPointer(Boxx::ULong pointer, Boxx::UInt size) const;
+
+			/// {true} if {size} bytes at the pointer are in the image.
+			///
+			/// Pointers in the unused first page wrap around so one compare checks both bounds.
+			bool InBounds(Boxx::ULong pointer, Boxx::UInt size) const {
+				return size <= span && pointer - Memory::alignment <= span - size;
+			}
+
+		private:
+			Boxx::UByte* base;
+			Boxx::UInt size, span;
+			Boxx::UInt heapStart, stackStart;
+			Boxx::UInt staticTop;
+		};
+	}
+}
@@ -0,0 +1,196 @@
+#include "Profiler.h"
+
+#include "../Boxx/Boxx/StringBuilder.h"
+#include "../Boxx/Boxx/Console.h"
+#include "../Boxx/Boxx/File.h"
+
+using namespace Boxx;
+
+using namespace Kiwi;
+using namespace Kiwi::Interpreter;
+
+UInt HeapProfiler::AddSite(const AllocationSite& site) {
+	String key = site.function + ":" + String::ToString(site.index) + ":" + site.instruction;
+	UInt id;
+
+	if (siteIds.Contains(key, id)) {
+		return id;
+	}
+
+	SiteStats stats;
+	stats.site = site;
+
+	id = sites.Count();
+	sites.Add(stats);
+	siteIds.Add(key, id);
+	return id;
+}
+
+void HeapProfiler::Alloc(UByte* ptr, UInt size, UInt site) {
+	SiteStats& stats = sites[site];
+	stats.count++;
+	stats.bytes += size;
+	stats.liveCount++;
+	stats.liveBytes += size;
+	stats.histogram[Bucket(size)]++;
+
+	count++;
+	bytes     += size;
+	liveBytes += size;
+
+	if (liveBytes > peakBytes) {
+		peakBytes = liveBytes;
+	}
+
+	Block block;
+	block.size = size;
+	block.site = site;
+	live.Set(ptr, block);
+}
+
+void HeapProfiler::Free(UByte* ptr) {
+	Block block;
+
+	if (!live.Contains(ptr, block)) return;
+
+	SiteStats& stats = sites[block.site];
+	stats.liveCount--;
+	stats.liveBytes -= block.size;
+
+	frees++;
+	liveBytes -= block.size;
+
+	live.Remove(ptr);
+}
+
+String HeapProfiler::ToText() const {
+	StringBuilder builder;
+	builder += "heap profile\n";
+	builder += "  allocations: " + String::ToString(count) + " (" + String::ToString(bytes) + " bytes)\n";
+	builder += "  frees: " + String::ToString(frees) + "\n";
+	builder += "  peak live bytes: " + String::ToString(peakBytes) + "\n";
+	builder += "  never freed: " + String::ToString(live.Count()) + " blocks (" + String::ToString(liveBytes) + " bytes)\n";
+
+	for (const SiteStats& stats : sites) {
+		builder += "\n";
+		builder += SiteName(stats.site) + "\n";
+		builder += "  allocations: " + String::ToString(stats.count) + " (" + String::ToString(stats.bytes) + " bytes)\n";
+		builder += "  never freed: " + String::ToString(stats.liveCount) + " blocks (" + String::ToString(stats.liveBytes) + " bytes)\n";
+		builder += "  sizes:";
+
+		for (UInt i = 0; i < histogramSize; i++) {
+			if (stats.histogram[i] == 0) continue;
+			builder += " " + BucketName(i) + ": " + String::ToString(stats.histogram[i]);
+		}
+
+		builder += "\n";
+	}
+
+	return builder.ToString();
+}
+
+String HeapProfiler::ToJson() const {
+	StringBuilder builder;
+	builder += "{\n";
+	builder += "  \"allocations\": " + String::ToString(count) + ",\n";
+	builder += "  \"bytes\": " + String::ToString(bytes) + ",\n";
+	builder += "  \"frees\": " + String::ToString(frees) + ",\n";
+	builder += "  \"peakLiveBytes\": " + String::ToString(peakBytes) + ",\n";
+	builder += "  \"neverFreed\": {\"blocks\": " + String::ToString(live.Count()) + ", \"bytes\": " + String::ToString(liveBytes) + "},\n";
+	builder += "  \"sites\": [";
+
+	for (UInt i = 0; i < sites.Count(); i++) {
+		const SiteStats& stats = sites[i];
+
+		builder += i == 0 ? "\n" : ",\n";
+		builder += "    {\n";
+		builder += "      \"function\": \"" + Escape(stats.site.function) + "\",\n";
+		builder += "      \"index\": " + String::ToString(stats.site.index) + ",\n";
+		builder += "      \"instruction\": \"" + Escape(stats.site.instruction) + "\",\n";
+		builder += "      \"allocations\": " + String::ToString(stats.count) + ",\n";
+		builder += "      \"bytes\": " + String::ToString(stats.bytes) + ",\n";
+		builder += "      \"neverFreed\": {\"blocks\": " + String::ToString(stats.liveCount) + ", \"bytes\": " + String::ToString(stats.liveBytes) + "},\n";
+		builder += "      \"sizes\": {";
+
+		bool first = true;
+
+		for (UInt u = 0; u < histogramSize; u++) {
+			if (stats.histogram[u] == 0) continue;
+
+			builder += first ? "" : ", ";
+			builder += "\"" + BucketName(u) + "\": " + String::ToString(stats.histogram[u]);
+			first = false;
+		}
+
+		builder += "}\n";
+		builder += "    }";
+	}
+
+	builder += sites.IsEmpty() ? "]\n" : "\n  ]\n";
+	builder += "}\n";
+	return builder.ToString();
+}
+
+void HeapProfiler::Report() const {
+	Console::Print(ToText());
+
+	if (!jsonFile.IsEmpty()) {
+		FileWriter file = FileWriter(jsonFile);
+		file.Write(ToJson());
+		file.Close();
+	}
+}
+
+UInt HeapProfiler::Bucket(UInt size) {
+	UInt bucket = 0;
+
+	for (UInt max = 8; bucket + 1 < histogramSize && size > max; max *= 2) {
+		bucket++;
+	}
+
+	return bucket;
+}
+
+String HeapProfiler::BucketName(UInt bucket) {
+	if (bucket + 1 == histogramSize) {
+		return ">" + String::ToString(8u << (bucket - 1));
+	}
+
+	return "<=" + String::ToString(8u << bucket);
+}
+
+String HeapProfiler::SiteName(const AllocationSite& site) {
+	String function = site.function.IsEmpty() ? String("<code>") : site.function;
+	return function + ":" + String::ToString(site.index) + " " + site.instruction;
+}
+
+String HeapProfiler::Escape(const String& str) {
+	StringBuilder builder;
+
+	for (UInt i = 0; i < str.Length(); i++) {
+		char c = str[i];
+
+		if (c == '"' || c == '\\') {
+			builder += '\\';
+			builder += c;
+		}
+		else if (c == '\n') {
+			builder += "\\n";
+		}
+		else if (c == '\t') {
+			builder += "\\t";
+		}
+		else if ((UByte)c < 0x20) {
+			// Other control characters are not allowed raw in JSON strings
+			static const char* const hex = "0123456789abcdef";
+			builder += "\\u00";
+			builder += hex[(UByte)c >> 4];
+			builder += hex[(UByte)c & 0xF];
+		}
+		else {
+			builder += c;
+		}
+	}
+
+	return builder.ToString();
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "../Boxx/Boxx/String.h"
+#include "../Boxx/Boxx/List.h"
+#include "../Boxx/Boxx/Map.h"
+
+///N Kiwi::Interpreter
+
+namespace Kiwi {
+	namespace Interpreter {
+		/// A place in a program that allocates heap memory.
+		struct AllocationSite {
+			/// The name of the function.
+			///
+			/// Empty for code blocks.
+			Boxx::String function;
+
+			/// The index of the instruction in the function or code block.
+			Boxx::UInt index = 0;
+
+			/// The instruction.
+			Boxx::String instruction;
+		};
+
+		/// Records heap allocations by allocation site.
+		///
+		/// The profiler is only used if it is set in the interpreter data.
+		class HeapProfiler {
+		public:
+			/// The number of buckets in the allocation size histograms.
+			///
+			/// The buckets hold sizes up to 8, 16, 32 and so on up to 4096 bytes.
+			/// The last bucket holds all larger sizes.
+			static constexpr Boxx::UInt histogramSize = 11;
+
+			/// The file the JSON report is written to by {Report}.
+			///
+			/// No file is written if this is empty.
+			Boxx::String jsonFile;
+
+			/// Adds an allocation site.
+			///
+			/// Identical sites get the same id.
+			///R id: The id of the site.
+			Boxx::UInt AddSite(const AllocationSite& site);
+
+			/// Records an allocation.
+			void Alloc(Boxx::UByte* ptr, Boxx::UInt size, Boxx::UInt site);
+
+			/// Records that memory was freed.
+			void Free(Boxx::UByte* ptr);
+
+			/// The peak amount of allocated bytes.
+			Boxx::ULong PeakBytes() const {
+				return peakBytes;
+			}
+
+			/// Creates a text report.
+			Boxx::String ToText() const;
+
+			/// Creates a JSON report.
+			Boxx::String ToJson() const;
+
+			/// Prints the text report and writes the JSON report to {jsonFile}.
+			void Report() const;
+
+		private:
+			struct SiteStats {
+				AllocationSite site;
+
+				Boxx::ULong count = 0, bytes = 0;
+				Boxx::ULong liveCount = 0, liveBytes = 0;
+				Boxx::ULong histogram[histogramSize] = {};
+			};
+
+			struct Block {
+				Boxx::UInt size;
+				Boxx::UInt site;
+			};
+
+			Boxx::List<SiteStats> sites;
+			Boxx::Map<Boxx::String, Boxx::UInt> siteIds;
+			Boxx::Map<Boxx::UByte*, Block> live;
+
+			Boxx::ULong count = 0, bytes = 0, frees = 0;
+			Boxx::ULong liveBytes = 0, peakBytes = 0;
+
+			static Boxx::UInt Bucket(Boxx::UInt size);
+			static Boxx::String BucketName(Boxx::UInt bucket);
+			static Boxx::String SiteName(const AllocationSite& site);
+			static Boxx::String Escape(const Boxx::String& str);
+		};
+	}
+}
@@ -0,0 +1,528 @@
+#include "VM.h"
+#include "Kernels.h"
+#include "BulkMemory.h"
+
+#include "../KiwiProgram.h"
+
+#include "../Boxx/Boxx/Console.h"
+
+using namespace Boxx;
+
+using namespace Kiwi;
+using namespace Kiwi::Interpreter;
+
+VM::VM(InterpreterData& data, Weak<CompiledProgram> program) : data(data) {
+	this->program  = program;
+	this->dispatch = data.dispatch;
+	this->image    = data.image ? *data.image : nullptr;
+	this->profiler = data.profiler ? *data.profiler : nullptr;
+	this->ptrSize  = program->ptrSize;
+
+	staticData = Array<ULong>(program->staticData.Count());
+
+	for (UInt i = 0; i < program->staticData.Count(); i++) {
+		staticData[i] = ToPointer(data.staticData[program->staticData[i]]);
+	}
+
+	strings = Array<ULong>(program->strings.Count());
+
+	for (UInt i = 0; i < program->strings.Count(); i++) {
+		strings[i] = ToPointer(data.strings->Get(program->strings[i]));
+	}
+
+	if (profiler) {
+		sites = Array<UInt>(program->sites.Count());
+
+		for (UInt i = 0; i < program->sites.Count(); i++) {
+			sites[i] = profiler->AddSite(program->sites[i]);
+		}
+	}
+}
+
+void VM::Run(Weak<CompiledFunction> entry) {
+#ifdef KIWI_THREADED_DISPATCH
+	if (dispatch == Dispatch::Threaded) {
+		Execute<true>(*entry);
+		return;
+	}
+#endif
+
+	Execute<false>(*entry);
+}
+
+#define R(reg) (fp + (reg))
+
+#ifdef KIWI_THREADED_DISPATCH
+	#define NEXT \
+		if constexpr (threaded) { \
+			op = &function->ops[pc]; \
+			goto *function->handlers[pc++]; \
+		} \
+		else break;
+#else
+	#define NEXT break;
+#endif
+
+#ifdef KIWI_THREADED_DISPATCH
+	// The labels are only jumped to by the threaded instantiation
+	#define LABEL(label) label: __attribute__((unused));
+#else
+	#define LABEL(label)
+#endif
+
+#define OP(name) case (UByte)OpCode::name: LABEL(L_##name)
+
+#define UNARY_OP(T, type, suffix, name) \
+	case (UByte)IntOpCode(IntOp::name, type): LABEL(L_##name##suffix) \
+		Data::Set<T>(R(op->a), IntKernels<T>::name(Data::Get<T>(R(op->b)))); \
+		NEXT
+
+#define BINARY_OP(T, type, suffix, name) \
+	case (UByte)IntOpCode(IntOp::name, type): LABEL(L_##name##suffix) \
+		Data::Set<T>(R(op->a), IntKernels<T>::name(Data::Get<T>(R(op->b)), Data::Get<T>(R(op->c)))); \
+		NEXT
+
+#define INT_OPS(X, Y, T, type, suffix) \
+	X(T, type, suffix, Neg) X(T, type, suffix, Not) \
+	Y(T, type, suffix, Add) Y(T, type, suffix, Sub) Y(T, type, suffix, Mul) Y(T, type, suffix, Div) Y(T, type, suffix, Mod) \
+	Y(T, type, suffix, Or)  Y(T, type, suffix, And) Y(T, type, suffix, Xor) Y(T, type, suffix, Shl) Y(T, type, suffix, Shr) \
+	Y(T, type, suffix, Eq)  Y(T, type, suffix, Ne)  Y(T, type, suffix, Lt)  Y(T, type, suffix, Gt)  Y(T, type, suffix, Le) Y(T, type, suffix, Ge)
+
+#define INT_TYPES(X, Y) \
+	INT_OPS(X, Y, Boxx::Byte,   TypeId::i8,  I8)  \
+	INT_OPS(X, Y, Boxx::UByte,  TypeId::u8,  U8)  \
+	INT_OPS(X, Y, Boxx::Short,  TypeId::i16, I16) \
+	INT_OPS(X, Y, Boxx::UShort, TypeId::u16, U16) \
+	INT_OPS(X, Y, Boxx::Int,    TypeId::i32, I32) \
+	INT_OPS(X, Y, Boxx::UInt,   TypeId::u32, U32) \
+	INT_OPS(X, Y, Boxx::Long,   TypeId::i64, I64) \
+	INT_OPS(X, Y, Boxx::ULong,  TypeId::u64, U64)
+
+#define OPS(X) \
+	X(Nop) X(Mov) X(Clear) X(Const) X(Lea) X(Static) X(PtrAdd) X(Index) X(Load) X(Store) X(Conv) \
+	X(Jmp) X(JmpIf) X(Call) X(CallPtr) X(Ret) X(Alloc) X(AllocVar) X(Free) X(StackAlloc) X(StackAllocVar) X(Region) X(RegionAlloc) X(RegionAllocVar) X(Destroy) X(Copy) X(Fill) X(Move) X(Compare) X(Str) X(Print)
+
+#define OP_LABEL(name) handlers.table[(UInt)OpCode::name] = &&L_##name;
+#define INT_LABEL(T, type, suffix, name) handlers.table[(UInt)IntOpCode(IntOp::name, type)] = &&L_##name##suffix;
+
+template <bool threaded>
+void VM::Execute(CompiledFunction* entry) {
+#ifdef KIWI_THREADED_DISPATCH
+	if constexpr (threaded) {
+		struct HandlerTable {
+			const void* table[256];
+		};
+
+		// Filled once by the first VM even if several VMs start at the same time
+		static const HandlerTable handlerTable = ({
+			HandlerTable handlers;
+
+			for (UInt i = 0; i < 256; i++) {
+				handlers.table[i] = &&L_Invalid;
+			}
+
+			INT_TYPES(INT_LABEL, INT_LABEL)
+			OPS(OP_LABEL)
+
+			handlers;
+		});
+
+		auto prepare = [](CompiledFunction* function) {
+			if (function->handlers.Length() == function->ops.Length()) return;
+
+			function->handlers = Array<const void*>(function->ops.Length());
+
+			for (UInt i = 0; i < function->ops.Length(); i++) {
+				function->handlers[i] = handlerTable.table[(UInt)function->ops[i].code];
+			}
+		};
+
+		prepare(entry);
+
+		for (Weak<CompiledFunction> function : program->functions) {
+			prepare(*function);
+		}
+	}
+#endif
+
+	Stack<CallFrame> calls;
+
+	CallStack* stack = *data.stack;
+
+	CompiledFunction* function = entry;
+	UInt entryFp = stack->Push(function->frameSize);
+	DataPtr fp = stack->Ptr(stack->fp);
+	UInt pc = 0;
+
+	const Op* op = nullptr;
+
+#ifdef KIWI_THREADED_DISPATCH
+	if constexpr (threaded) {
+		op = &function->ops[pc];
+		goto *function->handlers[pc++];
+	}
+#endif
+
+	while (true) {
+		op = &function->ops[pc++];
+
+		// Int op codes are past the named op codes so the switch is on the raw value
+		switch ((UByte)op->code) {
+			OP(Nop) NEXT
+
+			OP(Mov) {
+				std::memcpy(R(op->a), R(op->b), op->size);
+			}
+
+			NEXT
+
+			OP(Clear) {
+				std::memset(R(op->a), 0, op->size);
+			}
+
+			NEXT
+
+			OP(Const) {
+				SetNumber(R(op->a), op->size, op->imm);
+			}
+
+			NEXT
+
+			OP(Lea) {
+				SetPointer(R(op->a), ToPointer(R(op->b) + op->imm));
+			}
+
+			NEXT
+
+			OP(Static) {
+				SetPointer(R(op->a), staticData[op->b]);
+			}
+
+			NEXT
+
+			OP(PtrAdd) {
+				SetPointer(R(op->a), GetPointer(R(op->b)) + op->imm);
+			}
+
+			NEXT
+
+			OP(Index) {
+				SetPointer(R(op->a), GetPointer(R(op->b)) + GetNumber(R(op->c), op->size) * op->imm);
+			}
+
+			NEXT
+
+			OP(Load) {
+				std::memcpy(R(op->a), ToHost(GetPointer(R(op->b)) + op->imm, op->size), op->size);
+			}
+
+			NEXT
+
+			OP(Store) {
+				std::memcpy(ToHost(GetPointer(R(op->a)) + op->imm, op->size), R(op->b), op->size);
+			}
+
+			NEXT
+
+			OP(Conv) {
+				SetNumber(R(op->a), op->size, ReadInt(R(op->b), op->c));
+			}
+
+			NEXT
+
+			INT_TYPES(UNARY_OP, BINARY_OP)
+
+			default: LABEL(L_Invalid) {
+				throw KiwiInterpretError("invalid op code");
+			}
+
+			OP(Jmp) {
+				pc = op->a;
+			}
+
+			NEXT
+
+			OP(JmpIf) {
+				pc = GetNumber(R(op->a), op->size) != 0 ? op->b : op->c;
+			}
+
+			NEXT
+
+			OP(Call)
+			OP(CallPtr) {
+				UInt id = op->code == OpCode::Call ? op->a : (UInt)GetNumber(R(op->a), op->size);
+
+				if (id >= program->functions.Count()) {
+					throw KiwiInterpretError("invalid function id");
+				}
+
+				CompiledFunction* callee = *program->functions[id];
+
+				if (callee->ops.Length() == 0) {
+					throw KiwiInterpretError("function '" + Name::ToKiwi(callee->name) + "' is not compiled");
+				}
+
+				if (op->c != callee->arguments) {
+					throw KiwiInterpretError("wrong number of arguments for function '" + Name::ToKiwi(callee->name) + "'");
+				}
+
+				CallFrame caller;
+				caller.function = function;
+				caller.pc       = pc;
+				caller.fp       = stack->Push(callee->frameSize);
+				calls.Push(caller);
+
+				DataPtr calleeFp = stack->Ptr(stack->fp);
+
+				for (UInt i = 0; i < op->c; i++) {
+					const Slot& param = callee->parameters[i];
+					Move(calleeFp + param.offset, param.size, R(function->operands[op->b + i * 2]), function->operands[op->b + i * 2 + 1]);
+				}
+
+				function = callee;
+				fp = calleeFp;
+				pc = 0;
+			}
+
+			NEXT
+
+			OP(Ret) {
+				if (calls.IsEmpty()) {
+					stack->Pop(entryFp);
+					return;
+				}
+
+				CallFrame caller = calls.Pop();
+				const Op& call = caller.function->ops[caller.pc - 1];
+
+				DataPtr callerFp = stack->Ptr(caller.fp);
+
+				for (UInt i = 0; i < (UInt)call.imm; i++) {
+					UInt operand = call.b + (call.c + i) * 2;
+					DataPtr dst  = callerFp + caller.function->operands[operand];
+					UInt dstSize = caller.function->operands[operand + 1];
+
+					if (i < function->returnValues) {
+						const Slot& src = function->parameters[function->arguments + i];
+						Move(dst, dstSize, fp + src.offset, src.size);
+					}
+					else {
+						std::memset(dst, 0, dstSize);
+					}
+				}
+
+				stack->Pop(caller.fp);
+
+				function = caller.function;
+				fp = callerFp;
+				pc = caller.pc;
+			}
+
+			NEXT
+
+			OP(Alloc) {
+				DataPtr ptr = data.heap->Alloc((UInt)op->imm);
+
+				if (profiler) {
+					profiler->Alloc(ptr, (UInt)op->imm, sites[op->c]);
+				}
+
+				SetPointer(R(op->a), ToPointer(ptr));
+			}
+
+			NEXT
+
+			OP(AllocVar) {
+				UInt size   = (UInt)GetNumber(R(op->b), op->size);
+				DataPtr ptr = data.heap->Alloc(size);
+
+				if (profiler) {
+					profiler->Alloc(ptr, size, sites[op->c]);
+				}
+
+				SetPointer(R(op->a), ToPointer(ptr));
+			}
+
+			NEXT
+
+			OP(Free) {
+				DataPtr ptr = ToHost(GetPointer(R(op->a)), 0);
+				data.heap->Free(ptr);
+
+				if (profiler) {
+					profiler->Free(ptr);
+				}
+			}
+
+			NEXT
+
+			OP(StackAlloc) {
+				SetPointer(R(op->a), ToPointer(stack->Alloc((UInt)op->imm)));
+			}
+
+			NEXT
+
+			OP(StackAllocVar) {
+				SetPointer(R(op->a), ToPointer(stack->Alloc((UInt)GetNumber(R(op->b), op->size))));
+			}
+
+			NEXT
+
+			OP(Region) {
+				SetPointer(R(op->a), ToPointer(data.heap->CreateRegion()));
+			}
+
+			NEXT
+
+			OP(RegionAlloc) {
+				DataPtr region = ToHost(GetPointer(R(op->b)), 0);
+				SetPointer(R(op->a), ToPointer(data.heap->RegionAlloc(region, (UInt)op->imm)));
+			}
+
+			NEXT
+
+			OP(RegionAllocVar) {
+				DataPtr region = ToHost(GetPointer(R(op->b)), 0);
+				SetPointer(R(op->a), ToPointer(data.heap->RegionAlloc(region, (UInt)GetNumber(R(op->c), op->size))));
+			}
+
+			NEXT
+
+			OP(Destroy) {
+				data.heap->DestroyRegion(ToHost(GetPointer(R(op->a)), 0));
+			}
+
+			NEXT
+
+			OP(Copy) {
+				UInt size = (UInt)GetNumber(R(op->c), op->size);
+				BulkMemory::Copy(ToHost(GetPointer(R(op->a)), size), ToHost(GetPointer(R(op->b)), size), size);
+			}
+
+			NEXT
+
+			OP(Fill) {
+				UInt size = (UInt)GetNumber(R(op->c), op->size);
+				BulkMemory::Fill(ToHost(GetPointer(R(op->a)), size), Data::Get<UByte>(R(op->b)), size);
+			}
+
+			NEXT
+
+			OP(Move) {
+				UInt size = (UInt)GetNumber(R(op->c), op->size);
+				BulkMemory::Move(ToHost(GetPointer(R(op->a)), size), ToHost(GetPointer(R(op->b)), size), size);
+			}
+
+			NEXT
+
+			OP(Compare) {
+				UInt size = (UInt)GetNumber(R((UInt)op->imm), op->size);
+				Data::Set<Boxx::Int>(R(op->a), BulkMemory::Compare(ToHost(GetPointer(R(op->b)), size), ToHost(GetPointer(R(op->c)), size), size));
+			}
+
+			NEXT
+
+			OP(Str) {
+				SetPointer(R(op->a), strings[op->b]);
+			}
+
+			NEXT
+
+			OP(Print) {
+				Print(R(op->a), op->size, (PrintMode)op->b, op->c != 0);
+			}
+
+			NEXT
+		}
+	}
+}
+
+#undef R
+#undef NEXT
+#undef OP
+#undef UNARY_OP
+#undef BINARY_OP
+#undef INT_OPS
+#undef INT_TYPES
+#undef OPS
+#undef OP_LABEL
+#undef INT_LABEL
+
+void VM::Move(DataPtr dst, UInt dstSize, DataPtr src, UInt srcSize) {
+	std::memcpy(dst, src, Math::Min(dstSize, srcSize));
+
+	if (dstSize > srcSize) {
+		std::memset(dst + srcSize, 0, dstSize - srcSize);
+	}
+}
+
+Long VM::GetNumber(DataPtr ptr, UInt size) {
+	switch (size) {
+		case 1:  return Data::Get<Boxx::Byte>(ptr);
+		case 2:  return Data::Get<Boxx::Short>(ptr);
+		case 4:  return Data::Get<Boxx::Int>(ptr);
+		default: return Data::Get<Boxx::Long>(ptr);
+	}
+}
+
+void VM::SetNumber(DataPtr ptr, UInt size, Long num) {
+	switch (size) {
+		case 1:  Data::Set<Boxx::Byte>(ptr, (Boxx::Byte)num);   break;
+		case 2:  Data::Set<Boxx::Short>(ptr, (Boxx::Short)num); break;
+		case 4:  Data::Set<Boxx::Int>(ptr, (Boxx::Int)num);     break;
+		default: Data::Set<Boxx::Long>(ptr, num);               break;
+	}
+}
+
+void VM::Print(DataPtr ptr, UInt size, PrintMode mode, bool pointer) {
+	if (mode == PrintMode::Str) {
+		DataPtr str = ToHost(GetPointer(ptr), 1);
+
+		if (data.heap->IsAllocated(str)) {
+			UInt strSize = data.heap->GetSize(str);
+
+			char* cstr = new char[strSize + 1];
+			std::memcpy(cstr, str, strSize);
+			cstr[strSize] = '\0';
+
+			Console::Print(cstr);
+
+			delete[] cstr;
+		}
+		else {
+			Console::Print(str);
+		}
+
+		return;
+	}
+	else if (mode == PrintMode::Chr) {
+		Console::Print(Data::Get<char>(ptr));
+		return;
+	}
+
+	if (pointer) {
+		ULong value = GetPointer(ptr);
+
+		if (image && !image->InBounds(value, 0)) {
+			value = 0;
+		}
+
+		if (value && data.heap->IsAllocated(ToHost(value, 0))) {
+			Console::Write('*');
+			ptr  = ToHost(value, 0);
+			size = data.heap->GetSize(ptr);
+		}
+		else if (UInt length = value ? data.strings->GetSize(ToHost(value, 0)) : 0) {
+			Console::Write('*');
+			ptr  = ToHost(value, 0);
+			size = length;
+		}
+	}
+
+	for (UInt i = 0; i < size; i++) {
+		Console::Write((UInt)ptr[i]);
+		Console::Write(' ');
+	}
+
+	Console::Print();
+}
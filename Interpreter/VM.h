@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../Ptr.h"
+
+#include "../Boxx/Boxx/Array.h"
+#include "../Boxx/Boxx/Stack.h"
+
+#include "Interpreter.h"
+#include "Bytecode.h"
+
+///N Kiwi::Interpreter
+
+namespace Kiwi {
+	namespace Interpreter {
+		/// Executes compiled bytecode.
+		class VM {
+		public:
+			/// The dispatch used by {Run}.
+			///
+			/// Defaults to the dispatch of the interpreter data.
+			Dispatch dispatch;
+
+			VM(InterpreterData& data, Weak<CompiledProgram> program);
+
+			/// Runs a compiled function that has no arguments.
+			void Run(Weak<CompiledFunction> function);
+
+		private:
+			struct CallFrame {
+				CompiledFunction* function;
+				Boxx::UInt pc;
+				Boxx::UInt fp;
+			};
+
+			InterpreterData& data;
+			Weak<CompiledProgram> program;
+
+			MemoryImage* image;
+			HeapProfiler* profiler;
+			Boxx::UInt ptrSize;
+			Boxx::Array<Boxx::UInt> sites;
+			Boxx::Array<Boxx::ULong> staticData;
+			Boxx::Array<Boxx::ULong> strings;
+
+			template <bool threaded>
+			void Execute(CompiledFunction* entry);
+
+			static void Move(DataPtr dst, Boxx::UInt dstSize, DataPtr src, Boxx::UInt srcSize);
+
+			static Boxx::Long GetNumber(DataPtr ptr, Boxx::UInt size);
+			static void SetNumber(DataPtr ptr, Boxx::UInt size, Boxx::Long num);
+
+			void Print(DataPtr ptr, Boxx::UInt size, PrintMode mode, bool pointer);
+
+			/// Gets the pointer value in a register.
+			Boxx::ULong GetPointer(DataPtr reg) const {
+				return ptrSize == 4 ? Data::Get<Boxx::UInt>(reg) : Data::Get<Boxx::ULong>(reg);
+			}
+
+			/// Sets the pointer value in a register.
+			void SetPointer(DataPtr reg, Boxx::ULong pointer) const {
+				if (ptrSize == 4) {
+					Data::Set<Boxx::UInt>(reg, (Boxx::UInt)pointer);
+				}
+				else {
+					Data::Set<Boxx::ULong>(reg, pointer);
+				}
+			}
+
+			/// Converts a host address to a pointer value.
+			Boxx::ULong ToPointer(DataPtr ptr) const {
+				return image ? image->ToPointer(ptr) : (Boxx::ULong)ptr;
+			}
+
+			/// Converts a pointer value to a host address.
+			///
+			/// Throws if an image is used and {size} bytes at the pointer are outside of it.
+			DataPtr ToHost(Boxx::ULong pointer, Boxx::UInt size) const {
+				if (!image) return (DataPtr)pointer;
+
+				if (!image->InBounds(pointer, size)) {
+					throw KiwiInterpretError("memory access out of bounds");
+				}
+
+				return image->Base() + pointer;
+			}
+		};
+	}
+}
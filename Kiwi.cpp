@@ -4,6 +4,8 @@
 #include "Old/x86_64Tester.h"
 
 #include "KiwiProgram.h"
+#include "ParserTester.h"
+#include "Interpreter/Benchmark.h"
 
 #include "Boxx/Boxx/String.h"
 #include "Boxx/Boxx/StringBuilder.h"
@@ -17,7 +19,18 @@ using namespace Boxx;
 
 using namespace Kiwi;
 
-int main() {
+int main(int argc, char** argv) {
+	// Compares the bytecode dispatch modes
+	if (argc > 1 && String(argv[1]) == "--benchmark") {
+		Interpreter::Benchmark::Run();
+		return 0;
+	}
+
+	// Compares parallel and serial parsing
+	if (argc > 1 && String(argv[1]) == "--test") {
+		return ParserTester::Run() ? 0 : 1;
+	}
+
 	Ptr<KiwiProgram> program = new KiwiProgram();
 
 	Ptr<InstructionBlock> block = new InstructionBlock();
@@ -42,12 +55,11 @@ int main() {
 
 	program->AddFunction(func);
 
-	StringBuilder builder;
-	program->BuildString(builder);
-
-	FileWriter writer = FileWriter("Local/temp.kiwi");
-	writer.Write(builder.ToString());
-	writer.Close();
+	{
+		StreamWriter writer = StreamWriter("Local/temp.kiwi");
+		program->BuildString(writer);
+		writer.Close();
+	}
 
 	Interpreter::InterpreterData data;
 	data.program = program;
@@ -1,5 +1,7 @@
 #include "KiwiProgram.h"
 
+#include "Interpreter/VM.h"
+
 using namespace Boxx;
 
 using namespace Kiwi;
@@ -9,7 +11,25 @@ void KiwiProgram::AddCodeBlock(Ptr<CodeBlock> block) {
 }
 
 void KiwiProgram::AddStruct(Ptr<Struct> struct_) {
-	structs.Set(struct_->name, struct_);
+	Weak<Struct> s = struct_;
+	UInt id = Type::Intern(s->name);
+
+	if (Weak<Struct> old = types.GetStruct(id)) {
+		old->InvalidateLayout();
+	}
+	else {
+		for (const Pair<String, Ptr<Struct>>& other : structs) {
+			for (const Tuple<Type, String>& var : other.value->vars) {
+				if (var.value1.id == id && var.value1.pointers == 0) {
+					other.value->InvalidateLayout();
+					break;
+				}
+			}
+		}
+	}
+
+	structs.Set(s->name, struct_);
+	types.SetStruct(id, s);
 }
 
 void KiwiProgram::AddStatic(Ptr<StaticData> data) {
@@ -20,7 +40,62 @@ void KiwiProgram::AddFunction(Ptr<Function> function) {
 	functions.Add(function->name, function);
 }
 
+void KiwiProgram::SetPointerSize(UInt size) {
+	if (size != 4 && size != 8) {
+		throw Interpreter::KiwiInterpretError("invalid pointer size " + String::ToString(size));
+	}
+
+	ptrSize = size;
+
+	for (const Pair<String, Ptr<Struct>>& s : structs) {
+		s.value->InvalidateLayout();
+	}
+}
+
+void KiwiProgram::LoadFunction(Weak<Function> function) {
+	if (function->loaded) return;
+
+	if (!loader) {
+		throw Interpreter::KiwiInterpretError("function '" + Name::ToKiwi(function->name) + "' has no body");
+	}
+
+	try {
+		loader->LoadFunction(function);
+	}
+	catch (...) {
+		// Instructions read before the error are dropped so the function is not left half loaded
+		function->block = New<CodeBlock>(arena);
+		throw;
+	}
+
+	function->loaded = true;
+}
+
+void KiwiProgram::LoadFunctions() {
+	for (const Pair<String, Ptr<Function>>& f : functions) {
+		LoadFunction(f.value);
+	}
+}
+
+void KiwiProgram::ResolveLabels() {
+	for (Weak<CodeBlock> block : blocks) {
+		block->ResolveLabels();
+	}
+
+	for (const Pair<String, Ptr<Function>>& f : functions) {
+		if (f.value->loaded) {
+			f.value->block->ResolveLabels();
+		}
+	}
+}
+
 void KiwiProgram::Interpret(Interpreter::InterpreterData& data) {
+	if (ptrSize < 8 && !data.image) {
+		throw Interpreter::KiwiInterpretError("4 byte pointers require a memory image");
+	}
+
+	ResolveLabels();
+
 	for (const Pair<String, Ptr<Function>>& f : functions) {
 		UInt id = data.funcIdMap.Count();
 
@@ -28,10 +103,43 @@ void KiwiProgram::Interpret(Interpreter::InterpreterData& data) {
 		data.funcNameMap.Add(id, f.key);
 	}
 
+	Interpreter::Compiler compiler = Interpreter::Compiler(data.program);
+	Ptr<Interpreter::CompiledProgram> compiled = compiler.Compile();
+
+	// Pool all string literals in one constant section
+	List<String> literals;
+
+	for (const String& literal : compiled->strings) {
+		literals.Add(literal);
+	}
+
 	for (const Pair<String, Ptr<StaticData>>& sd : staticData) {
-		Interpreter::Data d = data.heap->Alloc(sd.value->Size(data.program));
-		Interpreter::DataPtr ptr = d.Ptr();
-		
+		for (const Tuple<Type, String, Ptr<Value>>& value : sd.value->data) {
+			if (Weak<StringValue> str = dyn_cast<StringValue>(value.value3)) {
+				literals.Add(str->value);
+			}
+		}
+	}
+
+	data.strings->Add(literals);
+
+	if (data.profiler) {
+		data.heap->Profile(*data.profiler);
+	}
+
+	for (const Pair<String, Ptr<StaticData>>& sd : staticData) {
+		UInt dataSize = sd.value->Size(data.program);
+
+		Interpreter::DataPtr start = data.image ? data.image->AllocStatic(dataSize) : data.heap->Alloc(dataSize);
+		Interpreter::DataPtr ptr   = start;
+
+		if (data.profiler && !data.image) {
+			Interpreter::AllocationSite site;
+			site.function    = "static";
+			site.instruction = sd.key;
+			data.profiler->Alloc(start, dataSize, data.profiler->AddSite(site));
+		}
+
 		for (const Tuple<Type, String, Ptr<Value>>& value : sd.value->data) {
 			UInt size = Type::SizeOf(value.value1, data.program);
 
@@ -40,21 +148,40 @@ void KiwiProgram::Interpret(Interpreter::InterpreterData& data) {
 			ptr += size;
 		}
 
-		data.staticData.Add(sd.key, d);
+		data.staticData.Add(sd.key, start);
 	}
 
-	for (Weak<CodeBlock> block : blocks) {
-		data.PushFrame();
-		block->Interpret(data);
-		data.PopFrame();
+	Interpreter::VM vm = Interpreter::VM(data, compiled);
+
+	for (Weak<Interpreter::CompiledFunction> block : compiled->blocks) {
+		vm.Run(block);
 	}
 
-	for (const Pair<String, Interpreter::Data>& sd : data.staticData) {
-		data.heap->Free(sd.value);
+	if (!data.image) {
+		for (const Pair<String, Interpreter::DataPtr>& sd : data.staticData) {
+			data.heap->Free(sd.value);
+
+			if (data.profiler) {
+				data.profiler->Free(sd.value);
+			}
+		}
+	}
+
+	if (data.profiler) {
+		data.profiler->Report();
 	}
 }
 
-void KiwiProgram::BuildString(StringBuilder& builder) {
+void KiwiProgram::BuildString(TextWriter& builder) {
+	LoadFunctions();
+
+	// The default pointer size is not written
+	if (ptrSize != 8) {
+		builder += "pointer ";
+		builder += String::ToString(ptrSize);
+		builder += "\n\n";
+	}
+
 	for (const Pair<String, Ptr<StaticData>>& data : staticData) {
 		data.value->BuildString(builder);
 	}
@@ -74,57 +201,98 @@ void KiwiProgram::BuildString(StringBuilder& builder) {
 }
 
 CodeBlock::CodeBlock() {
+	kind = NodeKind::CodeBlock;
 	mainBlock = new InstructionBlock("");
 }
 
+CodeBlock::CodeBlock(PtrArena& arena) {
+	kind = NodeKind::CodeBlock;
+	mainBlock = arena.New<InstructionBlock>("");
+}
+
 void CodeBlock::AddInstructionBlock(Ptr<InstructionBlock> block) {
 	blocks.Add(block);
+	resolved = false;
 }
 
-void CodeBlock::Interpret(Interpreter::InterpreterData& data) {
-	data.gotoLabel = nullptr;
-	data.ret = false;
-	mainBlock->Interpret(data);
+void CodeBlock::ResolveLabels() {
+	labels = Map<String, UInt>();
+	blockStarts = List<UInt>();
+
+	UInt start = mainBlock->instructions.Count();
 
-	if (data.ret) {
-		data.ret = false;
-		return;
+	for (UInt i = 0; i < blocks.Count(); i++) {
+		if (labels.Contains(blocks[i]->label)) {
+			throw Interpreter::KiwiInterpretError("label '" + Name::ToKiwi(blocks[i]->label) + "' already exists");
+		}
+
+		labels.Add(blocks[i]->label, i);
+		blockStarts.Add(start);
+		start += blocks[i]->instructions.Count();
 	}
 
-	if (!data.gotoLabel && blocks.Count() > 0) {
-		data.gotoLabel = blocks[0]->label;
+	for (Weak<Instruction> instruction : mainBlock->instructions) {
+		instruction->ResolveLabels(labels);
 	}
 
-	while (data.gotoLabel) {
-		bool found = false;
+	for (Weak<InstructionBlock> block : blocks) {
+		for (Weak<Instruction> instruction : block->instructions) {
+			instruction->ResolveLabels(labels);
+		}
+	}
 
-		for (UInt i = 0; i < blocks.Count(); i++) {
-			if (blocks[i]->label == data.gotoLabel) {
-				found = true;
-				data.gotoLabel = nullptr;
-				blocks[i]->Interpret(data);
+	resolved = true;
+}
 
-				if (data.ret) {
-					data.ret = false;
-					return;
-				}
+void CodeBlock::Interpret(Interpreter::InterpreterData& data) {
+	if (!resolved) {
+		ResolveLabels();
+	}
 
-				if (!data.gotoLabel && i + 1 < blocks.Count()) {
-					data.gotoLabel = blocks[i + 1]->label;
-				}
-				else {
-					break;
-				}
-			}
+	data.gotoBlock = nullptr;
+	data.ret = false;
+
+	if (data.profiler) {
+		data.frame->instructionIndex = 0;
+	}
+
+	mainBlock->Interpret(data);
+
+	UInt i = 0;
+
+	while (!data.ret) {
+		if (data.gotoBlock) {
+			i = *data.gotoBlock;
+			data.gotoBlock = nullptr;
 		}
 
-		if (!found && data.gotoLabel) {
-			throw Interpreter::KiwiInterpretError("label '" + Name::ToKiwi(*data.gotoLabel) + "' not found");
+		if (i >= blocks.Count()) break;
+
+		if (data.profiler) {
+			data.frame->instructionIndex = blockStarts[i];
 		}
+
+		blocks[i]->Interpret(data);
+		i++;
 	}
+
+	data.ret = false;
 }
 
-void CodeBlock::BuildString(StringBuilder& builder) {
+void CodeBlock::Compile(Interpreter::Compiler& compiler) {
+	if (!resolved) {
+		ResolveLabels();
+	}
+
+	mainBlock->CompileNoLabel(compiler);
+
+	for (UInt i = 0; i < blocks.Count(); i++) {
+		compiler.AddLabel(i);
+		blocks[i]->CompileNoLabel(compiler);
+	}
+}
+
+void CodeBlock::BuildString(TextWriter& builder) {
 	mainBlock->BuildStringNoLabel(builder);
 
 	for (Weak<InstructionBlock> block : blocks) {
@@ -140,24 +308,39 @@ void InstructionBlock::AddInstruction(Ptr<Instruction> instruction) {
 
 void InstructionBlock::Interpret(Interpreter::InterpreterData& data) {
 	for (Weak<Instruction> instruction : instructions) {
-		if (data.gotoLabel) {
-			return;
+		if (data.profiler) {
+			data.frame->instruction = instruction;
+			instruction->Interpret(data);
+			data.frame->instructionIndex++;
+		}
+		else {
+			instruction->Interpret(data);
 		}
 
-		instruction->Interpret(data);
+		if (data.ret || data.gotoBlock) break;
+	}
+}
+
+void InstructionBlock::Compile(Interpreter::Compiler& compiler) {
+	CompileNoLabel(compiler);
+}
 
-		if (data.ret) break;
+void InstructionBlock::CompileNoLabel(Interpreter::Compiler& compiler) {
+	for (Weak<Instruction> instruction : instructions) {
+		compiler.BeginInstruction(instruction);
+		instruction->Compile(compiler);
+		compiler.FreeRegisters();
 	}
 }
 
-void InstructionBlock::BuildString(StringBuilder& builder) {
+void InstructionBlock::BuildString(TextWriter& builder) {
 	builder += Name::ToKiwi(label);
 	builder += ":\n";
 
 	BuildStringNoLabel(builder);
 }
 
-void InstructionBlock::BuildStringNoLabel(StringBuilder& builder) {
+void InstructionBlock::BuildStringNoLabel(TextWriter& builder) {
 	for (Weak<Instruction> instruction : instructions) {
 		builder += '\t';
 		instruction->BuildString(builder);
@@ -182,7 +365,7 @@ void Function::Interpret(Interpreter::InterpreterData& data) {
 	
 }
 
-void Function::BuildString(StringBuilder& builder) {
+void Function::BuildString(TextWriter& builder) {
 	builder += "function ";
 
 	if (returnValues.Count() > 0) {
@@ -233,6 +416,7 @@ void Struct::AddVariable(const Type& type, const String& var, bool replace) {
 		if (v.value2 == var) {
 			if (replace) {
 				v.value1 = type;
+				InvalidateLayout();
 			}
 
 			return;
@@ -240,31 +424,87 @@ void Struct::AddVariable(const Type& type, const String& var, bool replace) {
 	}
 
 	vars.Add(Tuple<>::Create(type, var));
+	InvalidateLayout();
 }
 
-UInt Struct::Size(Weak<KiwiProgram> program) {
-	UInt size = 0;
+void Struct::SetAligned(bool aligned) {
+	this->aligned = aligned;
+	InvalidateLayout();
+}
 
-	for (UInt i = 0; i < vars.Count(); i++) {
-		size += Type::SizeOf(vars[i].value1, program);
+void Struct::InvalidateLayout() {
+	if (!layoutValid) return;
+
+	layoutValid = false;
+
+	if (layoutProgram) {
+		for (UInt id : dependents) {
+			if (Weak<Struct> struct_ = layoutProgram->types.GetStruct(id)) {
+				struct_->InvalidateLayout();
+			}
+		}
 	}
 
-	return size;
+	dependents.Clear();
 }
 
-UInt Struct::VarOffset(String var, Weak<KiwiProgram> program) {
-	UInt size = 0;
+const StructLayout& Struct::Layout(Weak<KiwiProgram> program) {
+	if (layoutValid) return layout;
+
+	UInt id = Type::Intern(name);
+
+	layout = StructLayout();
+	layout.offsets = Array<UInt>(vars.Count());
+
+	UInt offset = 0;
 
 	for (UInt i = 0; i < vars.Count(); i++) {
-		if (vars[i].value2 == var) return size;
+		if (aligned) {
+			UInt alignment = Type::AlignOf(vars[i].value1, program);
+			offset = (offset + alignment - 1) / alignment * alignment;
+			layout.alignment = Math::Max(layout.alignment, alignment);
+		}
+
+		layout.offsets[i] = offset;
+		layout.indices.Set(vars[i].value2, i);
+		offset += Type::SizeOf(vars[i].value1, program);
 
-		size += Type::SizeOf(vars[i].value1, program);
+		if (vars[i].value1.pointers == 0) {
+			if (Weak<Struct> struct_ = program->types.GetStruct(vars[i].value1.id)) {
+				if (!struct_->dependents.Contains(id)) {
+					struct_->dependents.Add(id);
+				}
+			}
+		}
 	}
 
-	return size;
+	layout.size = (offset + layout.alignment - 1) / layout.alignment * layout.alignment;
+
+	layoutValid   = true;
+	layoutProgram = program;
+	return layout;
+}
+
+UInt Struct::Size(Weak<KiwiProgram> program) {
+	return Layout(program).size;
+}
+
+UInt Struct::Alignment(Weak<KiwiProgram> program) {
+	return Layout(program).alignment;
+}
+
+UInt Struct::VarOffset(const String& var, Weak<KiwiProgram> program) {
+	const StructLayout& layout = Layout(program);
+	UInt index;
+
+	if (layout.indices.Contains(var, index)) {
+		return layout.offsets[index];
+	}
+
+	return layout.size;
 }
 
-Type Struct::VarType(String var) {
+Type Struct::VarType(const String& var) {
 	for (UInt i = 0; i < vars.Count(); i++) {
 		if (vars[i].value2 == var) return vars[i].value1;
 	}
@@ -272,8 +512,8 @@ Type Struct::VarType(String var) {
 	return Type();
 }
 
-void Struct::BuildString(StringBuilder& builder) {
-	builder += "struct ";
+void Struct::BuildString(TextWriter& builder) {
+	builder += aligned ? "struct aligned " : "struct ";
 	builder += Name::ToKiwi(name);
 	builder += ":\n";
 
@@ -313,7 +553,7 @@ UInt StaticData::Size(Weak<KiwiProgram> program) {
 	return size;
 }
 
-void StaticData::BuildString(StringBuilder& builder) {
+void StaticData::BuildString(TextWriter& builder) {
 	builder += "static ";
 	builder += Name::ToKiwi(name);
 	builder += ":\n";
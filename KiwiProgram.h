@@ -4,6 +4,7 @@
 #include "Node.h"
 
 #include "Boxx/Boxx/List.h"
+#include "Boxx/Boxx/Array.h"
 #include "Boxx/Boxx/Map.h"
 #include "Boxx/Boxx/Tuple.h"
 #include "Boxx/Boxx/StringBuilder.h"
@@ -16,11 +17,30 @@ namespace Kiwi {
 	class Struct;
 	class StaticData;
 
+	/// Loads the bodies of functions when they are first used.
+	class FunctionLoader {
+	public:
+		virtual ~FunctionLoader() {}
+
+		/// Loads the body of a function.
+		virtual void LoadFunction(Weak<Function> function) = 0;
+	};
+
 	/// The root node for kiwi programs.
 	class KiwiProgram : public Node {
 	public:
-		/// The byte size for pointers.
-		static const Boxx::UInt ptrSize = 8;
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::KiwiProgram;
+		}
+
+		KiwiProgram() {
+			kind = NodeKind::KiwiProgram;
+		}
+
+		/// The arena for the nodes of the program.
+		///
+		/// Declared first so it outlives all other members.
+		PtrArena arena;
 
 		/// All code blocks.
 		Boxx::List<Ptr<CodeBlock>> blocks;
@@ -34,6 +54,21 @@ namespace Kiwi {
 		/// All functions.
 		Boxx::Map<Boxx::String, Ptr<Function>> functions;
 
+		/// The type table.
+		TypeTable types;
+
+		/// Loads the bodies of functions that are not loaded.
+		Ptr<FunctionLoader> loader;
+
+		/// Creates a node in the arena of the program.
+		///
+		/// The node is released together with the program.
+		/// Use {Weak} handles for references to it from outside the program.
+		template <class T, class... Args>
+		Ptr<T> New(Args&&... args) {
+			return arena.New<T>(std::forward<Args>(args)...);
+		}
+
 		/// Adds a code block.
 		void AddCodeBlock(Ptr<CodeBlock> block);
 
@@ -46,8 +81,34 @@ namespace Kiwi {
 		/// Adds a function.
 		void AddFunction(Ptr<Function> function);
 
+		/// Loads the body of a function if it is not loaded.
+		///
+		/// If the loader fails the function keeps an empty body and is not marked as loaded.
+		void LoadFunction(Weak<Function> function);
+
+		/// Loads the bodies of all functions that are not loaded.
+		void LoadFunctions();
+
+		/// Resolves the labels of all code blocks and loaded functions.
+		void ResolveLabels();
+
+		/// The byte size for pointers.
+		Boxx::UInt PointerSize() const {
+			return ptrSize;
+		}
+
+		/// Sets the byte size for pointers.
+		///
+		/// The size is either {8} or {4}.
+		/// 4 byte pointers are offsets from the start of a memory image.
+		/// Programs that use them can only be run in a {Interpreter::MemoryImage}.
+		void SetPointerSize(Boxx::UInt size);
+
 		virtual void Interpret(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual void BuildString(TextWriter& builder) override;
+
+	private:
+		Boxx::UInt ptrSize = 8;
 	};
 
 	class InstructionBlock;
@@ -55,24 +116,51 @@ namespace Kiwi {
 	/// A code block.
 	class CodeBlock : public Node {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::CodeBlock;
+		}
+
 		/// The main instruction block.
 		Ptr<InstructionBlock> mainBlock;
 
 		/// The instruction blocks.
 		Boxx::List<Ptr<InstructionBlock>> blocks;
 
+		/// The index of the instruction block for each label.
+		Boxx::Map<Boxx::String, Boxx::UInt> labels;
+
 		CodeBlock();
 
+		/// Creates the main instruction block in {arena}.
+		CodeBlock(PtrArena& arena);
+
 		/// Adds an instruction block.
 		void AddInstructionBlock(Ptr<InstructionBlock> subBlock);
 
+		/// Resolves all jumps in the code block to block indices.
+		///
+		/// This is done automatically before the block is first interpreted or compiled.
+		/// It has to be called again if instructions are added after that.
+		void ResolveLabels();
+
 		virtual void Interpret(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual void Compile(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
+
+	private:
+		bool resolved = false;
+
+		/// The index of the first instruction of each instruction block in the code block.
+		Boxx::List<Boxx::UInt> blockStarts;
 	};
 
 	/// A block of instructions.
 	class InstructionBlock : public Node {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::InstructionBlock;
+		}
+
 		/// The label for the sub block.
 		Boxx::String label;
 
@@ -80,6 +168,7 @@ namespace Kiwi {
 		Boxx::List<Ptr<Instruction>> instructions;
 
 		InstructionBlock(const Boxx::String& label) {
+			kind = NodeKind::InstructionBlock;
 			this->label = label;
 		}
 
@@ -87,13 +176,19 @@ namespace Kiwi {
 		void AddInstruction(Ptr<Instruction> instruction);
 
 		virtual void Interpret(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
-		void BuildStringNoLabel(Boxx::StringBuilder& builder);
+		virtual void Compile(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
+		void BuildStringNoLabel(TextWriter& builder);
+		void CompileNoLabel(Interpreter::Compiler& compiler);
 	};
 
 	/// A kiwi function.
 	class Function : public Node {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::Function;
+		}
+
 		/// The function name.
 		Boxx::String name;
 
@@ -106,7 +201,17 @@ namespace Kiwi {
 		/// The function body.
 		Ptr<CodeBlock> block = new CodeBlock();
 
+		/// {false} if the body has not been loaded by {KiwiProgram::loader} yet.
+		bool loaded = true;
+
 		Function(const Boxx::String& name) {
+			kind = NodeKind::Function;
+			this->name = name;
+		}
+
+		/// Creates the function body in {arena}.
+		Function(const Boxx::String& name, PtrArena& arena) : block(arena.New<CodeBlock>(arena)) {
+			kind = NodeKind::Function;
 			this->name = name;
 		}
 
@@ -120,40 +225,95 @@ namespace Kiwi {
 		void AddInstruction(Ptr<Instruction> instruction);
 
 		virtual void Interpret(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual void BuildString(TextWriter& builder) override;
+	};
+
+	/// The memory layout of a struct.
+	struct StructLayout {
+		/// The byte offset of each variable.
+		Boxx::Array<Boxx::UInt> offsets;
+
+		/// The index of each variable.
+		Boxx::Map<Boxx::String, Boxx::UInt> indices;
+
+		/// The byte size.
+		Boxx::UInt size = 0;
+
+		/// The byte alignment.
+		Boxx::UInt alignment = 1;
 	};
 
 	/// A kiwi struct.
 	class Struct : public Node {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::Struct;
+		}
+
 		/// The struct name.
 		Boxx::String name;
 
 		/// The struct variables.
+		/// Use {AddVariable} to modify the variables.
 		Boxx::List<Boxx::Tuple<Type, Boxx::String>> vars;
 
 		Struct(const Boxx::String& name) {
+			kind = NodeKind::Struct;
 			this->name = name;
 		}
 
 		/// Adds a variable to the struct.
 		void AddVariable(const Type& type, const Boxx::String& var, bool replace = false);
 
+		/// {true} if the variables are placed at their natural alignment.
+		/// Structs are packed by default.
+		bool IsAligned() const {
+			return aligned;
+		}
+
+		/// Sets if the variables are placed at their natural alignment.
+		void SetAligned(bool aligned);
+
+		/// Gets the memory layout of the struct.
+		///
+		/// The layout is computed once and reused until the struct, a struct it contains or the pointer size is changed.
+		const StructLayout& Layout(Weak<KiwiProgram> program);
+
 		/// The byte size of the struct.
 		Boxx::UInt Size(Weak<KiwiProgram> program);
 
+		/// The byte alignment of the struct.
+		Boxx::UInt Alignment(Weak<KiwiProgram> program);
+
 		/// The byte offset to the specified variable.
-		Boxx::UInt VarOffset(Boxx::String var, Weak<KiwiProgram> program);
+		Boxx::UInt VarOffset(const Boxx::String& var, Weak<KiwiProgram> program);
 
 		/// Gets the type of the specified variable.
-		Type VarType(Boxx::String var);
+		Type VarType(const Boxx::String& var);
 
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		/// Invalidates the layout of the struct and of the structs that contain it.
+		void InvalidateLayout();
+
+		virtual void BuildString(TextWriter& builder) override;
+
+	private:
+		bool aligned = false;
+
+		StructLayout layout;
+		bool layoutValid = false;
+		Weak<KiwiProgram> layoutProgram;
+
+		/// The type ids of the structs whose layouts contain this struct.
+		Boxx::List<Boxx::UInt> dependents;
 	};
 
 	/// Static kiwi data.
 	class StaticData : public Node {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::StaticData;
+		}
+
 		/// The data name.
 		Boxx::String name;
 
@@ -161,6 +321,7 @@ namespace Kiwi {
 		Boxx::List<Boxx::Tuple<Type, Boxx::String, Ptr<Value>>> data;
 
 		StaticData(const Boxx::String& name) {
+			kind = NodeKind::StaticData;
 			this->name = name;
 		}
 
@@ -170,6 +331,6 @@ namespace Kiwi {
 		/// The byte size of the data.
 		Boxx::UInt Size(Weak<KiwiProgram> program);
 
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual void BuildString(TextWriter& builder) override;
 	};
 }
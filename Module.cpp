@@ -0,0 +1,1152 @@
+#include "Module.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace Boxx;
+
+using namespace Kiwi;
+
+static bool ToModuleOp(NodeKind kind, ModuleOp& op) {
+	switch (kind) {
+		case NodeKind::AssignInstruction:       op = ModuleOp::AssignInstruction; return true;
+		case NodeKind::MultiAssignInstruction:  op = ModuleOp::MultiAssignInstruction; return true;
+		case NodeKind::OffsetAssignInstruction: op = ModuleOp::OffsetAssignInstruction; return true;
+		case NodeKind::CopyInstruction:         op = ModuleOp::CopyInstruction; return true;
+		case NodeKind::FillInstruction:         op = ModuleOp::FillInstruction; return true;
+		case NodeKind::MoveInstruction:         op = ModuleOp::MoveInstruction; return true;
+		case NodeKind::CallInstruction:         op = ModuleOp::CallInstruction; return true;
+		case NodeKind::ReturnInstruction:       op = ModuleOp::ReturnInstruction; return true;
+		case NodeKind::GotoInstruction:         op = ModuleOp::GotoInstruction; return true;
+		case NodeKind::IfInstruction:           op = ModuleOp::IfInstruction; return true;
+		case NodeKind::FreeInstruction:         op = ModuleOp::FreeInstruction; return true;
+		case NodeKind::DestroyInstruction:      op = ModuleOp::DestroyInstruction; return true;
+		case NodeKind::DebugPrintInstruction:   op = ModuleOp::DebugPrintInstruction; return true;
+		case NodeKind::CallExpression:          op = ModuleOp::CallExpression; return true;
+		case NodeKind::AllocExpression:         op = ModuleOp::AllocExpression; return true;
+		case NodeKind::StackAllocExpression:    op = ModuleOp::StackAllocExpression; return true;
+		case NodeKind::OffsetExpression:        op = ModuleOp::OffsetExpression; return true;
+		case NodeKind::CompareExpression:       op = ModuleOp::CompareExpression; return true;
+		case NodeKind::RegionExpression:        op = ModuleOp::RegionExpression; return true;
+		case NodeKind::NegExpression:           op = ModuleOp::NegExpression; return true;
+		case NodeKind::BitNotExpression:        op = ModuleOp::BitNotExpression; return true;
+		case NodeKind::AddExpression:           op = ModuleOp::AddExpression; return true;
+		case NodeKind::SubExpression:           op = ModuleOp::SubExpression; return true;
+		case NodeKind::MulExpression:           op = ModuleOp::MulExpression; return true;
+		case NodeKind::DivExpression:           op = ModuleOp::DivExpression; return true;
+		case NodeKind::ModExpression:           op = ModuleOp::ModExpression; return true;
+		case NodeKind::BitOrExpression:         op = ModuleOp::BitOrExpression; return true;
+		case NodeKind::BitAndExpression:        op = ModuleOp::BitAndExpression; return true;
+		case NodeKind::BitXorExpression:        op = ModuleOp::BitXorExpression; return true;
+		case NodeKind::LeftShiftExpression:     op = ModuleOp::LeftShiftExpression; return true;
+		case NodeKind::RightShiftExpression:    op = ModuleOp::RightShiftExpression; return true;
+		case NodeKind::EqualExpression:         op = ModuleOp::EqualExpression; return true;
+		case NodeKind::NotEqualExpression:      op = ModuleOp::NotEqualExpression; return true;
+		case NodeKind::LessExpression:          op = ModuleOp::LessExpression; return true;
+		case NodeKind::GreaterExpression:       op = ModuleOp::GreaterExpression; return true;
+		case NodeKind::LessEqualExpression:     op = ModuleOp::LessEqualExpression; return true;
+		case NodeKind::GreaterEqualExpression:  op = ModuleOp::GreaterEqualExpression; return true;
+		case NodeKind::Variable:                op = ModuleOp::Variable; return true;
+		case NodeKind::SubVariable:             op = ModuleOp::SubVariable; return true;
+		case NodeKind::DerefVariable:           op = ModuleOp::DerefVariable; return true;
+		case NodeKind::RefValue:                op = ModuleOp::RefValue; return true;
+		case NodeKind::Integer:                 op = ModuleOp::Integer; return true;
+		case NodeKind::StringValue:             op = ModuleOp::StringValue; return true;
+		default: return false;
+	}
+}
+
+static bool FromModuleOp(ModuleOp op, NodeKind& kind) {
+	switch (op) {
+		case ModuleOp::None:                    kind = NodeKind::Node; return true;
+		case ModuleOp::AssignInstruction:       kind = NodeKind::AssignInstruction; return true;
+		case ModuleOp::MultiAssignInstruction:  kind = NodeKind::MultiAssignInstruction; return true;
+		case ModuleOp::OffsetAssignInstruction: kind = NodeKind::OffsetAssignInstruction; return true;
+		case ModuleOp::CopyInstruction:         kind = NodeKind::CopyInstruction; return true;
+		case ModuleOp::FillInstruction:         kind = NodeKind::FillInstruction; return true;
+		case ModuleOp::MoveInstruction:         kind = NodeKind::MoveInstruction; return true;
+		case ModuleOp::CallInstruction:         kind = NodeKind::CallInstruction; return true;
+		case ModuleOp::ReturnInstruction:       kind = NodeKind::ReturnInstruction; return true;
+		case ModuleOp::GotoInstruction:         kind = NodeKind::GotoInstruction; return true;
+		case ModuleOp::IfInstruction:           kind = NodeKind::IfInstruction; return true;
+		case ModuleOp::FreeInstruction:         kind = NodeKind::FreeInstruction; return true;
+		case ModuleOp::DestroyInstruction:      kind = NodeKind::DestroyInstruction; return true;
+		case ModuleOp::DebugPrintInstruction:   kind = NodeKind::DebugPrintInstruction; return true;
+		case ModuleOp::CallExpression:          kind = NodeKind::CallExpression; return true;
+		case ModuleOp::AllocExpression:         kind = NodeKind::AllocExpression; return true;
+		case ModuleOp::StackAllocExpression:    kind = NodeKind::StackAllocExpression; return true;
+		case ModuleOp::OffsetExpression:        kind = NodeKind::OffsetExpression; return true;
+		case ModuleOp::CompareExpression:       kind = NodeKind::CompareExpression; return true;
+		case ModuleOp::RegionExpression:        kind = NodeKind::RegionExpression; return true;
+		case ModuleOp::NegExpression:           kind = NodeKind::NegExpression; return true;
+		case ModuleOp::BitNotExpression:        kind = NodeKind::BitNotExpression; return true;
+		case ModuleOp::AddExpression:           kind = NodeKind::AddExpression; return true;
+		case ModuleOp::SubExpression:           kind = NodeKind::SubExpression; return true;
+		case ModuleOp::MulExpression:           kind = NodeKind::MulExpression; return true;
+		case ModuleOp::DivExpression:           kind = NodeKind::DivExpression; return true;
+		case ModuleOp::ModExpression:           kind = NodeKind::ModExpression; return true;
+		case ModuleOp::BitOrExpression:         kind = NodeKind::BitOrExpression; return true;
+		case ModuleOp::BitAndExpression:        kind = NodeKind::BitAndExpression; return true;
+		case ModuleOp::BitXorExpression:        kind = NodeKind::BitXorExpression; return true;
+		case ModuleOp::LeftShiftExpression:     kind = NodeKind::LeftShiftExpression; return true;
+		case ModuleOp::RightShiftExpression:    kind = NodeKind::RightShiftExpression; return true;
+		case ModuleOp::EqualExpression:         kind = NodeKind::EqualExpression; return true;
+		case ModuleOp::NotEqualExpression:      kind = NodeKind::NotEqualExpression; return true;
+		case ModuleOp::LessExpression:          kind = NodeKind::LessExpression; return true;
+		case ModuleOp::GreaterExpression:       kind = NodeKind::GreaterExpression; return true;
+		case ModuleOp::LessEqualExpression:     kind = NodeKind::LessEqualExpression; return true;
+		case ModuleOp::GreaterEqualExpression:  kind = NodeKind::GreaterEqualExpression; return true;
+		case ModuleOp::Variable:                kind = NodeKind::Variable; return true;
+		case ModuleOp::SubVariable:             kind = NodeKind::SubVariable; return true;
+		case ModuleOp::DerefVariable:           kind = NodeKind::DerefVariable; return true;
+		case ModuleOp::RefValue:                kind = NodeKind::RefValue; return true;
+		case ModuleOp::Integer:                 kind = NodeKind::Integer; return true;
+		case ModuleOp::StringValue:             kind = NodeKind::StringValue; return true;
+		default: return false;
+	}
+}
+
+void ModuleWriter::Write(Weak<KiwiProgram> program, const String& filename) {
+	std::vector<UByte> bytes = Write(program);
+
+	std::FILE* file = std::fopen(filename, "wb");
+
+	if (!file) {
+		throw KiwiModuleError("could not open file '" + filename + "'");
+	}
+
+	bool written = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+
+	if (std::fclose(file) != 0 || !written) {
+		throw KiwiModuleError("could not write file '" + filename + "'");
+	}
+}
+
+std::vector<UByte> ModuleWriter::Write(Weak<KiwiProgram> program) {
+	ModuleWriter writer = ModuleWriter(program);
+	return writer.Build();
+}
+
+ModuleWriter::ModuleWriter(Weak<KiwiProgram> program) {
+	this->program = program;
+}
+
+static UInt Align(UInt offset) {
+	return (offset + 3) & ~3u;
+}
+
+template <class T>
+static ModuleSection AddSection(UInt& offset, const std::vector<T>& table) {
+	ModuleSection section;
+	section.offset = offset;
+	section.count  = (UInt)table.size();
+	offset = Align(offset + (UInt)(table.size() * sizeof(T)));
+	return section;
+}
+
+template <class T>
+static void CopySection(std::vector<UByte>& bytes, const ModuleSection& section, const std::vector<T>& table) {
+	if (table.empty()) return;
+	std::memcpy(bytes.data() + section.offset, table.data(), table.size() * sizeof(T));
+}
+
+std::vector<UByte> ModuleWriter::Build() {
+	for (const Pair<String, Ptr<Struct>>& s : program->structs) {
+		ModuleStruct struct_;
+		struct_.name    = AddString(s.value->name);
+		struct_.aligned = s.value->IsAligned() ? 1 : 0;
+		struct_.vars    = (UInt)vars.size();
+
+		for (const Tuple<Type, String>& var : s.value->vars) {
+			AddVar(var.value1, var.value2);
+		}
+
+		struct_.varCount = (UInt)vars.size() - struct_.vars;
+		structs.push_back(struct_);
+	}
+
+	for (const Pair<String, Ptr<StaticData>>& sd : program->staticData) {
+		ModuleStatic data;
+		data.name = AddString(sd.value->name);
+		data.vars = (UInt)vars.size();
+		data.code = (UInt)code.size();
+
+		for (const Tuple<Type, String, Ptr<Value>>& value : sd.value->data) {
+			AddVar(value.value1, value.value2);
+			WriteNode(value.value3);
+		}
+
+		data.varCount = (UInt)vars.size() - data.vars;
+		statics.push_back(data);
+	}
+
+	for (const Pair<String, Ptr<Function>>& f : program->functions) {
+		ModuleFunction function;
+		function.name    = AddString(f.value->name);
+		function.returns = (UInt)vars.size();
+
+		for (const Tuple<Type, String>& ret : f.value->returnValues) {
+			AddVar(ret.value1, ret.value2);
+		}
+
+		function.returnCount = (UInt)vars.size() - function.returns;
+		function.args = (UInt)vars.size();
+
+		for (const Tuple<Type, String>& arg : f.value->arguments) {
+			AddVar(arg.value1, arg.value2);
+		}
+
+		function.argCount = (UInt)vars.size() - function.args;
+		function.code = (UInt)code.size();
+		program->LoadFunction(f.value);
+		WriteBlock(f.value->block);
+		function.codeSize = (UInt)code.size() - function.code;
+		functions.push_back(function);
+	}
+
+	for (Weak<CodeBlock> b : program->blocks) {
+		ModuleBlock block;
+		block.code = (UInt)code.size();
+		WriteBlock(b);
+		block.codeSize = (UInt)code.size() - block.code;
+		blocks.push_back(block);
+	}
+
+	ModuleHeader header;
+	header.magic       = ModuleReader::magic;
+	header.version     = ModuleReader::version;
+	header.pointerSize = program->PointerSize();
+
+	UInt offset = Align(sizeof(ModuleHeader));
+	header.strings = AddSection(offset, strings);
+
+	UInt stringOffset = offset;
+	offset = Align(offset + (UInt)stringData.size());
+
+	header.types     = AddSection(offset, types);
+	header.vars      = AddSection(offset, vars);
+	header.structs   = AddSection(offset, structs);
+	header.statics   = AddSection(offset, statics);
+	header.functions = AddSection(offset, functions);
+	header.blocks    = AddSection(offset, blocks);
+	header.code      = AddSection(offset, code);
+
+	for (ModuleString& str : strings) {
+		str.offset += stringOffset;
+	}
+
+	std::vector<UByte> bytes = std::vector<UByte>(offset);
+	std::memcpy(bytes.data(), &header, sizeof(ModuleHeader));
+
+	if (!stringData.empty()) {
+		std::memcpy(bytes.data() + stringOffset, stringData.data(), stringData.size());
+	}
+
+	CopySection(bytes, header.strings,   strings);
+	CopySection(bytes, header.types,     types);
+	CopySection(bytes, header.vars,      vars);
+	CopySection(bytes, header.structs,   structs);
+	CopySection(bytes, header.statics,   statics);
+	CopySection(bytes, header.functions, functions);
+	CopySection(bytes, header.blocks,    blocks);
+	CopySection(bytes, header.code,      code);
+
+	return bytes;
+}
+
+UInt ModuleWriter::AddString(const String& str) {
+	UInt id;
+
+	if (stringIds.Contains(str, id)) {
+		return id;
+	}
+
+	ModuleString entry;
+	entry.offset = (UInt)stringData.size();
+	entry.length = str.Length();
+
+	const char* chars = str;
+	stringData.insert(stringData.end(), chars, chars + entry.length);
+
+	id = (UInt)strings.size();
+	strings.push_back(entry);
+	stringIds.Add(str, id);
+	return id;
+}
+
+UInt ModuleWriter::AddType(const Type& type) {
+	UInt id;
+
+	if (typeIds.Contains(type, id)) {
+		return id;
+	}
+
+	ModuleType entry;
+	entry.name     = AddString(type.name);
+	entry.pointers = type.pointers;
+	entry.len      = type.len;
+
+	id = (UInt)types.size();
+	types.push_back(entry);
+	typeIds.Add(type, id);
+	return id;
+}
+
+UInt ModuleWriter::AddOptionalString(const Optional<String>& str) {
+	return str ? AddString(*str) : ModuleReader::none;
+}
+
+UInt ModuleWriter::AddOptionalType(const Optional<Type>& type) {
+	return type ? AddType(*type) : ModuleReader::none;
+}
+
+UInt ModuleWriter::AddVar(const Type& type, const String& name) {
+	ModuleVar var;
+	var.type = AddType(type);
+	var.name = AddString(name);
+	vars.push_back(var);
+	return (UInt)vars.size() - 1;
+}
+
+void ModuleWriter::WriteBlock(Weak<CodeBlock> block) {
+	WriteInstructions(block->mainBlock);
+	WriteUInt(block->blocks.Count());
+
+	for (Weak<InstructionBlock> sub : block->blocks) {
+		WriteUInt(AddString(sub->label));
+		WriteInstructions(sub);
+	}
+}
+
+void ModuleWriter::WriteInstructions(Weak<InstructionBlock> block) {
+	WriteUInt(block->instructions.Count());
+
+	for (Weak<Instruction> instruction : block->instructions) {
+		WriteNode(instruction);
+	}
+}
+
+void ModuleWriter::WriteNode(Weak<Node> node) {
+	if (!node) {
+		WriteByte((UByte)ModuleOp::None);
+		return;
+	}
+
+	ModuleOp op;
+
+	if (!ToModuleOp(node->Kind(), op)) {
+		throw KiwiModuleError("can not write node of kind " + String::ToString((UInt)node->Kind()));
+	}
+
+	WriteByte((UByte)op);
+
+	if (Weak<UnaryExpression> unary = dyn_cast<UnaryExpression>(node)) {
+		WriteNode(unary->value);
+		return;
+	}
+
+	if (Weak<BinaryExpression> binary = dyn_cast<BinaryExpression>(node)) {
+		WriteNode(binary->value1);
+		WriteNode(binary->value2);
+		return;
+	}
+
+	switch (node->Kind()) {
+		case NodeKind::AssignInstruction: {
+			Weak<AssignInstruction> assign = cast<AssignInstruction>(node);
+			WriteUInt(AddOptionalType(assign->type));
+			WriteNode(assign->var);
+			WriteNode(assign->expression);
+			break;
+		}
+
+		case NodeKind::MultiAssignInstruction: {
+			Weak<MultiAssignInstruction> assign = cast<MultiAssignInstruction>(node);
+			WriteUInt(assign->types.Count());
+
+			for (const Optional<Type>& type : assign->types) {
+				WriteUInt(AddOptionalType(type));
+			}
+
+			WriteUInt(assign->vars.Count());
+
+			for (Weak<Variable> var : assign->vars) {
+				WriteNode(var);
+			}
+
+			WriteUInt(assign->weakExpressions.Count());
+
+			for (Weak<Expression> expression : assign->weakExpressions) {
+				WriteNode(expression);
+			}
+
+			break;
+		}
+
+		case NodeKind::OffsetAssignInstruction: {
+			Weak<OffsetAssignInstruction> assign = cast<OffsetAssignInstruction>(node);
+			WriteNode(assign->var);
+			WriteNode(assign->expression);
+			WriteUInt(AddOptionalType(assign->type));
+			WriteNode(assign->offset);
+			break;
+		}
+
+		case NodeKind::CopyInstruction: {
+			Weak<CopyInstruction> copy = cast<CopyInstruction>(node);
+			WriteNode(copy->dst);
+			WriteNode(copy->src);
+			WriteNode(copy->size);
+			break;
+		}
+
+		case NodeKind::FillInstruction: {
+			Weak<FillInstruction> fill = cast<FillInstruction>(node);
+			WriteNode(fill->dst);
+			WriteNode(fill->value);
+			WriteNode(fill->size);
+			break;
+		}
+
+		case NodeKind::MoveInstruction: {
+			Weak<MoveInstruction> move = cast<MoveInstruction>(node);
+			WriteNode(move->dst);
+			WriteNode(move->src);
+			WriteNode(move->size);
+			break;
+		}
+
+		case NodeKind::CallInstruction: {
+			WriteNode(cast<CallInstruction>(node)->call);
+			break;
+		}
+
+		case NodeKind::GotoInstruction: {
+			WriteUInt(AddString(cast<GotoInstruction>(node)->label));
+			break;
+		}
+
+		case NodeKind::IfInstruction: {
+			Weak<IfInstruction> if_ = cast<IfInstruction>(node);
+			WriteNode(if_->condition);
+			WriteUInt(AddOptionalString(if_->trueLabel));
+			WriteUInt(AddOptionalString(if_->falseLabel));
+			break;
+		}
+
+		case NodeKind::FreeInstruction: {
+			WriteNode(cast<FreeInstruction>(node)->value);
+			break;
+		}
+
+		case NodeKind::DestroyInstruction: {
+			WriteNode(cast<DestroyInstruction>(node)->region);
+			break;
+		}
+
+		case NodeKind::DebugPrintInstruction: {
+			Weak<DebugPrintInstruction> print = cast<DebugPrintInstruction>(node);
+			WriteNode(print->value);
+			WriteUInt(AddOptionalString(print->type));
+			break;
+		}
+
+		case NodeKind::CallExpression: {
+			Weak<CallExpression> call = cast<CallExpression>(node);
+			WriteNode(call->funcPtr);
+			WriteUInt(call->funcPtr ? ModuleReader::none : AddString(call->func));
+			WriteUInt(call->args.Count());
+
+			for (Weak<Value> arg : call->args) {
+				WriteNode(arg);
+			}
+
+			break;
+		}
+
+		case NodeKind::AllocExpression: {
+			Weak<AllocExpression> alloc = cast<AllocExpression>(node);
+			WriteUInt(alloc->size);
+			WriteUInt(AddOptionalType(alloc->type));
+			WriteNode(alloc->var);
+			WriteNode(alloc->region);
+			break;
+		}
+
+		case NodeKind::StackAllocExpression: {
+			Weak<StackAllocExpression> alloc = cast<StackAllocExpression>(node);
+			WriteUInt(alloc->size);
+			WriteUInt(AddOptionalType(alloc->type));
+			WriteNode(alloc->var);
+			break;
+		}
+
+		case NodeKind::OffsetExpression: {
+			Weak<OffsetExpression> offset = cast<OffsetExpression>(node);
+			WriteNode(offset->var);
+			WriteUInt(AddType(offset->type));
+			WriteUInt(AddOptionalType(offset->offsetType));
+			WriteNode(offset->offset);
+			break;
+		}
+
+		case NodeKind::CompareExpression: {
+			Weak<CompareExpression> compare = cast<CompareExpression>(node);
+			WriteNode(compare->value1);
+			WriteNode(compare->value2);
+			WriteNode(compare->size);
+			break;
+		}
+
+		case NodeKind::Variable:
+		case NodeKind::DerefVariable: {
+			WriteUInt(AddString(cast<Variable>(node)->name));
+			break;
+		}
+
+		case NodeKind::SubVariable: {
+			Weak<SubVariable> sub = cast<SubVariable>(node);
+			WriteNode(sub->var);
+			WriteUInt(AddString(sub->name));
+			break;
+		}
+
+		case NodeKind::RefValue: {
+			WriteNode(cast<RefValue>(node)->var);
+			break;
+		}
+
+		case NodeKind::Integer: {
+			Weak<Integer> integer = cast<Integer>(node);
+			WriteUInt(AddType(integer->type));
+			WriteLong(integer->value);
+			break;
+		}
+
+		case NodeKind::StringValue: {
+			WriteUInt(AddString(cast<StringValue>(node)->value));
+			break;
+		}
+
+		case NodeKind::ReturnInstruction:
+		case NodeKind::RegionExpression: {
+			break;
+		}
+
+		default: {
+			throw KiwiModuleError("can not write node of kind " + String::ToString((UInt)node->Kind()));
+		}
+	}
+}
+
+void ModuleWriter::WriteByte(UByte value) {
+	code.push_back(value);
+}
+
+void ModuleWriter::WriteUInt(UInt value) {
+	UByte bytes[sizeof(UInt)];
+	std::memcpy(bytes, &value, sizeof(UInt));
+	code.insert(code.end(), bytes, bytes + sizeof(UInt));
+}
+
+void ModuleWriter::WriteLong(Long value) {
+	UByte bytes[sizeof(Long)];
+	std::memcpy(bytes, &value, sizeof(Long));
+	code.insert(code.end(), bytes, bytes + sizeof(Long));
+}
+
+Ptr<KiwiProgram> ModuleReader::Read(const String& filename) {
+	Ptr<Interpreter::MappedFile> file = new Interpreter::MappedFile(filename);
+
+	if (!file->IsOpen()) {
+		throw KiwiModuleError("could not open file '" + filename + "'");
+	}
+
+	Ptr<ModuleReader> reader = new ModuleReader((const UByte*)file->Data(), file->Size());
+	reader->file = file;
+	reader->lazy = true;
+
+	Ptr<KiwiProgram> program = reader->ReadProgram();
+	program->loader = reader;
+	return program;
+}
+
+Ptr<KiwiProgram> ModuleReader::Read(const UByte* data, UInt size) {
+	ModuleReader reader = ModuleReader(data, size);
+	return reader.ReadProgram();
+}
+
+ModuleReader::ModuleReader(const UByte* data, UInt size) {
+	this->data = data;
+	this->size = size;
+
+	if (size < sizeof(ModuleHeader) || ((ULong)data & 3) != 0) {
+		Error("invalid module");
+	}
+
+	header = (const ModuleHeader*)data;
+
+	if (header->magic != magic) {
+		Error("invalid module");
+	}
+
+	if (header->version != version) {
+		Error("unsupported module version " + String::ToString(header->version));
+	}
+
+	strings   = GetTable<ModuleString>(header->strings);
+	types     = GetTable<ModuleType>(header->types);
+	vars      = GetTable<ModuleVar>(header->vars);
+	structs   = GetTable<ModuleStruct>(header->structs);
+	statics   = GetTable<ModuleStatic>(header->statics);
+	functions = GetTable<ModuleFunction>(header->functions);
+	blocks    = GetTable<ModuleBlock>(header->blocks);
+	code      = GetTable<UByte>(header->code);
+
+	stringCache  = Array<String>(header->strings.count);
+	stringLoaded = Array<bool>(header->strings.count);
+	typeCache    = Array<Type>(header->types.count);
+	typeLoaded   = Array<bool>(header->types.count);
+
+	for (UInt i = 0; i < header->strings.count; i++) stringLoaded[i] = false;
+	for (UInt i = 0; i < header->types.count; i++) typeLoaded[i] = false;
+
+	pos = code;
+	end = code;
+}
+
+template <class T>
+const T* ModuleReader::GetTable(const ModuleSection& section) const {
+	if (section.offset % alignof(T) != 0 || (ULong)section.offset + (ULong)section.count * sizeof(T) > size) {
+		Error("invalid module");
+	}
+
+	return (const T*)(data + section.offset);
+}
+
+Ptr<KiwiProgram> ModuleReader::ReadProgram() {
+	Ptr<KiwiProgram> result = new KiwiProgram();
+	program = result;
+
+	if (header->pointerSize != 4 && header->pointerSize != 8) {
+		Error("invalid pointer size " + String::ToString(header->pointerSize));
+	}
+
+	program->SetPointerSize(header->pointerSize);
+
+	for (UInt i = 0; i < header->structs.count; i++) {
+		const ModuleStruct& entry = structs[i];
+
+		Ptr<Struct> s = program->New<Struct>(GetString(entry.name));
+		Weak<Struct> struct_ = s;
+
+		for (UInt u = 0; u < entry.varCount; u++) {
+			const ModuleVar& var = GetVar(entry.vars + u);
+			struct_->AddVariable(GetType(var.type), GetString(var.name));
+		}
+
+		if (entry.aligned) {
+			struct_->SetAligned(true);
+		}
+
+		program->AddStruct(s);
+	}
+
+	for (UInt i = 0; i < header->statics.count; i++) {
+		const ModuleStatic& entry = statics[i];
+
+		Ptr<StaticData> d = program->New<StaticData>(GetString(entry.name));
+		Weak<StaticData> data = d;
+
+		if (entry.code > header->code.count) {
+			Error("invalid static data");
+		}
+
+		pos = code + entry.code;
+		end = code + header->code.count;
+
+		for (UInt u = 0; u < entry.varCount; u++) {
+			const ModuleVar& var = GetVar(entry.vars + u);
+			data->AddValue(GetType(var.type), GetString(var.name), ReadValue());
+		}
+
+		program->AddStatic(d);
+	}
+
+	for (UInt i = 0; i < header->functions.count; i++) {
+		const ModuleFunction& entry = functions[i];
+
+		Ptr<Function> f = program->New<Function>(GetString(entry.name), program->arena);
+		Weak<Function> function = f;
+
+		for (UInt u = 0; u < entry.returnCount; u++) {
+			const ModuleVar& var = GetVar(entry.returns + u);
+			function->AddReturnValue(GetType(var.type), GetString(var.name));
+		}
+
+		for (UInt u = 0; u < entry.argCount; u++) {
+			const ModuleVar& var = GetVar(entry.args + u);
+			function->AddArgument(GetType(var.type), GetString(var.name));
+		}
+
+		if (lazy) {
+			function->loaded = false;
+			functionIds.Add(function->name, i);
+		}
+		else {
+			ReadBlock(function->block, entry.code, entry.codeSize);
+		}
+
+		program->AddFunction(f);
+	}
+
+	for (UInt i = 0; i < header->blocks.count; i++) {
+		Ptr<CodeBlock> b = program->New<CodeBlock>(program->arena);
+		Weak<CodeBlock> block = b;
+
+		ReadBlock(block, blocks[i].code, blocks[i].codeSize);
+		program->AddCodeBlock(b);
+	}
+
+	return result;
+}
+
+void ModuleReader::LoadFunction(Weak<Function> function) {
+	UInt index;
+
+	if (!functionIds.Contains(function->name, index)) {
+		Error("function '" + Name::ToKiwi(function->name) + "' is not in the module");
+	}
+
+	ReadBlock(function->block, functions[index].code, functions[index].codeSize);
+}
+
+void ModuleReader::ReadBlock(Weak<CodeBlock> block, UInt offset, UInt size) {
+	if ((ULong)offset + size > header->code.count) {
+		Error("invalid code block");
+	}
+
+	pos = code + offset;
+	end = pos + size;
+	depth = 0;
+
+	ReadInstructions(block->mainBlock);
+
+	UInt count = ReadUInt();
+
+	for (UInt i = 0; i < count; i++) {
+		Ptr<InstructionBlock> sub = program->New<InstructionBlock>(GetString(ReadUInt()));
+		Weak<InstructionBlock> weakSub = sub;
+		block->AddInstructionBlock(sub);
+
+		ReadInstructions(weakSub);
+	}
+
+	if (pos != end) {
+		Error("invalid code block");
+	}
+}
+
+void ModuleReader::ReadInstructions(Weak<InstructionBlock> block) {
+	UInt count = ReadUInt();
+
+	for (UInt i = 0; i < count; i++) {
+		block->AddInstruction(ReadInstruction());
+	}
+}
+
+Ptr<Node> ModuleReader::ReadNode() {
+	if (depth >= maxDepth) {
+		Error("nodes are nested too deeply");
+	}
+
+	depth++;
+	Ptr<Node> node = ReadNodeData();
+	depth--;
+
+	return node;
+}
+
+Ptr<Node> ModuleReader::ReadNodeData() {
+	UByte op = ReadByte();
+	NodeKind kind;
+
+	if (!FromModuleOp((ModuleOp)op, kind)) {
+		Error("invalid node kind " + String::ToString((UInt)op));
+	}
+
+	switch (kind) {
+		case NodeKind::Node: {
+			return nullptr;
+		}
+
+		case NodeKind::AssignInstruction: {
+			Optional<Type> type = GetOptionalType(ReadUInt());
+			Ptr<Variable> var = ReadVariable();
+			Ptr<Expression> expression = ReadExpression();
+
+			if (type) {
+				return program->New<AssignInstruction>(*type, var, expression);
+			}
+
+			return program->New<AssignInstruction>(var, expression);
+		}
+
+		case NodeKind::MultiAssignInstruction: {
+			List<Optional<Type>> types;
+			List<Ptr<Variable>> vars;
+			List<Ptr<Expression>> expressions;
+
+			UInt typeCount = ReadUInt();
+
+			for (UInt i = 0; i < typeCount; i++) {
+				types.Add(GetOptionalType(ReadUInt()));
+			}
+
+			UInt varCount = ReadUInt();
+
+			for (UInt i = 0; i < varCount; i++) {
+				vars.Add(ReadVariable());
+			}
+
+			UInt expressionCount = ReadUInt();
+
+			for (UInt i = 0; i < expressionCount; i++) {
+				expressions.Add(ReadExpression());
+			}
+
+			return program->New<MultiAssignInstruction>(types, vars, expressions);
+		}
+
+		case NodeKind::OffsetAssignInstruction: {
+			Ptr<Variable> var = ReadVariable();
+			Ptr<Expression> expression = ReadExpression();
+			Optional<Type> type = GetOptionalType(ReadUInt());
+			Ptr<Value> offset = ReadValue();
+
+			if (type) {
+				return program->New<OffsetAssignInstruction>(var, expression, *type, offset);
+			}
+
+			Ptr<OffsetAssignInstruction> assign = program->New<OffsetAssignInstruction>(var, expression, 0u);
+			assign->offset = offset;
+			return assign;
+		}
+
+		case NodeKind::CopyInstruction: {
+			Ptr<Value> dst = ReadValue();
+			Ptr<Value> src = ReadValue();
+			return program->New<CopyInstruction>(dst, src, ReadValue());
+		}
+
+		case NodeKind::FillInstruction: {
+			Ptr<Value> dst   = ReadValue();
+			Ptr<Value> value = ReadValue();
+			return program->New<FillInstruction>(dst, value, ReadValue());
+		}
+
+		case NodeKind::MoveInstruction: {
+			Ptr<Value> dst = ReadValue();
+			Ptr<Value> src = ReadValue();
+			return program->New<MoveInstruction>(dst, src, ReadValue());
+		}
+
+		case NodeKind::CallInstruction: {
+			Ptr<CallExpression> call = ReadExpression().AsPtr<CallExpression>();
+
+			if (!call) {
+				Error("expected call");
+			}
+
+			return program->New<CallInstruction>(call);
+		}
+
+		case NodeKind::ReturnInstruction: {
+			return program->New<ReturnInstruction>();
+		}
+
+		case NodeKind::GotoInstruction: {
+			return program->New<GotoInstruction>(GetString(ReadUInt()));
+		}
+
+		case NodeKind::IfInstruction: {
+			Ptr<Expression> condition = ReadExpression();
+			Optional<String> trueLabel = GetOptionalString(ReadUInt());
+			return program->New<IfInstruction>(condition, trueLabel, GetOptionalString(ReadUInt()));
+		}
+
+		case NodeKind::FreeInstruction: {
+			return program->New<FreeInstruction>(ReadValue());
+		}
+
+		case NodeKind::DestroyInstruction: {
+			return program->New<DestroyInstruction>(ReadValue());
+		}
+
+		case NodeKind::DebugPrintInstruction: {
+			Ptr<DebugPrintInstruction> print = program->New<DebugPrintInstruction>(ReadValue());
+			print->type = GetOptionalString(ReadUInt());
+			return print;
+		}
+
+		case NodeKind::CallExpression: {
+			Ptr<Variable> funcPtr = ReadVariable();
+			UInt func = ReadUInt();
+
+			Ptr<CallExpression> call = funcPtr ? program->New<CallExpression>(funcPtr) : program->New<CallExpression>(GetString(func));
+			Weak<CallExpression> weakCall = call;
+
+			UInt count = ReadUInt();
+
+			for (UInt i = 0; i < count; i++) {
+				weakCall->args.Add(ReadValue());
+			}
+
+			return call;
+		}
+
+		case NodeKind::AllocExpression:
+		case NodeKind::StackAllocExpression: {
+			UInt size = ReadUInt();
+			Optional<Type> type = GetOptionalType(ReadUInt());
+			Ptr<Variable> var = ReadVariable();
+
+			if (kind == NodeKind::StackAllocExpression) {
+				if (type) return program->New<StackAllocExpression>(*type);
+				if (var)  return program->New<StackAllocExpression>(var);
+				return program->New<StackAllocExpression>(size);
+			}
+
+			Ptr<AllocExpression> alloc;
+
+			if (type) alloc = program->New<AllocExpression>(*type);
+			else if (var) alloc = program->New<AllocExpression>(var);
+			else alloc = program->New<AllocExpression>(size);
+
+			alloc->region = ReadVariable();
+			return alloc;
+		}
+
+		case NodeKind::OffsetExpression: {
+			Ptr<Variable> var = ReadVariable();
+			Type type = GetType(ReadUInt());
+			Optional<Type> offsetType = GetOptionalType(ReadUInt());
+			Ptr<Value> offset = ReadValue();
+
+			if (offsetType) {
+				return program->New<OffsetExpression>(var, type, *offsetType, offset);
+			}
+
+			return program->New<OffsetExpression>(var, type, offset);
+		}
+
+		case NodeKind::CompareExpression: {
+			Ptr<Value> value1 = ReadValue();
+			Ptr<Value> value2 = ReadValue();
+			return program->New<CompareExpression>(value1, value2, ReadValue());
+		}
+
+		case NodeKind::RegionExpression: {
+			return program->New<RegionExpression>();
+		}
+
+		case NodeKind::NegExpression: {
+			return program->New<NegExpression>(ReadValue());
+		}
+
+		case NodeKind::BitNotExpression: {
+			return program->New<BitNotExpression>(ReadValue());
+		}
+
+		case NodeKind::Variable: {
+			return program->New<Variable>(GetString(ReadUInt()));
+		}
+
+		case NodeKind::SubVariable: {
+			Ptr<Variable> var = ReadVariable();
+			return program->New<SubVariable>(var, GetString(ReadUInt()));
+		}
+
+		case NodeKind::DerefVariable: {
+			return program->New<DerefVariable>(GetString(ReadUInt()));
+		}
+
+		case NodeKind::RefValue: {
+			return program->New<RefValue>(ReadVariable());
+		}
+
+		case NodeKind::Integer: {
+			Type type = GetType(ReadUInt());
+			return program->New<Integer>(type, ReadLong());
+		}
+
+		case NodeKind::StringValue: {
+			return program->New<StringValue>(GetString(ReadUInt()));
+		}
+
+		default: break;
+	}
+
+	if (kind >= NodeKind::FirstBinaryExpression && kind <= NodeKind::LastBinaryExpression) {
+		Ptr<Value> value1 = ReadValue();
+		Ptr<Value> value2 = ReadValue();
+
+		switch (kind) {
+			case NodeKind::AddExpression:        return program->New<AddExpression>(value1, value2);
+			case NodeKind::SubExpression:        return program->New<SubExpression>(value1, value2);
+			case NodeKind::MulExpression:        return program->New<MulExpression>(value1, value2);
+			case NodeKind::DivExpression:        return program->New<DivExpression>(value1, value2);
+			case NodeKind::ModExpression:        return program->New<ModExpression>(value1, value2);
+			case NodeKind::BitOrExpression:      return program->New<BitOrExpression>(value1, value2);
+			case NodeKind::BitAndExpression:     return program->New<BitAndExpression>(value1, value2);
+			case NodeKind::BitXorExpression:     return program->New<BitXorExpression>(value1, value2);
+			case NodeKind::LeftShiftExpression:  return program->New<LeftShiftExpression>(value1, value2);
+			case NodeKind::RightShiftExpression: return program->New<RightShiftExpression>(value1, value2);
+			case NodeKind::EqualExpression:      return program->New<EqualExpression>(value1, value2);
+			case NodeKind::NotEqualExpression:   return program->New<NotEqualExpression>(value1, value2);
+			case NodeKind::LessExpression:       return program->New<LessExpression>(value1, value2);
+			case NodeKind::GreaterExpression:    return program->New<GreaterExpression>(value1, value2);
+			case NodeKind::LessEqualExpression:  return program->New<LessEqualExpression>(value1, value2);
+			default:                             return program->New<GreaterEqualExpression>(value1, value2);
+		}
+	}
+
+	Error("invalid node kind " + String::ToString((UInt)op));
+}
+
+Ptr<Instruction> ModuleReader::ReadInstruction() {
+	Ptr<Instruction> instruction = ReadNode().AsPtr<Instruction>();
+
+	if (!instruction) {
+		Error("expected instruction");
+	}
+
+	return instruction;
+}
+
+Ptr<Expression> ModuleReader::ReadExpression() {
+	Ptr<Node> node = ReadNode();
+
+	if (!node) {
+		return nullptr;
+	}
+
+	Ptr<Expression> expression = node.AsPtr<Expression>();
+
+	if (!expression) {
+		Error("expected expression");
+	}
+
+	return expression;
+}
+
+Ptr<Value> ModuleReader::ReadValue() {
+	Ptr<Value> value = ReadNode().AsPtr<Value>();
+
+	if (!value) {
+		Error("expected value");
+	}
+
+	return value;
+}
+
+Ptr<Variable> ModuleReader::ReadVariable() {
+	Ptr<Node> node = ReadNode();
+
+	if (!node) {
+		return nullptr;
+	}
+
+	Ptr<Variable> variable = node.AsPtr<Variable>();
+
+	if (!variable) {
+		Error("expected variable");
+	}
+
+	return variable;
+}
+
+UByte ModuleReader::ReadByte() {
+	if (pos >= end) {
+		Error("unexpected end of code");
+	}
+
+	return *pos++;
+}
+
+UInt ModuleReader::ReadUInt() {
+	if (end - pos < (Long)sizeof(UInt)) {
+		Error("unexpected end of code");
+	}
+
+	UInt value;
+	std::memcpy(&value, pos, sizeof(UInt));
+	pos += sizeof(UInt);
+	return value;
+}
+
+Long ModuleReader::ReadLong() {
+	if (end - pos < (Long)sizeof(Long)) {
+		Error("unexpected end of code");
+	}
+
+	Long value;
+	std::memcpy(&value, pos, sizeof(Long));
+	pos += sizeof(Long);
+	return value;
+}
+
+const String& ModuleReader::GetString(UInt index) {
+	if (index >= header->strings.count) {
+		Error("invalid string index " + String::ToString(index));
+	}
+
+	if (!stringLoaded[index]) {
+		const ModuleString& entry = strings[index];
+
+		if ((ULong)entry.offset + entry.length > size) {
+			Error("invalid string");
+		}
+
+		stringCache[index]  = String((const char*)data + entry.offset, entry.length);
+		stringLoaded[index] = true;
+	}
+
+	return stringCache[index];
+}
+
+const Type& ModuleReader::GetType(UInt index) {
+	if (index >= header->types.count) {
+		Error("invalid type index " + String::ToString(index));
+	}
+
+	if (!typeLoaded[index]) {
+		const ModuleType& entry = types[index];
+		typeCache[index]  = Type(entry.pointers, GetString(entry.name), entry.len);
+		typeLoaded[index] = true;
+	}
+
+	return typeCache[index];
+}
+
+const ModuleVar& ModuleReader::GetVar(UInt index) const {
+	if (index >= header->vars.count) {
+		Error("invalid variable index " + String::ToString(index));
+	}
+
+	return vars[index];
+}
+
+Optional<String> ModuleReader::GetOptionalString(UInt index) {
+	if (index == none) return nullptr;
+	return GetString(index);
+}
+
+Optional<Type> ModuleReader::GetOptionalType(UInt index) {
+	if (index == none) return nullptr;
+	return GetType(index);
+}
+
+void ModuleReader::Error(const String& message) const {
+	throw KiwiModuleError(message);
+}
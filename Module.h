@@ -0,0 +1,319 @@
+#pragma once
+
+#include <vector>
+
+#include "Boxx/Boxx/String.h"
+#include "Boxx/Boxx/Array.h"
+#include "Boxx/Boxx/Map.h"
+#include "Boxx/Boxx/Error.h"
+
+#include "KiwiProgram.h"
+#include "Interpreter/Memory.h"
+
+///N Kiwi
+
+namespace Kiwi {
+	/// Error for reading and writing modules.
+	class KiwiModuleError : public Boxx::Error {
+	public:
+		KiwiModuleError() : Boxx::Error() {}
+		KiwiModuleError(const char* const msg) : Boxx::Error(msg) {}
+
+		virtual Boxx::String Name() const override {
+			return "KiwiModuleError";
+		}
+	};
+
+	/// A table in a module.
+	struct ModuleSection {
+		/// The byte offset from the start of the module.
+		Boxx::UInt offset;
+
+		/// The number of entries.
+		/// For the code section this is the byte size.
+		Boxx::UInt count;
+	};
+
+	/// The header of a binary module.
+	///
+	/// The header is followed by the tables it points to.
+	/// Numbers are little endian and all tables are 4 byte aligned so they can be used directly from a mapped file.
+	/// Names and types are stored once in the string and type tables and referred to by index.
+	struct ModuleHeader {
+		/// {ModuleReader::magic}.
+		Boxx::UInt magic;
+
+		/// {ModuleReader::version}.
+		Boxx::UInt version;
+
+		/// The byte size for pointers.
+		Boxx::UInt pointerSize;
+
+		///T Tables
+		///M
+		ModuleSection strings;
+		ModuleSection types;
+		ModuleSection vars;
+		ModuleSection structs;
+		ModuleSection statics;
+		ModuleSection functions;
+		ModuleSection blocks;
+		ModuleSection code;
+		///M
+	};
+
+	/// A string in a module.
+	struct ModuleString {
+		/// The byte offset from the start of the module.
+		Boxx::UInt offset;
+		Boxx::UInt length;
+	};
+
+	/// A type in a module.
+	struct ModuleType {
+		/// The index of the type name.
+		Boxx::UInt name;
+		Boxx::UInt pointers;
+		Boxx::UInt len;
+	};
+
+	/// A typed name in a module.
+	///
+	/// Used for struct variables, function arguments, return values and static values.
+	struct ModuleVar {
+		/// The index of the type.
+		Boxx::UInt type;
+
+		/// The index of the name.
+		Boxx::UInt name;
+	};
+
+	/// A struct in a module.
+	struct ModuleStruct {
+		Boxx::UInt name;
+		Boxx::UInt aligned;
+
+		/// The index of the first variable and the number of variables.
+		Boxx::UInt vars, varCount;
+	};
+
+	/// Static data in a module.
+	struct ModuleStatic {
+		Boxx::UInt name;
+
+		/// The index of the first value and the number of values.
+		Boxx::UInt vars, varCount;
+
+		/// The byte offset of the values in the code section.
+		Boxx::UInt code;
+	};
+
+	/// A function in a module.
+	struct ModuleFunction {
+		Boxx::UInt name;
+
+		/// The index of the first argument and the number of arguments.
+		Boxx::UInt args, argCount;
+
+		/// The index of the first return value and the number of return values.
+		Boxx::UInt returns, returnCount;
+
+		/// The byte offset and size of the function body in the code section.
+		Boxx::UInt code, codeSize;
+	};
+
+	/// A code block in a module.
+	struct ModuleBlock {
+		/// The byte offset and size of the block in the code section.
+		Boxx::UInt code, codeSize;
+	};
+
+	/// The node codes used in the code section of a module.
+	///
+	/// The codes are part of the module format and are kept separate from {NodeKind} so the node kinds can change without breaking existing modules.
+	/// New codes must be added with new values and existing values must never change.
+	enum class ModuleOp : Boxx::UByte {
+		None                    = 0,
+		AssignInstruction       = 8,
+		MultiAssignInstruction  = 9,
+		OffsetAssignInstruction = 10,
+		CopyInstruction         = 11,
+		FillInstruction         = 12,
+		MoveInstruction         = 13,
+		CallInstruction         = 14,
+		ReturnInstruction       = 15,
+		GotoInstruction         = 16,
+		IfInstruction           = 17,
+		FreeInstruction         = 18,
+		DestroyInstruction      = 19,
+		DebugPrintInstruction   = 21,
+		CallExpression          = 23,
+		AllocExpression         = 24,
+		StackAllocExpression    = 25,
+		OffsetExpression        = 26,
+		CompareExpression       = 27,
+		RegionExpression        = 28,
+		NegExpression           = 29,
+		BitNotExpression        = 30,
+		AddExpression           = 31,
+		SubExpression           = 32,
+		MulExpression           = 33,
+		DivExpression           = 34,
+		ModExpression           = 35,
+		BitOrExpression         = 36,
+		BitAndExpression        = 37,
+		BitXorExpression        = 38,
+		LeftShiftExpression     = 39,
+		RightShiftExpression    = 40,
+		EqualExpression         = 41,
+		NotEqualExpression      = 42,
+		LessExpression          = 43,
+		GreaterExpression       = 44,
+		LessEqualExpression     = 45,
+		GreaterEqualExpression  = 46,
+		Variable                = 48,
+		SubVariable             = 49,
+		DerefVariable           = 50,
+		RefValue                = 51,
+		Integer                 = 52,
+		StringValue             = 53
+	};
+
+	/// Writes programs to binary modules.
+	///
+	/// Code is written as a flat stream of nodes in prefix order.
+	/// Each node is its {ModuleOp} as a byte followed by its fields.
+	/// Missing nodes are written as {ModuleOp::None} and missing names and types as {ModuleReader::none}.
+	class ModuleWriter {
+	public:
+		/// Writes the program to a module file.
+		static void Write(Weak<KiwiProgram> program, const Boxx::String& filename);
+
+		/// Writes the program to module bytes.
+		static std::vector<Boxx::UByte> Write(Weak<KiwiProgram> program);
+
+	private:
+		ModuleWriter(Weak<KiwiProgram> program);
+
+		Weak<KiwiProgram> program;
+
+		Boxx::Map<Boxx::String, Boxx::UInt> stringIds;
+		Boxx::Map<Type, Boxx::UInt> typeIds;
+
+		std::vector<ModuleString> strings;
+		std::vector<char> stringData;
+		std::vector<ModuleType> types;
+		std::vector<ModuleVar> vars;
+		std::vector<ModuleStruct> structs;
+		std::vector<ModuleStatic> statics;
+		std::vector<ModuleFunction> functions;
+		std::vector<ModuleBlock> blocks;
+		std::vector<Boxx::UByte> code;
+
+		std::vector<Boxx::UByte> Build();
+
+		Boxx::UInt AddString(const Boxx::String& str);
+		Boxx::UInt AddType(const Type& type);
+		Boxx::UInt AddOptionalString(const Boxx::Optional<Boxx::String>& str);
+		Boxx::UInt AddOptionalType(const Boxx::Optional<Type>& type);
+		Boxx::UInt AddVar(const Type& type, const Boxx::String& name);
+
+		void WriteBlock(Weak<CodeBlock> block);
+		void WriteInstructions(Weak<InstructionBlock> block);
+		void WriteNode(Weak<Node> node);
+		void WriteByte(Boxx::UByte value);
+		void WriteUInt(Boxx::UInt value);
+		void WriteLong(Boxx::Long value);
+	};
+
+	/// Reads programs from binary modules.
+	///
+	/// The tables of the module are used in place.
+	/// Strings and types are only created once and when they are first used.
+	class ModuleReader : public FunctionLoader {
+	public:
+		/// The magic number at the start of a module.
+		static constexpr Boxx::UInt magic = 0x4D57494B;
+
+		/// The current version of the module format.
+		static constexpr Boxx::UInt version = 1;
+
+		/// The index used for missing names and types.
+		static constexpr Boxx::UInt none = 0xFFFFFFFF;
+
+		/// The maximum nesting depth of nodes in a module.
+		static constexpr Boxx::UInt maxDepth = 1024;
+
+		/// Reads a module file.
+		///
+		/// The file is mapped into memory instead of being read.
+		/// Only the signatures of functions are read up front.
+		/// The body of a function is read when it is first called or used as a function pointer.
+		/// The reader and the mapped file are owned by the program until then.
+		static Ptr<KiwiProgram> Read(const Boxx::String& filename);
+
+		/// Reads a module from memory.
+		///
+		/// All functions are read before returning so the data does not have to outlive the call.
+		static Ptr<KiwiProgram> Read(const Boxx::UByte* data, Boxx::UInt size);
+
+		virtual void LoadFunction(Weak<Function> function) override;
+
+	private:
+		ModuleReader(const Boxx::UByte* data, Boxx::UInt size);
+
+		Ptr<Interpreter::MappedFile> file;
+		bool lazy = false;
+
+		const Boxx::UByte* data;
+		Boxx::UInt size;
+
+		const ModuleHeader* header;
+		const ModuleString* strings;
+		const ModuleType* types;
+		const ModuleVar* vars;
+		const ModuleStruct* structs;
+		const ModuleStatic* statics;
+		const ModuleFunction* functions;
+		const ModuleBlock* blocks;
+		const Boxx::UByte* code;
+
+		Boxx::Array<Boxx::String> stringCache;
+		Boxx::Array<bool> stringLoaded;
+		Boxx::Array<Type> typeCache;
+		Boxx::Array<bool> typeLoaded;
+
+		Weak<KiwiProgram> program;
+		Boxx::Map<Boxx::String, Boxx::UInt> functionIds;
+
+		const Boxx::UByte* pos;
+		const Boxx::UByte* end;
+		Boxx::UInt depth = 0;
+
+		template <class T>
+		const T* GetTable(const ModuleSection& section) const;
+
+		Ptr<KiwiProgram> ReadProgram();
+		void ReadBlock(Weak<CodeBlock> block, Boxx::UInt offset, Boxx::UInt size);
+		void ReadInstructions(Weak<InstructionBlock> block);
+
+		Ptr<Node> ReadNode();
+		Ptr<Node> ReadNodeData();
+		Ptr<Instruction> ReadInstruction();
+		Ptr<Expression> ReadExpression();
+		Ptr<Value> ReadValue();
+		Ptr<Variable> ReadVariable();
+
+		Boxx::UByte ReadByte();
+		Boxx::UInt ReadUInt();
+		Boxx::Long ReadLong();
+
+		const Boxx::String& GetString(Boxx::UInt index);
+		const Type& GetType(Boxx::UInt index);
+		const ModuleVar& GetVar(Boxx::UInt index) const;
+		Boxx::Optional<Boxx::String> GetOptionalString(Boxx::UInt index);
+		Boxx::Optional<Type> GetOptionalType(Boxx::UInt index);
+
+		[[noreturn]] void Error(const Boxx::String& message) const;
+	};
+}
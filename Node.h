@@ -1,24 +1,180 @@
 #pragma once
 
 #include "Ptr.h"
+#include "Writer.h"
 
 #include "Interpreter/Interpreter.h"
+#include "Interpreter/Compiler.h"
 
 #include "Boxx/Boxx/StringBuilder.h"
-#include "Boxx/Boxx/Regex.h"
 
 ///N Kiwi
 
 namespace Kiwi {
+	/// The kind of a node.
+	///
+	/// The kinds are ordered so that each node class covers a continuous range.
+	enum class NodeKind : Boxx::UByte {
+		Node,
+		KiwiProgram,
+		CodeBlock,
+		InstructionBlock,
+		Function,
+		Struct,
+		StaticData,
+
+		Instruction,
+		AssignInstruction,
+		MultiAssignInstruction,
+		OffsetAssignInstruction,
+		CopyInstruction,
+		FillInstruction,
+		MoveInstruction,
+		CallInstruction,
+		ReturnInstruction,
+		GotoInstruction,
+		IfInstruction,
+		FreeInstruction,
+		DestroyInstruction,
+		DebugInstruction,
+		DebugPrintInstruction,
+
+		Expression,
+		CallExpression,
+		AllocExpression,
+		StackAllocExpression,
+		OffsetExpression,
+		CompareExpression,
+		RegionExpression,
+		NegExpression,
+		BitNotExpression,
+		AddExpression,
+		SubExpression,
+		MulExpression,
+		DivExpression,
+		ModExpression,
+		BitOrExpression,
+		BitAndExpression,
+		BitXorExpression,
+		LeftShiftExpression,
+		RightShiftExpression,
+		EqualExpression,
+		NotEqualExpression,
+		LessExpression,
+		GreaterExpression,
+		LessEqualExpression,
+		GreaterEqualExpression,
+
+		Value,
+		Variable,
+		SubVariable,
+		DerefVariable,
+		RefValue,
+		Integer,
+		StringValue,
+
+		FirstInstruction      = Instruction,
+		LastInstruction       = DebugPrintInstruction,
+		FirstDebugInstruction = DebugInstruction,
+		LastDebugInstruction  = DebugPrintInstruction,
+		FirstExpression       = Expression,
+		LastExpression        = StringValue,
+		FirstUnaryExpression  = NegExpression,
+		LastUnaryExpression   = BitNotExpression,
+		FirstBinaryExpression = AddExpression,
+		LastBinaryExpression  = GreaterEqualExpression,
+		FirstValue            = Value,
+		LastValue             = StringValue,
+		FirstVariable         = Variable,
+		LastVariable          = DerefVariable
+	};
+
 	/// The base for all Kiwi nodes.
 	class Node {
 	public:
 		virtual ~Node() {}
 
+		/// Gets the kind of the node.
+		NodeKind Kind() const {
+			return kind;
+		}
+
+		static bool classof(const Node* node) {
+			return true;
+		}
+
 		/// Interprets the node.
 		virtual void Interpret(Interpreter::InterpreterData& data) {}
 
+		/// Compiles the node to bytecode.
+		virtual void Compile(Interpreter::Compiler& compiler) {}
+
 		/// Builds a string from the node.
-		virtual void BuildString(Boxx::StringBuilder& builder) = 0;
+		virtual void BuildString(TextWriter& builder) = 0;
+
+	protected:
+		/// The kind of the node.
+		/// Set by the constructor of each node class.
+		NodeKind kind = NodeKind::Node;
 	};
+
+	/// {true} if the node is a {T}.
+	template <class T>
+	inline bool isa(const Node* node) {
+		return node && T::classof(node);
+	}
+
+	/// {true} if the node is a {T}.
+	template <class T, class U>
+	inline bool isa(const Ptr<U>& node) {
+		return isa<T>(*node);
+	}
+
+	/// {true} if the node is a {T}.
+	template <class T, class U>
+	inline bool isa(const Weak<U>& node) {
+		return isa<T>(*node);
+	}
+
+	/// Casts the node to a {T}.
+	/// The node has to be a {T}.
+	template <class T>
+	inline T* cast(Node* node) {
+		return static_cast<T*>(node);
+	}
+
+	/// Casts the node to a {T}.
+	/// The node has to be a {T}.
+	template <class T, class U>
+	inline Weak<T> cast(const Ptr<U>& node) {
+		return Weak<U>(node).template Cast<T>();
+	}
+
+	/// Casts the node to a {T}.
+	/// The node has to be a {T}.
+	template <class T, class U>
+	inline Weak<T> cast(const Weak<U>& node) {
+		return node.template Cast<T>();
+	}
+
+	/// Casts the node to a {T} if it is a {T}.
+	///R node: The node or {nullptr} if the node is not a {T}.
+	template <class T>
+	inline T* dyn_cast(Node* node) {
+		return isa<T>(node) ? static_cast<T*>(node) : nullptr;
+	}
+
+	/// Casts the node to a {T} if it is a {T}.
+	///R node: The node or an empty handle if the node is not a {T}.
+	template <class T, class U>
+	inline Weak<T> dyn_cast(const Ptr<U>& node) {
+		return isa<T>(*node) ? cast<T>(node) : Weak<T>();
+	}
+
+	/// Casts the node to a {T} if it is a {T}.
+	///R node: The node or an empty handle if the node is not a {T}.
+	template <class T, class U>
+	inline Weak<T> dyn_cast(const Weak<U>& node) {
+		return isa<T>(*node) ? cast<T>(node) : Weak<T>();
+	}
 }
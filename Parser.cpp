@@ -0,0 +1,1284 @@
+#include "Parser.h"
+
+#include <string>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <exception>
+
+#include "Interpreter/Memory.h"
+
+using namespace Boxx;
+
+using namespace Kiwi;
+
+static bool IsWordChar(char c) {
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static bool IsDigit(char c) {
+	return c >= '0' && c <= '9';
+}
+
+static String ToString(std::string_view text) {
+	return String(text.data(), (UInt)text.size());
+}
+
+static std::string_view ToView(const String& str) {
+	return std::string_view((const char*)str, str.Length());
+}
+
+static bool Fits(Long value, const Type& type) {
+	const TypeInfo& info = Type::Info(type.id);
+
+	if (type.pointers > 0 || !info.isInteger || info.size >= 8) return true;
+
+	if (info.isSigned) {
+		Long max = (1LL << (info.size * 8 - 1)) - 1;
+		return value >= -max - 1 && value <= max;
+	}
+
+	return value >= 0 && value < (1LL << (info.size * 8));
+}
+
+Token Lexer::Next() {
+	Token token;
+	token.line = line;
+
+	// Only the first tab of a line is an indent
+	if (lineStart) {
+		lineStart = false;
+
+		if (pos < end && *pos == '\t') {
+			token.type = TokenType::Indent;
+			token.text = std::string_view(pos++, 1);
+			return token;
+		}
+	}
+
+	while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r')) {
+		pos++;
+		token.space = true;
+	}
+
+	if (pos >= end) {
+		token.type = TokenType::End;
+		return token;
+	}
+
+	const char* start = pos;
+	char c = *pos++;
+
+	if (IsWordChar(c) || (c == '-' && pos < end && IsDigit(*pos))) {
+		bool number = true;
+
+		for (const char* p = start + (c == '-' ? 1 : 0); p < end && IsWordChar(*p); p++) {
+			if (!IsDigit(*p)) number = false;
+			pos = p + 1;
+		}
+
+		token.text = std::string_view(start, pos - start);
+
+		if (number) {
+			token.type = TokenType::Integer;
+		}
+		else if (token.text == "_") {
+			token.type = TokenType::Underscore;
+		}
+		else {
+			token.type = c == '-' ? TokenType::Invalid : TokenType::Name;
+		}
+
+		return token;
+	}
+
+	switch (c) {
+		case '\n': {
+			token.type = TokenType::Newline;
+			token.text = std::string_view(start, 1);
+			line++;
+			lineStart = true;
+			return token;
+		}
+
+		case '`': {
+			while (pos < end && *pos != '`' && *pos != '\n') pos++;
+
+			if (pos >= end || *pos != '`') {
+				token.type = TokenType::Invalid;
+				token.text = std::string_view(start, pos - start);
+				return token;
+			}
+
+			token.type = TokenType::Name;
+			token.text = std::string_view(start + 1, pos - start - 1);
+			pos++;
+			return token;
+		}
+
+		case '@': {
+			while (pos < end && IsDigit(*pos)) pos++;
+
+			token.type = pos > start + 1 ? TokenType::Name : TokenType::Invalid;
+			token.text = std::string_view(start + 1, pos - start - 1);
+			return token;
+		}
+
+		case '"': {
+			while (pos < end && *pos != '"' && *pos != '\n') {
+				if (*pos == '\\' && pos + 1 < end) pos++;
+				pos++;
+			}
+
+			if (pos >= end || *pos != '"') {
+				token.type = TokenType::Invalid;
+				token.text = std::string_view(start, pos - start);
+				return token;
+			}
+
+			token.type = TokenType::String;
+			token.text = std::string_view(start + 1, pos - start - 1);
+			pos++;
+			return token;
+		}
+
+		case ':': token.type = TokenType::Colon;        break;
+		case ',': token.type = TokenType::Comma;        break;
+		case '=': token.type = TokenType::Assign;       break;
+		case '(': token.type = TokenType::LeftParen;    break;
+		case ')': token.type = TokenType::RightParen;   break;
+		case '[': token.type = TokenType::LeftBracket;  break;
+		case ']': token.type = TokenType::RightBracket; break;
+		case '*': token.type = TokenType::Star;         break;
+		case '&': token.type = TokenType::Ampersand;    break;
+		case '.': token.type = TokenType::Dot;          break;
+		default:  token.type = TokenType::Invalid;      break;
+	}
+
+	token.text = std::string_view(start, 1);
+	return token;
+}
+
+Ptr<KiwiProgram> Parser::ParseFile(const String& filename, UInt threads) {
+	Interpreter::MappedFile file = Interpreter::MappedFile(filename);
+
+	if (!file.IsOpen()) {
+		throw KiwiParseError("could not open file '" + filename + "'");
+	}
+
+	return Parse(std::string_view(file.Data(), file.Size()), filename, threads);
+}
+
+Ptr<KiwiProgram> Parser::Parse(std::string_view source, const String& filename, UInt threads) {
+	if (threads == 0) {
+		threads = Math::Max((UInt)std::thread::hardware_concurrency(), (UInt)1);
+	}
+
+	List<Chunk> chunks;
+
+	if (threads > 1) {
+		chunks = Split(source, Math::Max(minChunkSize, (UInt)source.size() / (threads * 4)));
+	}
+
+	if (chunks.Count() <= 1) {
+		Parser parser = Parser(source, filename);
+		parser.ParseProgram();
+		parser.ResolveFixups();
+		return parser.program;
+	}
+
+	// Strings are not safe to share between threads
+	for (Chunk& chunk : chunks) {
+		chunk.filename = ToString(ToView(filename));
+	}
+
+	Array<Ptr<Parser>> parsers = Array<Ptr<Parser>>(chunks.Count());
+	std::vector<std::exception_ptr> errors = std::vector<std::exception_ptr>(chunks.Count());
+	std::atomic<UInt> next = 0;
+
+	auto work = [&]() {
+		for (UInt i = next++; i < chunks.Count(); i = next++) {
+			try {
+				Ptr<Parser> parser = new Parser(chunks[i].source, chunks[i].filename, chunks[i].line);
+				parser->ParseProgram();
+				parsers[i] = parser;
+			}
+			catch (...) {
+				errors[i] = std::current_exception();
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+
+	for (UInt i = 1; i < Math::Min(threads, chunks.Count()); i++) {
+		workers.emplace_back(work);
+	}
+
+	work();
+
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+
+	// The first error in the file is the same error the serial parser finds
+	for (const std::exception_ptr& error : errors) {
+		if (error) std::rethrow_exception(error);
+	}
+
+	return Link(parsers);
+}
+
+List<Parser::Chunk> Parser::Split(std::string_view source, UInt chunkSize) {
+	List<Chunk> chunks;
+
+	const char* start = source.data();
+	const char* end   = source.data() + source.size();
+	const char* pos   = start;
+
+	UInt line      = 1;
+	UInt startLine = 1;
+	bool blank     = false;
+
+	while (pos < end) {
+		const char* lineEnd = (const char*)std::memchr(pos, '\n', end - pos);
+		if (!lineEnd) lineEnd = end;
+
+		// Sections start at the top level after an empty line
+		// The serial parser is never inside a section when it reaches one of these lines
+		if (blank && *pos != '\t' && *pos != ' ' && *pos != '\r' && *pos != '\n' && pos - start >= (std::ptrdiff_t)chunkSize) {
+			Chunk chunk;
+			chunk.source = std::string_view(start, pos - start);
+			chunk.line   = startLine;
+			chunks.Add(chunk);
+
+			start     = pos;
+			startLine = line;
+		}
+
+		blank = *pos != '\t';
+
+		for (const char* c = pos; c < lineEnd; c++) {
+			if (*c != ' ' && *c != '\r') {
+				blank = false;
+				break;
+			}
+		}
+
+		pos = lineEnd < end ? lineEnd + 1 : end;
+		line++;
+	}
+
+	Chunk chunk;
+	chunk.source = std::string_view(start, end - start);
+	chunk.line   = startLine;
+	chunks.Add(chunk);
+
+	return chunks;
+}
+
+Ptr<KiwiProgram> Parser::Link(Array<Ptr<Parser>>& parsers) {
+	Ptr<KiwiProgram> program = new KiwiProgram();
+
+	// Everything is added in source order so the result is the same as for the serial parser
+	for (UInt i = 0; i < parsers.Length(); i++) {
+		Weak<KiwiProgram> part = parsers[i]->program;
+		program->arena.Adopt(part->arena);
+
+		if (parsers[i]->pointerSize != 0) {
+			program->SetPointerSize(parsers[i]->pointerSize);
+		}
+
+		for (Pair<String, Ptr<Struct>>& s : part->structs) {
+			program->AddStruct(s.value);
+		}
+
+		for (Pair<String, Ptr<StaticData>>& d : part->staticData) {
+			program->AddStatic(d.value);
+		}
+
+		for (Pair<String, Ptr<Function>>& f : part->functions) {
+			program->AddFunction(f.value);
+		}
+
+		for (Ptr<CodeBlock>& block : part->blocks) {
+			program->AddCodeBlock(block);
+		}
+	}
+
+	// Struct members and function arguments can be declared in other parts of the file
+	for (UInt i = 0; i < parsers.Length(); i++) {
+		parsers[i]->weakProgram = program;
+		parsers[i]->ResolveFixups();
+	}
+
+	return program;
+}
+
+Parser::Parser(std::string_view source, const String& filename, UInt line) : lexer(source, line) {
+	this->filename = filename;
+	program = new KiwiProgram();
+	weakProgram = program;
+	u8  = Type("u8");
+	i32 = Type("i32");
+	i64 = Type("i64");
+	token = lexer.Next();
+}
+
+void Parser::ParseProgram() {
+	while (token.type != TokenType::End) {
+		if (token.type == TokenType::Newline) {
+			Advance();
+		}
+		else if (token.type == TokenType::Name && token.text == "code") {
+			ParseCode();
+		}
+		else if (token.type == TokenType::Name && token.text == "function") {
+			ParseFunction();
+		}
+		else if (token.type == TokenType::Name && token.text == "struct") {
+			ParseStruct();
+		}
+		else if (token.type == TokenType::Name && token.text == "static") {
+			ParseStatic();
+		}
+		else if (token.type == TokenType::Name && token.text == "pointer") {
+			ParsePointerSize();
+		}
+		else {
+			Error("expected 'code', 'function', 'struct', 'static' or 'pointer'");
+		}
+	}
+}
+
+void Parser::ParseCode() {
+	Advance();
+	Expect(TokenType::Colon, "':'");
+	EndLine();
+
+	scope.clear();
+
+	Ptr<CodeBlock> block = program->New<CodeBlock>(program->arena);
+	Weak<CodeBlock> weakBlock = block;
+	program->AddCodeBlock(block);
+
+	ParseBlock(weakBlock);
+}
+
+void Parser::ParseFunction() {
+	Advance();
+	scope.clear();
+
+	List<Type> returnTypes;
+	List<String> returnNames;
+
+	// The function name is the first name followed by the argument list
+	if (!(token.type == TokenType::Name && Peek().type == TokenType::LeftParen)) {
+		returnTypes.Add(ParseType());
+
+		while (token.type == TokenType::Comma) {
+			Advance();
+			returnTypes.Add(ParseType());
+		}
+
+		Expect(TokenType::Colon, "':'");
+
+		do {
+			if (!returnNames.IsEmpty()) Advance();
+			returnNames.Add(GetName(Expect(TokenType::Name, "return value name")));
+		}
+		while (token.type == TokenType::Comma);
+
+		if (returnTypes.Count() != 1 && returnTypes.Count() != returnNames.Count()) {
+			Error("expected " + String::ToString(returnNames.Count()) + " return types");
+		}
+	}
+
+	Ptr<Function> func = program->New<Function>(GetName(Expect(TokenType::Name, "function name")), program->arena);
+	Weak<Function> function = func;
+
+	for (UInt i = 0; i < returnNames.Count(); i++) {
+		Type type = returnTypes.Count() == 1 ? returnTypes[0] : returnTypes[i];
+		function->AddReturnValue(type, returnNames[i]);
+		Declare(returnNames[i], type);
+	}
+
+	Expect(TokenType::LeftParen, "'('");
+
+	while (token.type != TokenType::RightParen) {
+		if (function->arguments.Count() > 0) {
+			Expect(TokenType::Comma, "',' or ')'");
+		}
+
+		Type type = ParseType();
+		Expect(TokenType::Colon, "':'");
+
+		const String& name = GetName(Expect(TokenType::Name, "argument name"));
+		function->AddArgument(type, name);
+		Declare(name, type);
+	}
+
+	Advance();
+	Expect(TokenType::Colon, "':'");
+	EndLine();
+
+	program->AddFunction(func);
+	ParseBlock(function->block);
+}
+
+void Parser::ParseStruct() {
+	Advance();
+
+	// 'aligned' is only a keyword if it is followed by the struct name
+	bool aligned = token.type == TokenType::Name && token.text == "aligned" && Peek().type == TokenType::Name;
+
+	if (aligned) {
+		Advance();
+	}
+
+	Ptr<Struct> s = program->New<Struct>(GetName(Expect(TokenType::Name, "struct name")));
+	Weak<Struct> struct_ = s;
+	struct_->SetAligned(aligned);
+
+	Expect(TokenType::Colon, "':'");
+	EndLine();
+
+	while (token.type == TokenType::Indent) {
+		Advance();
+
+		Type type = ParseType();
+		Expect(TokenType::Colon, "':'");
+		struct_->AddVariable(type, GetName(Expect(TokenType::Name, "variable name")));
+		EndLine();
+	}
+
+	program->AddStruct(s);
+}
+
+void Parser::ParsePointerSize() {
+	Advance();
+
+	Token size = Expect(TokenType::Integer, "pointer size");
+	Long value = GetInteger(size);
+
+	if (value != 4 && value != 8) {
+		Error("invalid pointer size " + ToString(size.text));
+	}
+
+	pointerSize = (UInt)value;
+	program->SetPointerSize(pointerSize);
+	EndLine();
+}
+
+void Parser::ParseStatic() {
+	Advance();
+
+	Ptr<StaticData> d = program->New<StaticData>(GetName(Expect(TokenType::Name, "static data name")));
+	Weak<StaticData> data = d;
+
+	Expect(TokenType::Colon, "':'");
+	EndLine();
+
+	while (token.type == TokenType::Indent) {
+		Advance();
+
+		Type type = ParseType();
+		Expect(TokenType::Colon, "':'");
+		const String& name = GetName(Expect(TokenType::Name, "value name"));
+		Expect(TokenType::Assign, "'='");
+		data->AddValue(type, name, ParseValue(HintOf(type)));
+		EndLine();
+	}
+
+	program->AddStatic(d);
+}
+
+void Parser::ParseBlock(Weak<CodeBlock> block) {
+	Weak<InstructionBlock> current = block->mainBlock;
+
+	while (true) {
+		if (token.type == TokenType::Indent) {
+			Advance();
+			current->AddInstruction(ParseInstruction());
+			EndLine();
+		}
+		else if (token.type == TokenType::Name) {
+			Ptr<InstructionBlock> sub = program->New<InstructionBlock>(GetName(token));
+			current = sub;
+			block->AddInstructionBlock(sub);
+
+			Advance();
+			Expect(TokenType::Colon, "':'");
+			EndLine();
+		}
+		else if (token.type == TokenType::Newline) {
+			Advance();
+			return;
+		}
+		else if (token.type == TokenType::End) {
+			return;
+		}
+		else {
+			Error("expected instruction or label");
+		}
+	}
+}
+
+Ptr<Instruction> Parser::ParseInstruction() {
+	if (token.type == TokenType::Name) {
+		if (token.text == "ret") {
+			TokenType next = Peek().type;
+
+			if (next == TokenType::Newline || next == TokenType::End) {
+				Advance();
+				return program->New<ReturnInstruction>();
+			}
+		}
+		else if (IsKeyword("goto")) {
+			Advance();
+			return program->New<GotoInstruction>(GetName(Expect(TokenType::Name, "label")));
+		}
+		else if (IsKeyword("if")) {
+			return ParseIf();
+		}
+		else if (IsKeyword("call")) {
+			return program->New<CallInstruction>(ParseCall());
+		}
+		else if (IsKeyword("free")) {
+			Advance();
+			return program->New<FreeInstruction>(ParseValue(TypeHint()));
+		}
+		else if (IsKeyword("destroy")) {
+			Advance();
+			return program->New<DestroyInstruction>(ParseValue(TypeHint()));
+		}
+		else if (IsKeyword("_print")) {
+			return ParsePrint();
+		}
+		else if (IsKeyword("copy") || IsKeyword("fill") || IsKeyword("move")) {
+			std::string_view op = token.text;
+			Advance();
+
+			Ptr<Value> dst = ParseValue(TypeHint());
+			Expect(TokenType::Comma, "','");
+			Ptr<Value> src = ParseValue(TypeHint());
+			Expect(TokenType::Comma, "','");
+			Ptr<Value> size = ParseValue(TypeHint());
+
+			if (op == "copy") return program->New<CopyInstruction>(dst, src, size);
+			if (op == "fill") return program->New<FillInstruction>(dst, src, size);
+			return program->New<MoveInstruction>(dst, src, size);
+		}
+	}
+
+	return ParseAssign();
+}
+
+Ptr<Instruction> Parser::ParseAssign() {
+	List<Optional<Type>> types;
+
+	if (IsTyped()) {
+		do {
+			if (!types.IsEmpty()) Advance();
+
+			if (token.type == TokenType::Underscore) {
+				Advance();
+				types.Add(nullptr);
+			}
+			else {
+				types.Add(ParseType());
+			}
+		}
+		while (token.type == TokenType::Comma);
+
+		Expect(TokenType::Colon, "':'");
+	}
+
+	List<Ptr<Variable>> vars;
+	List<Weak<Variable>> weakVars;
+
+	do {
+		if (!vars.IsEmpty()) Advance();
+
+		Ptr<Variable> var = ParseVariable();
+		weakVars.Add(var);
+
+		if (token.type == TokenType::LeftBracket && types.IsEmpty() && weakVars.Count() == 1) {
+			Advance();
+
+			Optional<Type> offsetType = nullptr;
+
+			if (IsOffsetType()) {
+				offsetType = ParseType();
+			}
+
+			Ptr<Value> offset = ParseValue(TypeHint());
+			Expect(TokenType::RightBracket, "']'");
+			Expect(TokenType::Assign, "'='");
+
+			Ptr<Expression> expression = ParseExpression(offsetType ? HintOf(*offsetType) : TypeHint());
+
+			if (offsetType) {
+				return program->New<OffsetAssignInstruction>(var, expression, *offsetType, offset);
+			}
+
+			Ptr<OffsetAssignInstruction> assign = program->New<OffsetAssignInstruction>(var, expression, 0u);
+			assign->offset = offset;
+			return assign;
+		}
+
+		vars.Add(var);
+	}
+	while (token.type == TokenType::Comma);
+
+	if (types.Count() > 1 && types.Count() != vars.Count()) {
+		Error("expected " + String::ToString(vars.Count()) + " types");
+	}
+
+	List<TypeHint> hints;
+
+	for (UInt i = 0; i < weakVars.Count(); i++) {
+		if (!types.IsEmpty()) {
+			const Optional<Type>& type = types[types.Count() == 1 ? 0 : i];
+
+			if (type) {
+				if (weakVars[i]->Kind() == NodeKind::Variable) {
+					Declare(weakVars[i]->name, *type);
+				}
+
+				hints.Add(HintOf(*type));
+				continue;
+			}
+		}
+
+		hints.Add(HintOf(Weak<Value>(weakVars[i])));
+	}
+
+	List<Ptr<Expression>> expressions;
+
+	if (token.type == TokenType::Assign) {
+		do {
+			Advance();
+			expressions.Add(ParseExpression(hints[expressions.Count() < hints.Count() ? expressions.Count() : hints.Count() - 1]));
+		}
+		while (token.type == TokenType::Comma);
+	}
+
+	if (vars.Count() == 1 && types.Count() <= 1 && expressions.Count() <= 1) {
+		Ptr<Expression> expression = expressions.IsEmpty() ? Ptr<Expression>() : expressions[0];
+
+		if (types.IsEmpty() || !types[0]) {
+			if (!expression) {
+				Error("expected '='");
+			}
+
+			return program->New<AssignInstruction>(vars[0], expression);
+		}
+
+		return program->New<AssignInstruction>(*types[0], vars[0], expression);
+	}
+
+	return program->New<MultiAssignInstruction>(types, vars, expressions);
+}
+
+Ptr<Instruction> Parser::ParseIf() {
+	Advance();
+
+	Ptr<Expression> condition = ParseExpression(TypeHint());
+	Expect(TokenType::Colon, "':'");
+
+	Optional<String> labels[2] = {nullptr, nullptr};
+
+	for (UInt i = 0; i < 2; i++) {
+		if (i > 0) {
+			if (token.type != TokenType::Comma) break;
+			Advance();
+		}
+
+		if (token.type == TokenType::Underscore) {
+			Advance();
+		}
+		else {
+			labels[i] = GetName(Expect(TokenType::Name, "label"));
+		}
+	}
+
+	return program->New<IfInstruction>(condition, labels[0], labels[1]);
+}
+
+Ptr<Instruction> Parser::ParsePrint() {
+	Advance();
+
+	Optional<String> type = nullptr;
+
+	if (IsKeyword("str") || IsKeyword("chr")) {
+		type = ToString(token.text);
+		Advance();
+	}
+
+	Ptr<DebugPrintInstruction> print = program->New<DebugPrintInstruction>(ParseValue(TypeHint()));
+	print->type = type;
+	return print;
+}
+
+Ptr<Expression> Parser::ParseExpression(const TypeHint& hint) {
+	if (token.type == TokenType::Name) {
+		if (IsKeyword("call")) {
+			return ParseCall();
+		}
+		else if (IsKeyword("alloc")) {
+			return ParseAlloc(false);
+		}
+		else if (IsKeyword("stackalloc")) {
+			return ParseAlloc(true);
+		}
+		else if (token.text == "region" && !InScope(token)) {
+			Advance();
+			return program->New<RegionExpression>();
+		}
+		else if (IsKeyword("compare")) {
+			Advance();
+
+			Ptr<Value> value1 = ParseValue(TypeHint());
+			Expect(TokenType::Comma, "','");
+			Ptr<Value> value2 = ParseValue(TypeHint());
+			Expect(TokenType::Comma, "','");
+			return program->New<CompareExpression>(value1, value2, ParseValue(TypeHint()));
+		}
+		else if (IsKeyword("neg")) {
+			Advance();
+			return program->New<NegExpression>(ParseValue(hint));
+		}
+		else if (IsKeyword("not")) {
+			Advance();
+			return program->New<BitNotExpression>(ParseValue(hint));
+		}
+		else if (IsKeyword(token.text)) {
+			if (Ptr<Expression> expression = ParseBinary(token.text, hint)) {
+				return expression;
+			}
+		}
+	}
+
+	if (token.type == TokenType::Name || token.type == TokenType::Star) {
+		Ptr<Variable> var = ParseVariable();
+
+		if (token.type == TokenType::LeftBracket) {
+			return ParseOffset(var, hint);
+		}
+
+		return var;
+	}
+
+	return ParseValue(hint);
+}
+
+Ptr<CallExpression> Parser::ParseCall() {
+	Advance();
+
+	Ptr<CallExpression> call;
+
+	// Names that are not variables are function names
+	if (token.type == TokenType::Name && !InScope(token) && Peek().type != TokenType::Dot) {
+		call = program->New<CallExpression>(GetName(token));
+		Advance();
+	}
+	else {
+		call = program->New<CallExpression>(ParseVariable());
+	}
+
+	Weak<CallExpression> weakCall = call;
+
+	Expect(TokenType::LeftParen, "'('");
+
+	while (token.type != TokenType::RightParen) {
+		if (weakCall->args.Count() > 0) {
+			Expect(TokenType::Comma, "',' or ')'");
+		}
+
+		TypeHint hint;
+
+		if (!weakCall->funcPtr) {
+			hint.call  = weakCall;
+			hint.index = weakCall->args.Count();
+		}
+
+		weakCall->args.Add(ParseValue(hint));
+	}
+
+	Advance();
+	return call;
+}
+
+Ptr<Expression> Parser::ParseAlloc(bool stack) {
+	Advance();
+
+	Ptr<Expression> alloc;
+
+	if (token.type == TokenType::Integer) {
+		UInt size = (UInt)GetInteger(token);
+		Advance();
+
+		if (stack) alloc = program->New<StackAllocExpression>(size);
+		else alloc = program->New<AllocExpression>(size);
+	}
+	else if (token.type == TokenType::Star || (token.type == TokenType::Name && (InScope(token) || Peek().type == TokenType::Dot))) {
+		if (stack) alloc = program->New<StackAllocExpression>(ParseVariable());
+		else alloc = program->New<AllocExpression>(ParseVariable());
+	}
+	else {
+		if (stack) alloc = program->New<StackAllocExpression>(ParseType());
+		else alloc = program->New<AllocExpression>(ParseType());
+	}
+
+	if (!stack && IsKeyword("in")) {
+		Advance();
+		cast<AllocExpression>(alloc)->region = ParseVariable();
+	}
+
+	return alloc;
+}
+
+Ptr<Expression> Parser::ParseOffset(Ptr<Variable> var, const TypeHint& hint) {
+	Advance();
+
+	Optional<Type> offsetType = nullptr;
+
+	if (IsOffsetType()) {
+		offsetType = ParseType();
+	}
+
+	Ptr<Value> offset = ParseValue(TypeHint());
+	Expect(TokenType::RightBracket, "']'");
+
+	// The result type is not part of the text so it is taken from the assigned variable
+	const Type& type = hint.type ? *hint.type : offsetType ? *offsetType : u8;
+
+	if (offsetType) {
+		return program->New<OffsetExpression>(var, type, *offsetType, offset);
+	}
+
+	return program->New<OffsetExpression>(var, type, offset);
+}
+
+Ptr<Expression> Parser::ParseBinary(std::string_view op, const TypeHint& hint) {
+	static const std::unordered_map<std::string_view, NodeKind> operators = {
+		{"add", NodeKind::AddExpression},
+		{"sub", NodeKind::SubExpression},
+		{"mul", NodeKind::MulExpression},
+		{"div", NodeKind::DivExpression},
+		{"mod", NodeKind::ModExpression},
+		{"or",  NodeKind::BitOrExpression},
+		{"and", NodeKind::BitAndExpression},
+		{"xor", NodeKind::BitXorExpression},
+		{"shl", NodeKind::LeftShiftExpression},
+		{"shr", NodeKind::RightShiftExpression},
+		{"eq",  NodeKind::EqualExpression},
+		{"ne",  NodeKind::NotEqualExpression},
+		{"lt",  NodeKind::LessExpression},
+		{"gt",  NodeKind::GreaterExpression},
+		{"le",  NodeKind::LessEqualExpression},
+		{"ge",  NodeKind::GreaterEqualExpression}
+	};
+
+	auto it = operators.find(op);
+
+	if (it == operators.end()) return nullptr;
+
+	Advance();
+
+	// A literal gets the type of the other operand if the result type is not known
+	bool known = hint.type || hint.var || hint.call;
+
+	Ptr<Value> value1 = ParseValue(TypeHint());
+	Weak<Value> weak1 = value1;
+	Expect(TokenType::Comma, "','");
+
+	Ptr<Value> value2 = ParseValue(known || isa<Integer>(weak1) ? hint : HintOf(weak1));
+	Weak<Value> weak2 = value2;
+
+	if (Weak<Integer> integer = dyn_cast<Integer>(weak1)) {
+		Infer(integer, known || isa<Integer>(weak2) ? hint : HintOf(weak2));
+	}
+
+	switch (it->second) {
+		case NodeKind::AddExpression:          return program->New<AddExpression>(value1, value2);
+		case NodeKind::SubExpression:          return program->New<SubExpression>(value1, value2);
+		case NodeKind::MulExpression:          return program->New<MulExpression>(value1, value2);
+		case NodeKind::DivExpression:          return program->New<DivExpression>(value1, value2);
+		case NodeKind::ModExpression:          return program->New<ModExpression>(value1, value2);
+		case NodeKind::BitOrExpression:        return program->New<BitOrExpression>(value1, value2);
+		case NodeKind::BitAndExpression:       return program->New<BitAndExpression>(value1, value2);
+		case NodeKind::BitXorExpression:       return program->New<BitXorExpression>(value1, value2);
+		case NodeKind::LeftShiftExpression:    return program->New<LeftShiftExpression>(value1, value2);
+		case NodeKind::RightShiftExpression:   return program->New<RightShiftExpression>(value1, value2);
+		case NodeKind::EqualExpression:        return program->New<EqualExpression>(value1, value2);
+		case NodeKind::NotEqualExpression:     return program->New<NotEqualExpression>(value1, value2);
+		case NodeKind::LessExpression:         return program->New<LessExpression>(value1, value2);
+		case NodeKind::GreaterExpression:      return program->New<GreaterExpression>(value1, value2);
+		case NodeKind::LessEqualExpression:    return program->New<LessEqualExpression>(value1, value2);
+		default:                               return program->New<GreaterEqualExpression>(value1, value2);
+	}
+}
+
+Ptr<Value> Parser::ParseValue(const TypeHint& hint) {
+	switch (token.type) {
+		case TokenType::Integer: {
+			Long value = GetInteger(token);
+			Advance();
+
+			Ptr<Integer> integer = program->New<Integer>(value >= -0x80000000LL && value <= 0x7FFFFFFFLL ? i32 : i64, value);
+			Infer(integer, hint);
+			return integer;
+		}
+
+		case TokenType::String: {
+			Ptr<StringValue> str = program->New<StringValue>(GetString(token));
+			Advance();
+			return str;
+		}
+
+		case TokenType::Ampersand: {
+			Advance();
+			return program->New<RefValue>(ParseVariable());
+		}
+
+		case TokenType::Name:
+		case TokenType::Star: {
+			return ParseVariable();
+		}
+
+		default: {
+			Error("expected value");
+		}
+	}
+}
+
+Ptr<Variable> Parser::ParseVariable() {
+	Ptr<Variable> var;
+
+	if (token.type == TokenType::Star) {
+		Advance();
+		var = program->New<DerefVariable>(GetName(Expect(TokenType::Name, "variable name")));
+	}
+	else {
+		var = program->New<Variable>(GetName(Expect(TokenType::Name, "variable name")));
+	}
+
+	while (token.type == TokenType::Dot) {
+		Advance();
+		var = program->New<SubVariable>(var, GetName(Expect(TokenType::Name, "variable name")));
+	}
+
+	return var;
+}
+
+Type Parser::ParseType() {
+	Token name = Expect(TokenType::Name, "type");
+
+	auto it = types.find(name.text);
+
+	if (it == types.end()) {
+		it = types.emplace(name.text, Type(GetName(name))).first;
+	}
+
+	Type type = it->second;
+
+	// Array lengths and pointers are written without spaces
+	if (token.type == TokenType::LeftBracket && !token.space) {
+		Advance();
+		type.len = (UInt)GetInteger(Expect(TokenType::Integer, "array length"));
+		Expect(TokenType::RightBracket, "']'");
+	}
+
+	while (token.type == TokenType::Star && !token.space) {
+		type.pointers++;
+		Advance();
+	}
+
+	return type;
+}
+
+bool Parser::IsKeyword(std::string_view keyword) {
+	if (token.type != TokenType::Name || token.text != keyword) return false;
+
+	Token next = Peek();
+
+	if (!next.space) return false;
+
+	switch (next.type) {
+		case TokenType::Name:
+		case TokenType::Integer:
+		case TokenType::String:
+		case TokenType::Ampersand:
+		case TokenType::Star:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+bool Parser::IsTyped() {
+	Lexer ahead = lexer;
+
+	for (Token t = token; t.type != TokenType::Newline && t.type != TokenType::End && t.type != TokenType::Assign; t = ahead.Next()) {
+		if (t.type == TokenType::Colon) return true;
+	}
+
+	return false;
+}
+
+bool Parser::IsOffsetType() {
+	if (token.type != TokenType::Name) return false;
+
+	// A type is followed by the offset value
+	Lexer ahead = lexer;
+	Token t = ahead.Next();
+
+	if (t.type == TokenType::LeftBracket && !t.space) {
+		ahead.Next();
+		ahead.Next();
+		t = ahead.Next();
+	}
+
+	while (t.type == TokenType::Star && !t.space) {
+		t = ahead.Next();
+	}
+
+	return t.space && t.type != TokenType::RightBracket;
+}
+
+bool Parser::InScope(const Token& token) const {
+	return scope.find(token.text) != scope.end();
+}
+
+Parser::TypeHint Parser::HintOf(Weak<Value> value) const {
+	TypeHint hint;
+
+	Weak<Variable> var = dyn_cast<Variable>(value);
+
+	if (!var) return hint;
+
+	Weak<Variable> base = var;
+
+	while (Weak<SubVariable> sub = dyn_cast<SubVariable>(base)) {
+		base = sub->var;
+	}
+
+	auto it = scope.find(ToView(base->name));
+
+	if (it == scope.end()) return hint;
+
+	if (var->Kind() == NodeKind::Variable) {
+		hint.type = &it->second;
+	}
+	else {
+		hint.var  = var;
+		hint.base = &it->second;
+	}
+
+	return hint;
+}
+
+Parser::TypeHint Parser::HintOf(const Type& type) const {
+	TypeHint hint;
+	hint.type = &type;
+	return hint;
+}
+
+void Parser::Infer(Weak<Integer> value, const TypeHint& hint) {
+	if (hint.type) {
+		if (Fits(value->value, *hint.type)) {
+			value->type = *hint.type;
+		}
+	}
+	else if (hint.var && !isa<SubVariable>(hint.var)) {
+		Optional<Type> type = VarType(hint.var, *hint.base);
+
+		if (type && Fits(value->value, *type)) {
+			value->type = *type;
+		}
+	}
+	else if (hint.var || hint.call) {
+		// Struct members and function arguments are only known after the whole file is parsed
+		Fixup fixup;
+		fixup.value = value;
+		fixup.var   = hint.var;
+		fixup.call  = hint.call;
+		fixup.index = hint.index;
+
+		if (hint.base) {
+			fixup.base = *hint.base;
+		}
+
+		fixups.Add(fixup);
+	}
+}
+
+void Parser::ResolveFixups() {
+	for (const Fixup& fixup : fixups) {
+		Optional<Type> type = nullptr;
+
+		if (fixup.var) {
+			type = VarType(fixup.var, fixup.base);
+		}
+		else if (weakProgram->functions.Contains(fixup.call->func)) {
+			Weak<Function> function = weakProgram->functions[fixup.call->func];
+
+			if (fixup.index < function->arguments.Count()) {
+				type = function->arguments[fixup.index].value1;
+			}
+		}
+
+		if (type && Fits(fixup.value->value, *type)) {
+			fixup.value->type = *type;
+		}
+	}
+}
+
+Optional<Type> Parser::VarType(Weak<Variable> var, const Type& base) const {
+	if (Weak<SubVariable> sub = dyn_cast<SubVariable>(var)) {
+		Optional<Type> type = VarType(sub->var, base);
+
+		if (!type) return nullptr;
+
+		if (Weak<Struct> struct_ = weakProgram->types.GetStruct(type->id)) {
+			return struct_->VarType(sub->name);
+		}
+
+		return nullptr;
+	}
+
+	Type type = base;
+
+	if (isa<DerefVariable>(var)) {
+		if (type.pointers == 0) return nullptr;
+		type.pointers--;
+	}
+
+	return type;
+}
+
+void Parser::Declare(const String& name, const Type& type) {
+	// The key has to be a view into the source
+	scope[names.find(ToView(name))->first] = type;
+}
+
+void Parser::Advance() {
+	token = lexer.Next();
+}
+
+Token Parser::Peek() const {
+	Lexer ahead = lexer;
+	return ahead.Next();
+}
+
+Token Parser::Expect(TokenType type, const char* name) {
+	if (token.type != type) {
+		Error("expected " + String(name));
+	}
+
+	Token t = token;
+	Advance();
+	return t;
+}
+
+void Parser::EndLine() {
+	if (token.type == TokenType::Newline) {
+		Advance();
+	}
+	else if (token.type != TokenType::End) {
+		Error("expected end of line");
+	}
+}
+
+const String& Parser::GetName(const Token& token) {
+	auto it = names.find(token.text);
+
+	if (it == names.end()) {
+		it = names.emplace(token.text, ToString(token.text)).first;
+	}
+
+	return it->second;
+}
+
+String Parser::GetString(const Token& token) {
+	if (token.text.find('\\') == std::string_view::npos) {
+		return ToString(token.text);
+	}
+
+	std::string str;
+	str.reserve(token.text.size());
+
+	for (size_t i = 0; i < token.text.size(); i++) {
+		char c = token.text[i];
+
+		if (c != '\\' || i + 1 >= token.text.size()) {
+			str += c;
+			continue;
+		}
+
+		c = token.text[++i];
+
+		switch (c) {
+			case 'n': str += '\n'; break;
+			case 't': str += '\t'; break;
+			case 'r': str += '\r'; break;
+			case '0': str += '\0'; break;
+
+			case 'x': {
+				UInt value = 0;
+				UInt digits = 0;
+
+				for (; digits < 2 && i + 1 < token.text.size(); digits++) {
+					char h = token.text[i + 1];
+
+					if      (h >= '0' && h <= '9') value = value * 16 + (h - '0');
+					else if (h >= 'a' && h <= 'f') value = value * 16 + (h - 'a' + 10);
+					else if (h >= 'A' && h <= 'F') value = value * 16 + (h - 'A' + 10);
+					else break;
+
+					i++;
+				}
+
+				if (digits == 0) Error("invalid escape sequence in string");
+
+				str += (char)value;
+				break;
+			}
+
+			default: str += c; break;
+		}
+	}
+
+	return String(str.data(), (UInt)str.size());
+}
+
+Long Parser::GetInteger(const Token& token) {
+	bool negative = token.text[0] == '-';
+	ULong max = negative ? 0x8000000000000000ULL : 0x7FFFFFFFFFFFFFFFULL;
+	ULong value = 0;
+
+	for (size_t i = negative ? 1 : 0; i < token.text.size(); i++) {
+		ULong digit = token.text[i] - '0';
+
+		if (value > (max - digit) / 10) {
+			Error("integer '" + ToString(token.text) + "' is too large");
+		}
+
+		value = value * 10 + digit;
+	}
+
+	return negative ? (Long)(0 - value) : (Long)value;
+}
+
+void Parser::Error(const String& message) const {
+	String where = filename.IsEmpty() ? String() : filename + ":";
+
+	if (token.type == TokenType::Invalid) {
+		throw KiwiParseError(where + String::ToString(token.line) + ": unexpected '" + ToString(token.text) + "'");
+	}
+
+	throw KiwiParseError(where + String::ToString(token.line) + ": " + message);
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <string_view>
+#include <unordered_map>
+
+#include "Boxx/Boxx/String.h"
+#include "Boxx/Boxx/List.h"
+#include "Boxx/Boxx/Array.h"
+#include "Boxx/Boxx/Error.h"
+
+#include "KiwiProgram.h"
+
+///N Kiwi
+
+namespace Kiwi {
+	/// Error for parsing.
+	class KiwiParseError : public Boxx::Error {
+	public:
+		KiwiParseError() : Boxx::Error() {}
+		KiwiParseError(const char* const msg) : Boxx::Error(msg) {}
+
+		virtual Boxx::String Name() const override {
+			return "KiwiParseError";
+		}
+	};
+
+	/// The types of tokens.
+	enum class TokenType : Boxx::UByte {
+		///T Values
+		///M
+		End,
+		Invalid,
+		Newline,
+		Indent,
+		Name,
+		Integer,
+		String,
+		Underscore,
+		Colon,
+		Comma,
+		Assign,
+		LeftParen,
+		RightParen,
+		LeftBracket,
+		RightBracket,
+		Star,
+		Ampersand,
+		Dot
+		///M
+	};
+
+	/// A token.
+	struct Token {
+		/// The token type.
+		TokenType type = TokenType::End;
+
+		/// The text of the token.
+		///
+		/// The text is a view into the source.
+		/// Names do not include backticks or {@} and strings do not include the quotes.
+		std::string_view text;
+
+		/// The line of the token.
+		Boxx::UInt line = 1;
+
+		/// {true} if the token is preceded by whitespace.
+		bool space = false;
+	};
+
+	/// Splits the text format written by {KiwiProgram::BuildString} into tokens.
+	///
+	/// A tab at the start of a line is an {Indent} token and other whitespace is skipped.
+	/// The lexer only holds a position in the source so it can be copied to look ahead.
+	class Lexer {
+	public:
+		Lexer(std::string_view source, Boxx::UInt line = 1) {
+			pos = source.data();
+			end = source.data() + source.size();
+			this->line = line;
+		}
+
+		/// Reads the next token.
+		Token Next();
+
+	private:
+		const char* pos;
+		const char* end;
+		Boxx::UInt line = 1;
+		bool lineStart = true;
+	};
+
+	/// Parses programs in the text format written by {KiwiProgram::BuildString}.
+	///
+	/// Tokens are views into the source and each distinct name is only copied once.
+	/// All nodes are created in the arena of the program.
+	///
+	/// Integer literals do not have a type in the text format.
+	/// A literal gets the type of the variable it is assigned to, the type of the other operand of a binary expression
+	/// or the type of the function argument it is passed to.
+	/// Other literals are {i32} if the value fits and {i64} otherwise.
+	///
+	/// Large sources are split at empty lines followed by a new section and the parts are parsed on separate threads.
+	/// The parts are then linked in source order so the result does not depend on the threads.
+	/// Lowering the program to bytecode is not parallel since it shares the nodes and strings of the whole program.
+	class Parser {
+	public:
+		/// The minimum byte size of a part of the source that is parsed on its own thread.
+		static constexpr Boxx::UInt minChunkSize = 256 * 1024;
+
+		/// Parses a file.
+		///
+		/// The file is mapped into memory instead of being read.
+		/// {threads} is the maximum number of threads to use or {0} to use one thread per core.
+		static Ptr<KiwiProgram> ParseFile(const Boxx::String& filename, Boxx::UInt threads = 0);
+
+		/// Parses text.
+		///
+		/// {filename} is only used for error messages.
+		/// {threads} is the maximum number of threads to use or {0} to use one thread per core.
+		static Ptr<KiwiProgram> Parse(std::string_view source, const Boxx::String& filename = "", Boxx::UInt threads = 0);
+
+	private:
+		/// A part of the source that starts at the top level.
+		struct Chunk {
+			std::string_view source;
+			Boxx::UInt line = 1;
+
+			/// A copy of the file name that is only used by the thread that parses the part.
+			Boxx::String filename;
+		};
+
+		/// Where an integer literal gets its type from.
+		///
+		/// Hints point to types owned by the parser or the caller so they are cheap to pass around.
+		struct TypeHint {
+			/// The type if it is known.
+			const Type* type = nullptr;
+
+			/// A variable and the type of the variable it is based on.
+			Weak<Variable> var;
+			const Type* base = nullptr;
+
+			/// A call with an argument type that is known when all functions are parsed.
+			Weak<CallExpression> call;
+			Boxx::UInt index = 0;
+		};
+
+		/// A literal with a type that is known when all structs and functions are parsed.
+		struct Fixup {
+			Weak<Integer> value;
+			Weak<Variable> var;
+			Type base;
+			Weak<CallExpression> call;
+			Boxx::UInt index = 0;
+		};
+
+		Parser(std::string_view source, const Boxx::String& filename, Boxx::UInt line = 1);
+
+		static Boxx::List<Chunk> Split(std::string_view source, Boxx::UInt chunkSize);
+		static Ptr<KiwiProgram> Link(Boxx::Array<Ptr<Parser>>& parsers);
+
+		Lexer lexer;
+		Token token;
+		Boxx::String filename;
+
+		Ptr<KiwiProgram> program;
+		Weak<KiwiProgram> weakProgram;
+
+		std::unordered_map<std::string_view, Boxx::String> names;
+		std::unordered_map<std::string_view, Type> types;
+		std::unordered_map<std::string_view, Type> scope;
+		Boxx::List<Fixup> fixups;
+
+		Type u8, i32, i64;
+
+		/// The pointer size set by the source or {0} if it is not set.
+		Boxx::UInt pointerSize = 0;
+
+		void ParseProgram();
+		void ParseCode();
+		void ParseFunction();
+		void ParseStruct();
+		void ParseStatic();
+		void ParsePointerSize();
+		void ParseBlock(Weak<CodeBlock> block);
+
+		Ptr<Instruction> ParseInstruction();
+		Ptr<Instruction> ParseAssign();
+		Ptr<Instruction> ParseIf();
+		Ptr<Instruction> ParsePrint();
+
+		Ptr<Expression> ParseExpression(const TypeHint& hint);
+		Ptr<CallExpression> ParseCall();
+		Ptr<Expression> ParseAlloc(bool stack);
+		Ptr<Expression> ParseOffset(Ptr<Variable> var, const TypeHint& hint);
+		Ptr<Expression> ParseBinary(std::string_view op, const TypeHint& hint);
+
+		Ptr<Value> ParseValue(const TypeHint& hint);
+		Ptr<Variable> ParseVariable();
+		Type ParseType();
+
+		bool IsKeyword(std::string_view keyword);
+		bool IsTyped();
+		bool IsOffsetType();
+		bool InScope(const Token& token) const;
+
+		TypeHint HintOf(Weak<Value> value) const;
+		TypeHint HintOf(const Type& type) const;
+		void Infer(Weak<Integer> value, const TypeHint& hint);
+		void ResolveFixups();
+		Boxx::Optional<Type> VarType(Weak<Variable> var, const Type& base) const;
+		void Declare(const Boxx::String& name, const Type& type);
+
+		void Advance();
+		Token Peek() const;
+		Token Expect(TokenType type, const char* name);
+		void EndLine();
+
+		const Boxx::String& GetName(const Token& token);
+		Boxx::String GetString(const Token& token);
+		Boxx::Long GetInteger(const Token& token);
+
+		[[noreturn]] void Error(const Boxx::String& message) const;
+	};
+}
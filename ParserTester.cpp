@@ -0,0 +1,102 @@
+#include "ParserTester.h"
+
+#include "KiwiProgram.h"
+#include "Module.h"
+#include "Writer.h"
+
+#include "Boxx/Boxx/StringBuilder.h"
+#include "Boxx/Boxx/Console.h"
+
+using namespace Boxx;
+
+using namespace Kiwi;
+
+static std::string_view ToView(const String& str) {
+	return std::string_view((const char*)str, str.Length());
+}
+
+bool ParserTester::Run() {
+	bool passed = true;
+
+	String source = LargeSource("f", 5000);
+	passed &= TestParallel("functions", ToView(source), false);
+
+	String pointers = "pointer 4\n\nstruct aligned Node:\n\tu8: tag\n\tNode*: next\n\n" + LargeSource("f", 5000);
+	passed &= TestParallel("pointer size", ToView(pointers), false);
+
+	String lastError = LargeSource("f", 5000) + "\ncode:\n\ti32: x = %\n";
+	passed &= TestParallel("error in the last part", ToView(lastError), true);
+
+	String firstError = LargeSource("f", 2500) + "\ncode:\n\tx = y z\n\n" + LargeSource("g", 2500) + "\ncode:\n\ti32: x = %\n";
+	passed &= TestParallel("first of several errors", ToView(firstError), true);
+
+	return passed;
+}
+
+bool ParserTester::TestParallel(const String& name, std::string_view source, bool fails, UInt threads) {
+	if (source.size() < 2 * Parser::minChunkSize) {
+		Console::Print(name + ": the source is too small to be split");
+		return false;
+	}
+
+	String serial, parallel;
+	std::vector<UByte> serialModule, parallelModule;
+
+	if (Parse(source, 1, serial, serialModule) == fails) {
+		Console::Print(name + ": " + serial);
+		return false;
+	}
+
+	Parse(source, threads, parallel, parallelModule);
+
+	if (serial != parallel || serialModule != parallelModule) {
+		Console::Print(name + ": the parallel parse is different from the serial parse");
+		return false;
+	}
+
+	return true;
+}
+
+String ParserTester::LargeSource(const String& prefix, UInt count) {
+	StringBuilder builder;
+
+	for (UInt i = 0; i < count; i++) {
+		String function = prefix + String::ToString(i);
+		String next     = prefix + String::ToString(i + 1 < count ? i + 1 : 0);
+
+		builder += "function i64: r " + function + "(i32: a, i64: b):\n";
+		builder += "\tLate: v\n";
+		builder += "\tv.x = 300\n";
+		builder += "\tv.y = add b, 5000000000\n";
+		builder += "\tif lt a, 10: small\n";
+		builder += "\tr = call " + next + "(1, 2)\n";
+		builder += "\tret\n";
+		builder += "small:\n";
+		builder += "\tr = v.y\n\n";
+	}
+
+	builder += "struct Late:\n";
+	builder += "\ti16: x\n";
+	builder += "\ti64: y\n\n";
+
+	builder += "static " + prefix + "Data:\n";
+	builder += "\tu64: first = " + prefix + "0\n\n";
+
+	return builder.ToString();
+}
+
+bool ParserTester::Parse(std::string_view source, UInt threads, String& result, std::vector<UByte>& module) {
+	try {
+		Ptr<KiwiProgram> program = Parser::Parse(source, "test", threads);
+
+		StringWriter writer;
+		program->BuildString(writer);
+		result = writer.ToString();
+		module = ModuleWriter::Write(program);
+		return true;
+	}
+	catch (Error& e) {
+		result = e.Name() + ": " + e.Message();
+		return false;
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+#include "Boxx/Boxx/String.h"
+
+#include "Parser.h"
+
+///N Kiwi
+
+namespace Kiwi {
+	/// Tests that parsing a source on several threads gives the same result as parsing it on one thread.
+	class ParserTester {
+	public:
+		/// Runs all parser tests and prints the failed tests.
+		///
+		/// Run the interpreter with {--test} to call this.
+		///R bool: {true} if all tests passed.
+		static bool Run();
+
+		/// Parses a source on one thread and on {threads} threads.
+		///
+		/// The printed programs and the modules are compared if both parses succeed and the errors are compared if they fail.
+		/// The modules include the types that integer literals get from declarations in other parts of the source.
+		/// The source has to be large enough to be split.
+		/// {fails} is {true} if the source has errors.
+		///R bool: {true} if the results are the same.
+		static bool TestParallel(const Boxx::String& name, std::string_view source, bool fails, Boxx::UInt threads = 4);
+
+		/// Creates a source with {count} functions named {prefix} followed by a number.
+		///
+		/// The functions use a struct and a function that are declared in later parts of the source.
+		static Boxx::String LargeSource(const Boxx::String& prefix, Boxx::UInt count);
+
+	private:
+		/// Parses a source and gets the printed program and the module or the error.
+		///R bool: {true} if the source was parsed.
+		static bool Parse(std::string_view source, Boxx::UInt threads, Boxx::String& result, std::vector<Boxx::UByte>& module);
+	};
+}
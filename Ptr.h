@@ -2,6 +2,9 @@
 #define PTR_INCLUDE
 
 #include <utility>
+#include <new>
+#include <cstddef>
+#include <type_traits>
 
 template<class T, class U>
 concept PtrDerived = std::derived_from<T, U>;
@@ -12,6 +15,7 @@ concept PtrConvert = std::derived_from<T, U> || std::derived_from<U, T>;
 struct _Ref {
 	void* ptr;
 	int   ref;
+	bool  arena = false;
 
 	_Ref() : ptr(nullptr), ref(0) {}
 	_Ref(void* ptr): ptr(ptr), ref(0) {}
@@ -20,6 +24,7 @@ struct _Ref {
 
 struct _Ptr {
 	_Ref* ref;
+	bool  arena = false;
 
 	_Ptr() : ref(nullptr) {}
 	_Ptr(_Ref* ref) : ref(ref) {}
@@ -29,6 +34,8 @@ struct _Ptr {
 template <class T>
 class Weak;
 
+class PtrArena;
+
 template <class T>
 class Ptr {
 public:
@@ -84,7 +91,7 @@ public:
 
 	template <PtrConvert<T> Type>
 	bool Is() const {
-		return dynamic_cast<Type*>(ptr && ptr->ref ? (T*)ptr->ref->ptr : nullptr) != nullptr;
+		return Weak<T>::template IsType<Type>(ptr && ptr->ref ? (T*)ptr->ref->ptr : nullptr);
 	}
 
 	template <PtrConvert<T> Type>
@@ -199,33 +206,32 @@ private:
 	template <class U>
 	friend class Weak;
 
+	friend class PtrArena;
+
 	_Ptr* ptr = nullptr;
 
 	void FreeAll() {
 		if (ptr) {
-			if (ptr->ref) {
-				delete ptr->ref->ptr;
-				ptr->ref->ptr = nullptr;
-
-				if (ptr->ref->ref == 0) {
-					delete ptr->ref;
-				}
+			FreeInstance();
 
-				ptr->ref = nullptr;
+			if (!ptr->arena) {
+				delete ptr;
 			}
 
-			delete ptr;
 			ptr = nullptr;
 		}
 	}
 
+	// Arena objects are only released by their arena
 	void FreeInstance() {
 		if (ptr && ptr->ref) {
-			delete ptr->ref->ptr;
-			ptr->ref->ptr = nullptr;
+			if (!ptr->ref->arena) {
+				delete (T*)ptr->ref->ptr;
+				ptr->ref->ptr = nullptr;
 
-			if (ptr->ref->ref == 0) {
-				delete ptr->ref;
+				if (ptr->ref->ref == 0) {
+					delete ptr->ref;
+				}
 			}
 
 			ptr->ref = nullptr;
@@ -300,7 +306,7 @@ public:
 
 	template <PtrConvert<T> Type>
 	bool Is() const {
-		return dynamic_cast<Type*>(ref ? (T*)ref->ptr : nullptr) != nullptr;
+		return IsType<Type>(ref ? (T*)ref->ptr : nullptr);
 	}
 
 	template <PtrConvert<T> Type>
@@ -319,6 +325,30 @@ public:
 		return nullptr;
 	}
 
+	// Converts without checking the type
+	template <PtrConvert<T> Type>
+	Weak<Type> Cast() const {
+		Weak<Type> t = nullptr;
+		t.ref = ref;
+
+		if (t.ref) {
+			t.ref->ref++;
+		}
+
+		return t;
+	}
+
+	// Uses the classof of the type if it has one instead of dynamic_cast
+	template <PtrConvert<T> Type>
+	static bool IsType(T* object) {
+		if constexpr (requires (T* object) { Type::classof(object); }) {
+			return object && Type::classof(object);
+		}
+		else {
+			return dynamic_cast<Type*>(object) != nullptr;
+		}
+	}
+
 	void operator=(const Ptr<T>& ptr) {
 		Free();
 
@@ -392,6 +422,8 @@ private:
 	template <class U>
 	friend class Weak;
 
+	friend class PtrArena;
+
 	_Ref* ref;
 
 	void Free() {
@@ -407,4 +439,134 @@ private:
 	}
 };
 
+// Allocates objects together with their pointer data and releases them all at once.
+// Ptrs to arena objects do not own them and Weaks to them must not outlive the arena.
+class PtrArena {
+public:
+	static constexpr std::size_t chunkSize = 64 * 1024;
+
+	PtrArena() {}
+	PtrArena(const PtrArena&) = delete;
+
+	~PtrArena() {
+		Release();
+	}
+
+	PtrArena& operator=(const PtrArena&) = delete;
+
+	template <class T, class... Args>
+	Ptr<T> New(Args&&... args) {
+		Block<T>* block = (Block<T>*)Allocate(sizeof(Block<T>), alignof(Block<T>));
+		T* object = new (block->object) T(std::forward<Args>(args)...);
+
+		if constexpr (!std::is_trivially_destructible_v<T>) {
+			block->entry.object  = object;
+			block->entry.destroy = [](void* object) { ((T*)object)->~T(); };
+			block->entry.prev    = last;
+			last = &block->entry;
+
+			if (!first) first = last;
+		}
+
+		block->ref.ptr   = object;
+		block->ref.ref   = 0;
+		block->ref.arena = true;
+		block->ptr.ref   = &block->ref;
+		block->ptr.arena = true;
+
+		Ptr<T> ptr;
+		ptr.ptr = &block->ptr;
+		return ptr;
+	}
+
+	// Takes over all objects of another arena.
+	// Ptrs and Weaks to the objects stay valid.
+	void Adopt(PtrArena& other) {
+		if (other.last) {
+			other.first->prev = last;
+			last = other.last;
+
+			if (!first) first = other.first;
+		}
+
+		if (other.chunks) {
+			Chunk* tail = other.chunks;
+
+			while (tail->next) {
+				tail = tail->next;
+			}
+
+			tail->next = chunks;
+			chunks = other.chunks;
+		}
+
+		other.chunks = nullptr;
+		other.first  = nullptr;
+		other.last   = nullptr;
+		other.top    = nullptr;
+		other.end    = nullptr;
+	}
+
+	void Release() {
+		for (Entry* entry = last; entry; entry = entry->prev) {
+			entry->destroy(entry->object);
+		}
+
+		while (chunks) {
+			Chunk* next = chunks->next;
+			::operator delete(chunks);
+			chunks = next;
+		}
+
+		first = nullptr;
+		last  = nullptr;
+		top   = nullptr;
+		end   = nullptr;
+	}
+
+private:
+	struct Chunk {
+		Chunk* next;
+	};
+
+	struct Entry {
+		Entry* prev;
+		void*  object;
+		void   (*destroy)(void*);
+	};
+
+	template <class T>
+	struct Block {
+		Entry entry;
+		_Ref  ref;
+		_Ptr  ptr;
+		alignas(T) unsigned char object[sizeof(T)];
+	};
+
+	Chunk* chunks = nullptr;
+	Entry* first  = nullptr;
+	Entry* last   = nullptr;
+	char*  top    = nullptr;
+	char*  end    = nullptr;
+
+	void* Allocate(std::size_t size, std::size_t align) {
+		char* start = top ? (char*)(((std::size_t)top + align - 1) / align * align) : nullptr;
+
+		if (!start || start + size > end) {
+			std::size_t header = (sizeof(Chunk) + align - 1) / align * align;
+			std::size_t total  = header + size > chunkSize ? header + size : chunkSize;
+
+			Chunk* chunk = (Chunk*)::operator new(total);
+			chunk->next = chunks;
+			chunks = chunk;
+
+			start = (char*)chunk + header;
+			end   = (char*)chunk + total;
+		}
+
+		top = start + size;
+		return start;
+	}
+};
+
 #endif
@@ -1,23 +1,197 @@
 
 #include "Structs.h"
 
+#include <mutex>
+#include <shared_mutex>
+
 #include "KiwiProgram.h"
 
 using namespace Boxx;
 
 using namespace Kiwi;
 
-UInt Type::SizeOf(Type type, Weak<KiwiProgram> program) {
-	if (type.pointers > 0) return KiwiProgram::ptrSize;
+// Classifies a name as a plain word, a number or a name that needs backticks
+static UByte NameKind(const String& name) {
+	static constexpr UByte word = 1, digit = 2;
+
+	static const struct Table {
+		UByte kinds[256] = {};
+
+		Table() {
+			for (UInt c = 'a'; c <= 'z'; c++) kinds[c] = word;
+			for (UInt c = 'A'; c <= 'Z'; c++) kinds[c] = word;
+			for (UInt c = '0'; c <= '9'; c++) kinds[c] = word | digit;
+			kinds['_'] = word;
+		}
+	} table;
 
-	if (type.name == "u8"  || type.name == "i8" ) return 1 * type.len;
-	if (type.name == "u16" || type.name == "i16") return 2 * type.len;
-	if (type.name == "u32" || type.name == "i32") return 4 * type.len;
-	if (type.name == "u64" || type.name == "i64") return 8 * type.len;
+	const UByte* chars = (const UByte*)(const char*)name;
+	UByte kind = word | digit;
 
-	if (program->structs.Contains(type.name)) {
-		return program->structs[type.name]->Size(program) * type.len;
+	for (UInt i = 0; i < name.Length(); i++) {
+		kind &= table.kinds[chars[i]];
+	}
+
+	return name.Length() > 0 ? kind : 0;
+}
+
+String Name::ToKiwi(const String& name) {
+	switch (NameKind(name)) {
+		case 0:  return '`' + name + '`';
+		case 1:  return name;
+		default: return '@' + name;
+	}
+}
+
+String Name::ToKiwi(const String& name, UInt id) {
+	static List<String> names;
+	static std::mutex mutex;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	while (names.Count() <= id) {
+		names.Add(String());
+	}
+
+	// Converted names are never empty
+	if (names[id].Length() == 0) {
+		names[id] = ToKiwi(name);
+	}
+
+	return names[id];
+}
+
+void TypeTable::SetStruct(UInt id, Weak<Struct> struct_) {
+	while (structs.Count() <= id) {
+		structs.Add(nullptr);
+	}
+
+	structs[id] = struct_;
+}
+
+Weak<Struct> TypeTable::GetStruct(UInt id) const {
+	if (id >= structs.Count()) return nullptr;
+	return structs[id];
+}
+
+UInt Type::SizeOf(const Type& type, Weak<KiwiProgram> program) {
+	if (type.pointers > 0) return program->PointerSize();
+
+	if (type.id < TypeId::builtinCount) {
+		return Info(type.id).size * type.len;
+	}
+
+	if (Weak<Struct> struct_ = program->types.GetStruct(type.id)) {
+		return struct_->Size(program) * type.len;
 	}
 
 	return 0;
 }
+
+UInt Type::AlignOf(const Type& type, Weak<KiwiProgram> program) {
+	if (type.pointers > 0) return program->PointerSize();
+
+	if (type.id < TypeId::builtinCount) {
+		return Info(type.id).alignment;
+	}
+
+	if (Weak<Struct> struct_ = program->types.GetStruct(type.id)) {
+		return struct_->Alignment(program);
+	}
+
+	return 1;
+}
+
+UInt Type::IntegerId(const Type& type, Weak<KiwiProgram> program) {
+	if (type.pointers > 0) return program->PointerSize() == 4 ? TypeId::u32 : TypeId::u64;
+
+	if (type.id < TypeId::builtinCount && type.len == 1) {
+		return type.id;
+	}
+
+	switch (SizeOf(type, program)) {
+		case 1:  return TypeId::i8;
+		case 2:  return TypeId::i16;
+		case 4:  return TypeId::i32;
+		default: return TypeId::i64;
+	}
+}
+
+// Gets the fixed id of a built in type name or the empty name
+static bool FixedId(const String& name, UInt& id) {
+	const char* str = (const char*)name;
+
+	switch (name.Length()) {
+		case 0: {
+			id = TypeId::none;
+			return true;
+		}
+
+		case 2: {
+			if (str[1] != '8') return false;
+			id = TypeId::i8;
+			break;
+		}
+
+		case 3: {
+			if      (str[1] == '1' && str[2] == '6') id = TypeId::i16;
+			else if (str[1] == '3' && str[2] == '2') id = TypeId::i32;
+			else if (str[1] == '6' && str[2] == '4') id = TypeId::i64;
+			else return false;
+			break;
+		}
+
+		default: {
+			return false;
+		}
+	}
+
+	// Each unsigned id directly follows the signed id of the same size
+	if (str[0] == 'u') id++;
+	return str[0] == 'i' || str[0] == 'u';
+}
+
+UInt Type::Intern(const String& name) {
+	UInt id;
+
+	if (FixedId(name, id)) {
+		return id;
+	}
+
+	static Map<String, UInt> ids;
+
+	// Types are created by parser threads and almost all of them are already interned
+	static std::shared_mutex mutex;
+
+	{
+		std::shared_lock<std::shared_mutex> lock(mutex);
+
+		if (ids.Contains(name, id)) {
+			return id;
+		}
+	}
+
+	std::unique_lock<std::shared_mutex> lock(mutex);
+
+	if (ids.Contains(name, id)) {
+		return id;
+	}
+
+	// The key is a new string so it is never shared with the string of a thread
+	id = TypeId::none + 1 + ids.Count();
+	ids.Add(String((const char*)name, name.Length()), id);
+	return id;
+}
+
+const TypeInfo& Type::Info(UInt id) {
+	static const TypeInfo builtins[TypeId::builtinCount] = {
+		{1, 1, true, true}, {1, 1, true, false},
+		{2, 2, true, true}, {2, 2, true, false},
+		{4, 4, true, true}, {4, 4, true, false},
+		{8, 8, true, true}, {8, 8, true, false}
+	};
+
+	static const TypeInfo none;
+
+	return id < TypeId::builtinCount ? builtins[id] : none;
+}
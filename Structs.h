@@ -3,35 +3,71 @@
 #include "Ptr.h"
 
 #include "Boxx/Boxx/StringBuilder.h"
-#include "Boxx/Boxx/Regex.h"
+#include "Boxx/Boxx/List.h"
 
 ///N Kiwi
 
 namespace Kiwi {
 	class KiwiProgram;
+	class Struct;
 
 	/// Utility class for kiwi names.
 	class Name final {
 	public:
 		/// Converts the specified name to a valid kiwi string.
-		static Boxx::String ToKiwi(const Boxx::String& name) {
-			using namespace Boxx;
-
-			static Regex wordPattern = Regex("^%w+$");
-			static Regex numPattern  = Regex("^%d+$");
-
-			if (wordPattern.Match(name)) {
-				if (numPattern.Match(name)) {
-					return '@' + name;
-				}
-				else {
-					return name;
-				}
-			}
-			else {
-				return '`' + name + '`';
-			}
-		}
+		static Boxx::String ToKiwi(const Boxx::String& name);
+
+		/// Converts the interned name with the specified id to a valid kiwi string.
+		///
+		/// The result is cached for each id.
+		static Boxx::String ToKiwi(const Boxx::String& name, Boxx::UInt id);
+	};
+
+	/// Interned ids for the built in types.
+	class TypeId final {
+	public:
+		static constexpr Boxx::UInt i8  = 0;
+		static constexpr Boxx::UInt u8  = 1;
+		static constexpr Boxx::UInt i16 = 2;
+		static constexpr Boxx::UInt u16 = 3;
+		static constexpr Boxx::UInt i32 = 4;
+		static constexpr Boxx::UInt u32 = 5;
+		static constexpr Boxx::UInt i64 = 6;
+		static constexpr Boxx::UInt u64 = 7;
+
+		/// The number of built in types.
+		static constexpr Boxx::UInt builtinCount = 8;
+
+		/// The id of the empty type name.
+		static constexpr Boxx::UInt none = builtinCount;
+	};
+
+	/// Information about a built in type.
+	struct TypeInfo {
+		/// The byte size.
+		Boxx::UInt size = 0;
+
+		/// The byte alignment.
+		Boxx::UInt alignment = 1;
+
+		/// {true} if the type is an integer type.
+		bool isInteger = false;
+
+		/// {true} if the type is a signed integer type.
+		bool isSigned = false;
+	};
+
+	/// The types of a program indexed by type id.
+	class TypeTable {
+	public:
+		/// Sets the struct for the specified type id.
+		void SetStruct(Boxx::UInt id, Weak<Struct> struct_);
+
+		/// Gets the struct for the specified type id.
+		Weak<Struct> GetStruct(Boxx::UInt id) const;
+
+	private:
+		Boxx::List<Weak<Struct>> structs;
 	};
 
 	/// A Kiwi type.
@@ -40,22 +76,26 @@ namespace Kiwi {
 		Boxx::UInt pointers;
 
 		/// The type name.
+		/// Use a new type instead of changing the name.
 		Boxx::String name;
 
 		/// The array length.
 		Boxx::UInt len;
 
-		Type() : pointers(0), name(""), len(1) {}
-		explicit Type(const Boxx::String& type) : pointers(0), name(type), len(1) {}
-		Type(Boxx::UInt pointers, const Boxx::String& type) : pointers(pointers), name(type), len(1) {}
-		Type(const Boxx::String& type, Boxx::UInt len) : pointers(0), name(type), len(len) {}
-		Type(Boxx::UInt pointers, const Boxx::String& type, Boxx::UInt len) : pointers(pointers), name(type), len(len) {}
+		/// The interned id of the type name.
+		Boxx::UInt id;
+
+		Type() : pointers(0), name(""), len(1), id(TypeId::none) {}
+		explicit Type(const Boxx::String& type) : pointers(0), name(type), len(1), id(Intern(type)) {}
+		Type(Boxx::UInt pointers, const Boxx::String& type) : pointers(pointers), name(type), len(1), id(Intern(type)) {}
+		Type(const Boxx::String& type, Boxx::UInt len) : pointers(0), name(type), len(len), id(Intern(type)) {}
+		Type(Boxx::UInt pointers, const Boxx::String& type, Boxx::UInt len) : pointers(pointers), name(type), len(len), id(Intern(type)) {}
 		~Type() {}
 
 		/// Converts the type to kiwi.
 		Boxx::String ToKiwi() const {
-			Boxx::String str = Name::ToKiwi(name);
-			
+			Boxx::String str = Name::ToKiwi(name, id);
+
 			if (len != 1) {
 				str += '[' + Boxx::String::ToString(len) + ']';
 			}
@@ -68,11 +108,11 @@ namespace Kiwi {
 		}
 
 		bool operator==(const Type& type) const {
-			return pointers == type.pointers && name == type.name && len == type.len;
+			return pointers == type.pointers && id == type.id && len == type.len;
 		}
 
 		bool operator!=(const Type& type) const {
-			return pointers != type.pointers || name != type.name || len != type.len;
+			return pointers != type.pointers || id != type.id || len != type.len;
 		}
 
 		bool operator<(const Type& type) const {
@@ -87,7 +127,28 @@ namespace Kiwi {
 			return name < type.name;
 		}
 
+		/// {true} if the type is a signed integer type.
+		bool IsSigned() const {
+			return pointers == 0 && Info(id).isSigned;
+		}
+
 		/// Gets the size of the specified type.
-		static Boxx::UInt SizeOf(Type type, Weak<KiwiProgram> program);
+		static Boxx::UInt SizeOf(const Type& type, Weak<KiwiProgram> program);
+
+		/// Gets the alignment of the specified type.
+		static Boxx::UInt AlignOf(const Type& type, Weak<KiwiProgram> program);
+
+		/// Gets the id of the integer type used for arithmetic on the specified type.
+		///
+		/// Pointers use {u64} and other non integer types use the signed integer type with the same size.
+		static Boxx::UInt IntegerId(const Type& type, Weak<KiwiProgram> program);
+
+		/// Gets the interned id of a type name.
+		static Boxx::UInt Intern(const Boxx::String& name);
+
+		/// Gets the information about the type with the specified id.
+		///
+		/// Only built in types have information.
+		static const TypeInfo& Info(Boxx::UInt id);
 	};
 }
@@ -10,39 +10,58 @@ Interpreter::DataPtr Variable::EvaluateRef(Interpreter::InterpreterData& data) c
 }
 
 Interpreter::Data Variable::Evaluate(Interpreter::InterpreterData& data) {
-	Interpreter::Data d;
+	Interpreter::DataPtr ptr;
 	UInt id;
 
-	if (data.staticData.Contains(name, d)) {
-		Interpreter::Data sd = Interpreter::Data(KiwiProgram::ptrSize);
-		sd.Set(d.Ptr());
-		return sd;
+	if (data.staticData.Contains(name, ptr)) {
+		return Interpreter::Data::Number(data.program->PointerSize(), data.ToPointer(ptr));
 	}
 	else if (data.funcIdMap.Contains(name, id)) {
-		return Interpreter::Data::Number(KiwiProgram::ptrSize, id);
+		return Interpreter::Data::Number(data.program->PointerSize(), id);
 	}
 	else if (data.frame) {
 		return data.frame->GetVarValueCopy(name);
 	}
 
-	return d;
+	return Interpreter::Data();
+}
+
+Interpreter::MemRef Variable::CompileRef(Interpreter::Compiler& compiler) {
+	return Interpreter::MemRef{true, compiler.GetVariable(name), 0};
+}
+
+void Variable::CompileAssign(Interpreter::Compiler& compiler, Interpreter::Reg value) {
+	compiler.Assign(compiler.GetVariable(name), value);
+}
+
+Interpreter::Reg Variable::CompileEvaluate(Interpreter::Compiler& compiler) {
+	if (Optional<UInt> id = compiler.GetStatic(name)) {
+		Interpreter::Reg ptr = compiler.AddRegister(compiler.program->PointerSize());
+		compiler.Emit(Interpreter::OpCode::Static, compiler.RegisterSize(ptr), ptr, *id);
+		return ptr;
+	}
+	else if (Optional<UInt> id = compiler.GetFunction(name)) {
+		Interpreter::Reg func = compiler.AddRegister(compiler.program->PointerSize());
+		compiler.Emit(Interpreter::OpCode::Const, compiler.RegisterSize(func), func, 0, 0, *id);
+		return func;
+	}
+
+	return compiler.GetVariable(name);
 }
 
 Type SubVariable::GetType(Interpreter::InterpreterData& data) const {
-	if (!data.program->structs.Contains(var->GetType(data).name)) {
-		return Type();
+	if (Weak<Struct> struct_ = data.program->types.GetStruct(var->GetType(data).id)) {
+		return struct_->VarType(name);
 	}
 
-	return data.program->structs[var->GetType(data).name]->VarType(name);
+	return Type();
 }
 
 Interpreter::DataPtr SubVariable::EvaluateRef(Interpreter::InterpreterData& data) const {
 	Interpreter::DataPtr struct_ = var->EvaluateRef(data);
 
-	Type type = var->GetType(data);
-
-	if (data.program->structs.Contains(type.name)) {
-		return struct_ + data.program->structs[type.name]->VarOffset(name, data.program);
+	if (Weak<Struct> s = data.program->types.GetStruct(var->GetType(data).id)) {
+		return struct_ + s->VarOffset(name, data.program);
 	}
 
 	return nullptr;
@@ -53,13 +72,46 @@ Interpreter::Data SubVariable::Evaluate(Interpreter::InterpreterData& data) {
 	return Interpreter::Data(ptr, Type::SizeOf(GetType(data), data.program));
 }
 
+Interpreter::MemRef SubVariable::CompileRef(Interpreter::Compiler& compiler) {
+	Interpreter::MemRef ref = var->CompileRef(compiler);
+
+	Type type = var->GetType(compiler.typeData);
+	Weak<Struct> struct_ = compiler.program->types.GetStruct(type.id);
+
+	if (!struct_) {
+		throw Interpreter::KiwiInterpretError("'" + type.ToKiwi() + "' is not a struct");
+	}
+
+	ref.offset += struct_->VarOffset(name, compiler.program);
+	return ref;
+}
+
+void SubVariable::CompileAssign(Interpreter::Compiler& compiler, Interpreter::Reg value) {
+	compiler.Store(CompileRef(compiler), value);
+}
+
+Interpreter::Reg SubVariable::CompileEvaluate(Interpreter::Compiler& compiler) {
+	return compiler.Load(CompileRef(compiler), Type::SizeOf(GetType(compiler.typeData), compiler.program));
+}
+
 Interpreter::DataPtr DerefVariable::EvaluateRef(Interpreter::InterpreterData& data) const {
-	return data.frame->GetVarValue(name).Get<Interpreter::DataPtr>();
+	return data.FromPointer(data.GetPointer(data.frame->GetVarValue(name)), Type::SizeOf(GetType(data), data.program));
 }
 
 Interpreter::Data DerefVariable::Evaluate(Interpreter::InterpreterData& data) {
-	Interpreter::DataPtr ptr = data.frame->GetVarValue(name).Get<Interpreter::DataPtr>();
-	return Interpreter::Data(ptr, Type::SizeOf(GetType(data), data.program));
+	return Interpreter::Data(EvaluateRef(data), Type::SizeOf(GetType(data), data.program));
+}
+
+Interpreter::MemRef DerefVariable::CompileRef(Interpreter::Compiler& compiler) {
+	return Interpreter::MemRef{false, compiler.GetVariable(name), 0};
+}
+
+void DerefVariable::CompileAssign(Interpreter::Compiler& compiler, Interpreter::Reg value) {
+	compiler.Store(CompileRef(compiler), value);
+}
+
+Interpreter::Reg DerefVariable::CompileEvaluate(Interpreter::Compiler& compiler) {
+	return compiler.Load(CompileRef(compiler), Type::SizeOf(GetType(compiler.typeData), compiler.program));
 }
 
 Interpreter::Data RefValue::Evaluate(Interpreter::InterpreterData& data) {
@@ -68,12 +120,18 @@ Interpreter::Data RefValue::Evaluate(Interpreter::InterpreterData& data) {
 	}
 
 	Interpreter::DataPtr value = var->EvaluateRef(data);
-	Interpreter::Data d = Interpreter::Data(KiwiProgram::ptrSize);
-	d.Set(value);
-	return d;
+	return Interpreter::Data::Number(data.program->PointerSize(), data.ToPointer(value));
+}
+
+Interpreter::Reg RefValue::CompileEvaluate(Interpreter::Compiler& compiler) {
+	if (!var) {
+		throw Interpreter::KiwiInterpretError("invalid value to reference");
+	}
+
+	return compiler.Materialize(var->CompileRef(compiler));
 }
 
-void RefValue::BuildString(StringBuilder& builder) {
+void RefValue::BuildString(TextWriter& builder) {
 	builder += '&';
 
 	if (var) {
@@ -88,11 +146,20 @@ Interpreter::Data Integer::Evaluate(Interpreter::InterpreterData& data) {
 	return Interpreter::Data::Number(Type::SizeOf(type, data.program), value);
 }
 
+Interpreter::Reg Integer::CompileEvaluate(Interpreter::Compiler& compiler) {
+	Interpreter::Reg reg = compiler.AddRegister(Type::SizeOf(type, compiler.program));
+	compiler.Emit(Interpreter::OpCode::Const, compiler.RegisterSize(reg), reg, 0, 0, value);
+	return reg;
+}
+
 Interpreter::Data Kiwi::StringValue::Evaluate(Interpreter::InterpreterData& data) {
-	Interpreter::Data str = data.heap->Alloc(value.Length());
-	std::memcpy(str.Ptr(), (const char*)value, value.Length());
+	Interpreter::DataPtr str = data.strings->Get(value);
+
+	return Interpreter::Data::Number(data.program->PointerSize(), data.ToPointer(str));
+}
 
-	Interpreter::Data strPtr = Interpreter::Data(KiwiProgram::ptrSize);
-	strPtr.Set(str.Ptr());
-	return strPtr;
+Interpreter::Reg Kiwi::StringValue::CompileEvaluate(Interpreter::Compiler& compiler) {
+	Interpreter::Reg ptr = compiler.AddRegister(compiler.program->PointerSize());
+	compiler.Emit(Interpreter::OpCode::Str, compiler.RegisterSize(ptr), ptr, compiler.AddString(value));
+	return ptr;
 }
@@ -10,7 +10,11 @@ namespace Kiwi {
 	/// A Kiwi value.
 	class Value : public Expression {
 	public:
-		virtual void BuildString(Boxx::StringBuilder& builder) override {
+		static bool classof(const Node* node) {
+			return node->Kind() >= NodeKind::FirstValue && node->Kind() <= NodeKind::LastValue;
+		}
+
+		virtual void BuildString(TextWriter& builder) override {
 			builder += "unknown value";
 		}
 
@@ -21,10 +25,15 @@ namespace Kiwi {
 	/// A Kiwi variable.
 	class Variable : public Value {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() >= NodeKind::FirstVariable && node->Kind() <= NodeKind::LastVariable;
+		}
+
 		/// The variable name.
 		Boxx::String name;
 
 		Variable(const Boxx::String& name) {
+			kind = NodeKind::Variable;
 			this->name = name;
 		}
 
@@ -47,7 +56,15 @@ namespace Kiwi {
 
 		virtual Interpreter::Data Evaluate(Interpreter::InterpreterData& data) override;
 
-		virtual void BuildString(Boxx::StringBuilder& builder) override {
+		/// Compiles the ref of the variable.
+		virtual Interpreter::MemRef CompileRef(Interpreter::Compiler& compiler);
+
+		/// Compiles an assignment of the specified register to the variable.
+		virtual void CompileAssign(Interpreter::Compiler& compiler, Interpreter::Reg value);
+
+		virtual Interpreter::Reg CompileEvaluate(Interpreter::Compiler& compiler) override;
+
+		virtual void BuildString(TextWriter& builder) override {
 			builder += Name::ToKiwi(name);
 		}
 	};
@@ -55,10 +72,15 @@ namespace Kiwi {
 	/// A Kiwi sub variable.
 	class SubVariable : public Variable {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::SubVariable;
+		}
+
 		/// The variable to access a sub variable of.
 		Ptr<Variable> var;
 
 		SubVariable(Ptr<Variable> var, const Boxx::String& subVar) : Variable(subVar) {
+			kind = NodeKind::SubVariable;
 			this->var = var;
 		}
 
@@ -72,7 +94,13 @@ namespace Kiwi {
 
 		virtual Interpreter::Data Evaluate(Interpreter::InterpreterData& data) override;
 
-		virtual void BuildString(Boxx::StringBuilder& builder) override {
+		virtual Interpreter::MemRef CompileRef(Interpreter::Compiler& compiler) override;
+
+		virtual void CompileAssign(Interpreter::Compiler& compiler, Interpreter::Reg value) override;
+
+		virtual Interpreter::Reg CompileEvaluate(Interpreter::Compiler& compiler) override;
+
+		virtual void BuildString(TextWriter& builder) override {
 			var->BuildString(builder);
 			builder += '.';
 			builder += Name::ToKiwi(name);
@@ -82,7 +110,13 @@ namespace Kiwi {
 	/// A variable that is dereferenced.
 	class DerefVariable : public Variable {
 	public:
-		DerefVariable(const Boxx::String& var) : Variable(var) {}
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::DerefVariable;
+		}
+
+		DerefVariable(const Boxx::String& var) : Variable(var) {
+			kind = NodeKind::DerefVariable;
+		}
 
 		virtual Ptr<Variable> Copy() const override {
 			return new DerefVariable(name);
@@ -98,7 +132,13 @@ namespace Kiwi {
 
 		virtual Interpreter::Data Evaluate(Interpreter::InterpreterData& data) override;
 
-		virtual void BuildString(Boxx::StringBuilder& builder) override {
+		virtual Interpreter::MemRef CompileRef(Interpreter::Compiler& compiler) override;
+
+		virtual void CompileAssign(Interpreter::Compiler& compiler, Interpreter::Reg value) override;
+
+		virtual Interpreter::Reg CompileEvaluate(Interpreter::Compiler& compiler) override;
+
+		virtual void BuildString(TextWriter& builder) override {
 			builder += '*';
 			builder += Name::ToKiwi(name);
 		}
@@ -107,10 +147,15 @@ namespace Kiwi {
 	/// A ref value.
 	class RefValue : public Value {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::RefValue;
+		}
+
 		/// The variable to reference.
 		Ptr<Variable> var;
 
 		RefValue(Ptr<Variable> var) {
+			kind = NodeKind::RefValue;
 			this->var = var;
 		}
 
@@ -125,12 +170,17 @@ namespace Kiwi {
 		}
 
 		virtual Interpreter::Data Evaluate(Interpreter::InterpreterData& data) override;
-		virtual void BuildString(Boxx::StringBuilder& builder) override;
+		virtual Interpreter::Reg CompileEvaluate(Interpreter::Compiler& compiler) override;
+		virtual void BuildString(TextWriter& builder) override;
 	};
 
 	/// A Kiwi integer.
 	class Integer : public Value {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::Integer;
+		}
+
 		/// The integer value.
 		Boxx::Long value;
 
@@ -138,6 +188,7 @@ namespace Kiwi {
 		Type type;
 
 		Integer(Type type, const Boxx::Long value) {
+			kind = NodeKind::Integer;
 			this->type  = type;
 			this->value = value;
 		}
@@ -151,8 +202,9 @@ namespace Kiwi {
 		}
 
 		virtual Interpreter::Data Evaluate(Interpreter::InterpreterData& data) override;
+		virtual Interpreter::Reg CompileEvaluate(Interpreter::Compiler& compiler) override;
 
-		virtual void BuildString(Boxx::StringBuilder& builder) override {
+		virtual void BuildString(TextWriter& builder) override {
 			builder += Boxx::String::ToString(value);
 		}
 	};
@@ -160,10 +212,15 @@ namespace Kiwi {
 	/// A Kiwi string.
 	class StringValue : public Value {
 	public:
+		static bool classof(const Node* node) {
+			return node->Kind() == NodeKind::StringValue;
+		}
+
 		/// The string value.
 		Boxx::String value;
 
 		StringValue(const Boxx::String& value) {
+			kind = NodeKind::StringValue;
 			this->value = value;
 		}
 
@@ -176,8 +233,9 @@ namespace Kiwi {
 		}
 
 		virtual Interpreter::Data Evaluate(Interpreter::InterpreterData& data) override;
+		virtual Interpreter::Reg CompileEvaluate(Interpreter::Compiler& compiler) override;
 
-		virtual void BuildString(Boxx::StringBuilder& builder) override {
+		virtual void BuildString(TextWriter& builder) override {
 			builder += '"';
 			builder += value.Escape();
 			builder += '"';
@@ -0,0 +1,105 @@
+#include "Writer.h"
+
+#ifdef _WIN32
+	#include <io.h>
+	#include <fcntl.h>
+	#include <sys/stat.h>
+#else
+	#include <cerrno>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+using namespace Boxx;
+
+using namespace Kiwi;
+
+String StringWriter::ToString() {
+	Flush();
+	return builder.ToString();
+}
+
+void StringWriter::Output(const char* data, UInt size) {
+	builder += String(data, size);
+}
+
+StreamWriter::StreamWriter(int fd) : TextWriter(buffer, bufferSize) {
+	this->fd = fd;
+	owned = false;
+}
+
+StreamWriter::StreamWriter(const String& filename) : TextWriter(buffer, bufferSize) {
+#ifdef _WIN32
+	fd = _open(filename, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+	fd = ::open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+
+	owned = true;
+}
+
+StreamWriter::~StreamWriter() {
+	Flush();
+
+	if (owned && fd >= 0) {
+#ifdef _WIN32
+		_close(fd);
+#else
+		close(fd);
+#endif
+	}
+}
+
+void StreamWriter::Close() {
+	if (closed) return;
+
+	Flush();
+	closed = true;
+
+	if (fd < 0) {
+		throw KiwiWriteError("could not write the output");
+	}
+
+	if (owned) {
+#ifdef _WIN32
+		int result = _close(fd);
+#else
+		int result = close(fd);
+#endif
+
+		fd = -1;
+
+		// Some file systems only report write errors on close
+		if (result != 0) {
+			throw KiwiWriteError("could not write the output");
+		}
+	}
+}
+
+void StreamWriter::Output(const char* data, UInt size) {
+	while (size > 0 && fd >= 0) {
+#ifdef _WIN32
+		int written = _write(fd, data, size);
+#else
+		ssize_t written = write(fd, data, size);
+
+		if (written < 0 && errno == EINTR) continue;
+#endif
+
+		if (written <= 0) {
+			if (owned) {
+#ifdef _WIN32
+				_close(fd);
+#else
+				close(fd);
+#endif
+			}
+
+			fd = -1;
+			return;
+		}
+
+		data += written;
+		size -= (UInt)written;
+	}
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstring>
+
+#include "Boxx/Boxx/String.h"
+#include "Boxx/Boxx/StringBuilder.h"
+#include "Boxx/Boxx/Error.h"
+
+///N Kiwi
+
+namespace Kiwi {
+	/// Error for writing text to a file.
+	class KiwiWriteError : public Boxx::Error {
+	public:
+		KiwiWriteError() : Boxx::Error() {}
+		KiwiWriteError(const char* const msg) : Boxx::Error(msg) {}
+
+		virtual Boxx::String Name() const override {
+			return "KiwiWriteError";
+		}
+	};
+
+	/// Writes text through a fixed size buffer.
+	///
+	/// The buffer is flushed to the output of the writer when it is full.
+	class TextWriter {
+	public:
+		TextWriter(const TextWriter&) = delete;
+		virtual ~TextWriter() {}
+
+		TextWriter& operator=(const TextWriter&) = delete;
+
+		TextWriter& operator+=(const Boxx::String& str) {
+			Write((const char*)str, str.Length());
+			return *this;
+		}
+
+		TextWriter& operator+=(const char* str) {
+			Write(str, (Boxx::UInt)std::strlen(str));
+			return *this;
+		}
+
+		TextWriter& operator+=(char c) {
+			if (length == capacity) Flush();
+			buffer[length++] = c;
+			return *this;
+		}
+
+		/// Writes {size} bytes.
+		void Write(const char* data, Boxx::UInt size) {
+			if (size > capacity - length) {
+				Flush();
+
+				// Large writes skip the buffer
+				if (size > capacity) {
+					Output(data, size);
+					return;
+				}
+			}
+
+			std::memcpy(buffer + length, data, size);
+			length += size;
+		}
+
+		/// Writes the content of the buffer to the output.
+		void Flush() {
+			if (length == 0) return;
+
+			Output(buffer, length);
+			length = 0;
+		}
+
+	protected:
+		TextWriter(char* buffer, Boxx::UInt capacity) {
+			this->buffer   = buffer;
+			this->capacity = capacity;
+		}
+
+		/// Writes bytes to the output.
+		virtual void Output(const char* data, Boxx::UInt size) = 0;
+
+	private:
+		char* buffer;
+		Boxx::UInt capacity;
+		Boxx::UInt length = 0;
+	};
+
+	/// Writes text to a string.
+	class StringWriter : public TextWriter {
+	public:
+		StringWriter() : TextWriter(buffer, sizeof(buffer)) {}
+
+		/// Gets the written text.
+		Boxx::String ToString();
+
+	protected:
+		virtual void Output(const char* data, Boxx::UInt size) override;
+
+	private:
+		Boxx::StringBuilder builder;
+		char buffer[256];
+	};
+
+	/// Writes text to a file descriptor.
+	///
+	/// The writer only uses the memory of its buffer no matter how much text is written.
+	class StreamWriter : public TextWriter {
+	public:
+		/// The byte size of the buffer.
+		static constexpr Boxx::UInt bufferSize = 64 * 1024;
+
+		/// Writes to an open file descriptor.
+		///
+		/// The file descriptor is not closed by the writer.
+		StreamWriter(int fd);
+
+		/// Creates or truncates a file and writes to it.
+		///
+		/// Use {IsOpen} to check if the file was opened.
+		StreamWriter(const Boxx::String& filename);
+
+		/// Flushes the buffer and closes the file if it was opened by the writer.
+		///
+		/// Errors are ignored. Use {Close} to find out if all text was written.
+		~StreamWriter();
+
+		/// {true} if the file is open and all writes have succeeded.
+		bool IsOpen() const {
+			return fd >= 0;
+		}
+
+		/// Flushes the buffer and closes the file if it was opened by the writer.
+		///
+		/// Throws {KiwiWriteError} if the file could not be opened or a write failed.
+		void Close();
+
+	protected:
+		virtual void Output(const char* data, Boxx::UInt size) override;
+
+	private:
+		int fd;
+		bool owned;
+		bool closed = false;
+		char buffer[bufferSize];
+	};
+}